@@ -0,0 +1,171 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "arena.h"
+
+#define ARENA_MAX_BLOCK (ARENA_MIN_BLOCK << (ARENA_CLASSES - 1))
+
+// 头部补齐到16字节，块按16字节对齐
+struct ArenaChunk {
+    ArenaChunk *next;
+    size_t pad;
+};
+
+struct ArenaLarge {
+    ArenaLarge *prev;
+    ArenaLarge *next;
+    size_t size;
+    size_t pad;
+};
+
+void ArenaInit(Arena *arena) {
+    memset(arena, 0, sizeof(*arena));
+}
+
+void ArenaFree(Arena *arena) {
+    ArenaChunk *chunk = arena->chunks;
+    while (chunk) {
+        ArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    ArenaLarge *large = arena->large;
+    while (large) {
+        ArenaLarge *next = large->next;
+        free(large);
+        large = next;
+    }
+    ArenaInit(arena);
+}
+
+// 能容纳size的最小级别
+static int size_class(size_t size) {
+    int cls = 0;
+    size_t block = ARENA_MIN_BLOCK;
+    while (block < size) {
+        block <<= 1;
+        cls++;
+    }
+    return cls;
+}
+
+static void push_free(Arena *arena, int cls, void *block) {
+    *(void **)block = arena->free_list[cls];
+    arena->free_list[cls] = block;
+}
+
+// 换新的大块前，把旧大块剩下的部分按从大到小切成空闲块，不浪费
+static void retire_bump(Arena *arena) {
+    while (arena->bump_end - arena->bump >= ARENA_MIN_BLOCK) {
+        int cls = ARENA_CLASSES - 1;
+        while ((ARENA_MIN_BLOCK << cls) > arena->bump_end - arena->bump) {
+            cls--;
+        }
+        push_free(arena, cls, arena->bump);
+        arena->bump += ARENA_MIN_BLOCK << cls;
+    }
+}
+
+static void charge(Arena *arena, size_t bytes) {
+    arena->live += bytes;
+    if (arena->live > arena->peak) {
+        arena->peak = arena->live;
+    }
+}
+
+static void *alloc_large(Arena *arena, size_t size) {
+    ArenaLarge *large = malloc(sizeof(ArenaLarge) + size);
+    if (!large) {
+        return NULL;
+    }
+    large->prev = NULL;
+    large->next = arena->large;
+    large->size = size;
+    if (arena->large) {
+        arena->large->prev = large;
+    }
+    arena->large = large;
+    charge(arena, size);
+    return large + 1;
+}
+
+static void release_large(Arena *arena, void *ptr) {
+    ArenaLarge *large = (ArenaLarge *)ptr - 1;
+    if (large->prev) {
+        large->prev->next = large->next;
+    } else {
+        arena->large = large->next;
+    }
+    if (large->next) {
+        large->next->prev = large->prev;
+    }
+    arena->live -= large->size;
+    free(large);
+}
+
+void *ArenaAlloc(Arena *arena, size_t size) {
+    if (size == 0) {
+        return NULL;
+    }
+    if (size > ARENA_MAX_BLOCK) {
+        return alloc_large(arena, size);
+    }
+
+    int cls = size_class(size);
+    size_t block_size = (size_t)ARENA_MIN_BLOCK << cls;
+    void *block = arena->free_list[cls];
+    if (block) {
+        arena->free_list[cls] = *(void **)block;
+    } else {
+        if ((size_t)(arena->bump_end - arena->bump) < block_size) {
+            ArenaChunk *chunk = malloc(sizeof(ArenaChunk) + ARENA_CHUNK_SIZE);
+            if (!chunk) {
+                fprintf(stderr, "[Arena Error] Failed to allocate chunk\n");
+                return NULL;
+            }
+            retire_bump(arena);
+            chunk->next = arena->chunks;
+            arena->chunks = chunk;
+            arena->bump = (char *)(chunk + 1);
+            arena->bump_end = arena->bump + ARENA_CHUNK_SIZE;
+        }
+        block = arena->bump;
+        arena->bump += block_size;
+    }
+    charge(arena, block_size);
+    return block;
+}
+
+void ArenaRelease(Arena *arena, void *ptr, size_t size) {
+    if (!ptr) {
+        return;
+    }
+    if (size > ARENA_MAX_BLOCK) {
+        release_large(arena, ptr);
+        return;
+    }
+    int cls = size_class(size);
+    push_free(arena, cls, ptr);
+    arena->live -= (size_t)ARENA_MIN_BLOCK << cls;
+}
+
+void *ArenaRealloc(Arena *arena, void *ptr, size_t old_size, size_t new_size) {
+    if (!ptr) {
+        return ArenaAlloc(arena, new_size);
+    }
+    if (new_size == 0) {
+        ArenaRelease(arena, ptr, old_size);
+        return NULL;
+    }
+    if (old_size <= ARENA_MAX_BLOCK && new_size <= ARENA_MAX_BLOCK &&
+        size_class(old_size) == size_class(new_size)) {
+        return ptr;
+    }
+    void *moved = ArenaAlloc(arena, new_size);
+    if (!moved) {
+        return NULL;
+    }
+    memcpy(moved, ptr, old_size < new_size ? old_size : new_size);
+    ArenaRelease(arena, ptr, old_size);
+    return moved;
+}
@@ -0,0 +1,44 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ARENA_MIN_BLOCK 16          // 最小的块，空闲时块首存放空闲链表指针
+#define ARENA_CLASSES 13            // 块大小按2的幂分级：16B ~ 64KB
+#define ARENA_CHUNK_SIZE (1 << 20)  // 每次向系统申请的大块
+
+typedef struct ArenaChunk ArenaChunk;
+typedef struct ArenaLarge ArenaLarge;
+
+// 实例私有的分级分配器，不加锁。小块从大块中顺序切出，释放后挂到对应级别的空闲链表上复用；
+// 超过最大级别的块单独malloc。所有内存在ArenaFree时整体归还。
+// 释放和改变大小时由调用方给出原大小，块本身不带头部
+typedef struct {
+    void *free_list[ARENA_CLASSES];
+    char *bump;                 // 当前大块中尚未切出的部分
+    char *bump_end;
+    ArenaChunk *chunks;
+    ArenaLarge *large;
+    uint64_t live;              // 已分出、尚未释放的字节数，按块的实际大小计
+    uint64_t peak;
+} Arena;
+
+void ArenaInit(Arena *arena);
+// 归还全部内存，之前分出的指针都失效
+void ArenaFree(Arena *arena);
+// size为0时返回NULL；失败返回NULL
+void *ArenaAlloc(Arena *arena, size_t size);
+// 语义同realloc，old_size为ptr分配时的大小。新旧大小落在同一级时原地返回
+void *ArenaRealloc(Arena *arena, void *ptr, size_t old_size, size_t new_size);
+void ArenaRelease(Arena *arena, void *ptr, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ARENA_H
@@ -0,0 +1,143 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "checkpoint.h"
+
+bool CkptCreate(CkptWriter *w, const char *path, const char *scheme) {
+    memset(w, 0, sizeof(*w));
+    if (snprintf(w->path, sizeof(w->path), "%s", path) >= (int)sizeof(w->path) ||
+        snprintf(w->tmp_path, sizeof(w->tmp_path), "%s.tmp", path) >= (int)sizeof(w->tmp_path)) {
+        fprintf(stderr, "Checkpoint path too long: %s\n", path);
+        return false;
+    }
+    memcpy(w->header.magic, CKPT_MAGIC, sizeof(w->header.magic));
+    w->header.version = CKPT_VERSION;
+    w->header.header_size = sizeof(ckpt_header);
+    snprintf(w->header.scheme, sizeof(w->header.scheme), "%s", scheme);
+
+    w->fp = fopen(w->tmp_path, "wb");
+    if (!w->fp) {
+        perror("Failed to create checkpoint");
+        return false;
+    }
+    // 头部所在的第一页在提交时才写入，先跳到载荷起点
+    if (fseek(w->fp, CKPT_PAYLOAD_OFFSET, SEEK_SET) != 0) {
+        perror("Failed to seek checkpoint");
+        CkptAbort(w);
+        return false;
+    }
+    return true;
+}
+
+void CkptPut(CkptWriter *w, const void *data, size_t size) {
+    static const uint8_t zeros[CKPT_ALIGN];
+    if (w->failed || size == 0) {
+        return;
+    }
+    size_t pad = (CKPT_ALIGN - size % CKPT_ALIGN) % CKPT_ALIGN;
+    if (fwrite(data, 1, size, w->fp) != size || fwrite(zeros, 1, pad, w->fp) != pad) {
+        w->failed = true;
+        return;
+    }
+    w->header.payload_size += size + pad;
+}
+
+bool CkptCommit(CkptWriter *w) {
+    if (!w->failed) {
+        w->failed = fseek(w->fp, 0, SEEK_SET) != 0 ||
+                    fwrite(&w->header, sizeof(w->header), 1, w->fp) != 1 ||
+                    fflush(w->fp) != 0 || fsync(fileno(w->fp)) != 0;
+    }
+    if (w->failed) {
+        fprintf(stderr, "Failed to write checkpoint: %s\n", w->tmp_path);
+        CkptAbort(w);
+        return false;
+    }
+    fclose(w->fp);
+    w->fp = NULL;
+    if (rename(w->tmp_path, w->path) != 0) {
+        perror("Failed to rename checkpoint");
+        remove(w->tmp_path);
+        return false;
+    }
+    return true;
+}
+
+void CkptAbort(CkptWriter *w) {
+    if (w->fp) {
+        fclose(w->fp);
+        w->fp = NULL;
+    }
+    remove(w->tmp_path);
+}
+
+bool CkptOpen(CkptImage *img, const char *path, const char *scheme) {
+    memset(img, 0, sizeof(*img));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("Failed to open checkpoint");
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < CKPT_PAYLOAD_OFFSET) {
+        fprintf(stderr, "Checkpoint too short: %s\n", path);
+        close(fd);
+        return false;
+    }
+    // 只建立映射，页面在第一次访问时才从页缓存读入
+    void *base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror("Failed to map checkpoint");
+        return false;
+    }
+    img->base = base;
+    img->size = st.st_size;
+    img->header = (const ckpt_header *)img->base;
+
+    const ckpt_header *h = img->header;
+    const char *error = NULL;
+    if (memcmp(h->magic, CKPT_MAGIC, sizeof(h->magic)) != 0) {
+        error = "not a checkpoint";
+    } else if (h->version != CKPT_VERSION || h->header_size != sizeof(ckpt_header)) {
+        error = "unsupported version";
+    } else if (strncmp(h->scheme, scheme, sizeof(h->scheme)) != 0) {
+        error = "written by another scheme";
+    } else if (h->payload_size > img->size - CKPT_PAYLOAD_OFFSET) {
+        error = "truncated";
+    }
+    if (error) {
+        fprintf(stderr, "Cannot restore %s from %s: %s\n", scheme, path, error);
+        CkptClose(img);
+        return false;
+    }
+    return true;
+}
+
+const void *CkptGet(CkptImage *img, size_t size) {
+    uint64_t padded = (size + CKPT_ALIGN - 1) / CKPT_ALIGN * CKPT_ALIGN;
+    if (padded > img->header->payload_size - img->pos) {
+        return NULL;
+    }
+    const void *p = img->base + CKPT_PAYLOAD_OFFSET + img->pos;
+    img->pos += padded;
+    return p;
+}
+
+void CkptClose(CkptImage *img) {
+    if (img->base) {
+        munmap(img->base, img->size);
+    }
+    memset(img, 0, sizeof(*img));
+}
+
+void *CkptDetach(CkptImage *img, size_t *size) {
+    void *base = img->base;
+    *size = img->size;
+    memset(img, 0, sizeof(*img));
+    return base;
+}
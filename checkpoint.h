@@ -0,0 +1,85 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CKPT_MAGIC "FTLCKPT"        // 含结尾的'\0'共8字节
+#define CKPT_VERSION 1
+#define CKPT_ALIGN 8                // 每块数据按8字节对齐，映射后可直接按uint64读取
+#define CKPT_PAYLOAD_OFFSET 4096    // 载荷从第二页开始，映射后载荷首地址按页对齐
+#define CKPT_END UINT64_MAX         // 组表序列的结束标记
+
+// 映射表检查点文件的头部，位于文件开头。载荷是各方案自己定义的数据块序列，
+// 只存偏移和数值、不存指针，映射到任意地址都能使用；按本机字节序存放。
+// 与配置有关的参数（组数等）由各方案写在载荷中自行校验
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;   // sizeof(ckpt_header)，头部扩展时用来区分
+    char scheme[16];        // 写出该文件的方案名，恢复时必须一致
+    uint64_t payload_size;
+} ckpt_header;
+
+// 顺序写出检查点。先写到path.tmp，提交时落盘后改名为path，
+// 中途失败或进程退出不会破坏已有的检查点
+typedef struct {
+    FILE *fp;
+    char path[4096];
+    char tmp_path[4096];
+    ckpt_header header;
+    bool failed;            // 任何一次写失败后置位，提交时报错
+} CkptWriter;
+
+// 映射进来的检查点，MAP_PRIVATE且可写：改动只落在进程私有的页上，不影响文件
+typedef struct {
+    uint8_t *base;          // 整个文件的映射，NULL表示未打开
+    size_t size;
+    const ckpt_header *header;
+    uint64_t pos;           // 下一块数据在载荷中的偏移
+} CkptImage;
+
+// 失败返回false
+bool CkptCreate(CkptWriter *w, const char *path, const char *scheme);
+// 追加一块数据，末尾补齐到CKPT_ALIGN
+void CkptPut(CkptWriter *w, const void *data, size_t size);
+static inline void CkptPutU64(CkptWriter *w, uint64_t value) {
+    CkptPut(w, &value, sizeof(value));
+}
+// 写好头部、fsync并改名。失败时删除临时文件并返回false
+bool CkptCommit(CkptWriter *w);
+// 放弃本次检查点，删除临时文件
+void CkptAbort(CkptWriter *w);
+
+// 映射path并校验魔数、版本、方案名和载荷大小。失败时打印原因并返回false
+bool CkptOpen(CkptImage *img, const char *path, const char *scheme);
+// 取出下一块size字节的数据，返回其在映射中的地址；超出载荷时返回NULL
+const void *CkptGet(CkptImage *img, size_t size);
+static inline bool CkptGetU64(CkptImage *img, uint64_t *value) {
+    const uint64_t *p = (const uint64_t *)CkptGet(img, sizeof(uint64_t));
+    if (!p) {
+        return false;
+    }
+    *value = *p;
+    return true;
+}
+// 载荷首地址，整块载荷就是一个结构体的方案可以直接使用
+static inline void *CkptPayload(const CkptImage *img) {
+    return img->base + CKPT_PAYLOAD_OFFSET;
+}
+// 解除映射。之前取出的指针都失效
+void CkptClose(CkptImage *img);
+// 把映射的所有权交给调用方，之后由调用方用munmap(base, size)释放
+void *CkptDetach(CkptImage *img, size_t *size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CHECKPOINT_H
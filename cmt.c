@@ -0,0 +1,344 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "cmt.h"
+
+#define HASH_MULTIPLIER UINT64_C(0x9E3779B97F4A7C15)
+
+// 各策略使用的链表
+enum {
+    LIST_MAIN = 0,          // LRU、CLOCK
+    LIST_PROBATION = 0,     // SLRU
+    LIST_PROTECTED = 1,
+    LIST_T1 = 0,            // ARC
+    LIST_T2 = 1,
+    LIST_B1 = 2,
+    LIST_B2 = 3,
+};
+
+static inline uint64_t bucket_of(const Cmt *cmt, uint64_t key) {
+    return ((key * HASH_MULTIPLIER) >> 32) & cmt->bucket_mask;
+}
+
+static uint32_t node_count(const Cmt *cmt) {
+    return cmt->policy == CMT_ARC ? 2 * cmt->capacity : cmt->capacity;
+}
+
+bool CmtInit(Cmt *cmt, uint32_t capacity, cmt_policy policy) {
+    memset(cmt, 0, sizeof(*cmt));
+    if (capacity == 0) {
+        fprintf(stderr, "CMT capacity must be positive\n");
+        return false;
+    }
+    cmt->policy = policy;
+    cmt->capacity = capacity;
+    uint32_t nodes = node_count(cmt);
+    uint64_t buckets = 1;
+    while (buckets < nodes) {
+        buckets *= 2;
+    }
+    cmt->nodes = malloc((size_t)nodes * sizeof(cmt_node));
+    cmt->buckets = malloc(buckets * sizeof(int32_t));
+    cmt->free_slots = malloc((size_t)capacity * sizeof(int32_t));
+    if (!cmt->nodes || !cmt->buckets || !cmt->free_slots) {
+        fprintf(stderr, "Failed to allocate CMT\n");
+        CmtFree(cmt);
+        return false;
+    }
+    cmt->bucket_mask = buckets - 1;
+    memset(cmt->buckets, 0xff, buckets * sizeof(int32_t));
+    for (uint32_t i = 0; i < nodes; i++) {
+        cmt->nodes[i].hnext = i + 1 < nodes ? (int32_t)(i + 1) : CMT_NONE;
+    }
+    cmt->free_node = 0;
+    // 槽按0、1、2……的顺序分出去
+    for (uint32_t i = 0; i < capacity; i++) {
+        cmt->free_slots[i] = (int32_t)(capacity - 1 - i);
+    }
+    cmt->free_slot_count = capacity;
+    for (int i = 0; i < 4; i++) {
+        cmt->lists[i].head = cmt->lists[i].tail = CMT_NONE;
+    }
+    return true;
+}
+
+void CmtFree(Cmt *cmt) {
+    free(cmt->nodes);
+    free(cmt->buckets);
+    free(cmt->free_slots);
+    memset(cmt, 0, sizeof(*cmt));
+}
+
+uint64_t CmtMemory(const Cmt *cmt) {
+    if (!cmt->nodes) {
+        return 0;
+    }
+    return (uint64_t)node_count(cmt) * sizeof(cmt_node) + (cmt->bucket_mask + 1) * sizeof(int32_t) +
+           (uint64_t)cmt->capacity * sizeof(int32_t);
+}
+
+static int32_t find(const Cmt *cmt, uint64_t key) {
+    int32_t n = cmt->buckets[bucket_of(cmt, key)];
+    while (n != CMT_NONE && cmt->nodes[n].key != key) {
+        n = cmt->nodes[n].hnext;
+    }
+    return n;
+}
+
+static void list_push(Cmt *cmt, int list, int32_t n) {
+    cmt_list *l = &cmt->lists[list];
+    cmt_node *node = &cmt->nodes[n];
+    node->list = (uint8_t)list;
+    node->prev = l->tail;
+    node->next = CMT_NONE;
+    if (l->tail != CMT_NONE) {
+        cmt->nodes[l->tail].next = n;
+    } else {
+        l->head = n;
+    }
+    l->tail = n;
+    l->size++;
+}
+
+static void list_remove(Cmt *cmt, int32_t n) {
+    cmt_node *node = &cmt->nodes[n];
+    cmt_list *l = &cmt->lists[node->list];
+    if (node->prev != CMT_NONE) {
+        cmt->nodes[node->prev].next = node->next;
+    } else {
+        l->head = node->next;
+    }
+    if (node->next != CMT_NONE) {
+        cmt->nodes[node->next].prev = node->prev;
+    } else {
+        l->tail = node->prev;
+    }
+    l->size--;
+}
+
+static void list_move(Cmt *cmt, int list, int32_t n) {
+    list_remove(cmt, n);
+    list_push(cmt, list, n);
+}
+
+static int32_t node_alloc(Cmt *cmt, uint64_t key) {
+    int32_t n = cmt->free_node;
+    cmt_node *node = &cmt->nodes[n];
+    cmt->free_node = node->hnext;
+    uint64_t b = bucket_of(cmt, key);
+    node->key = key;
+    node->hnext = cmt->buckets[b];
+    node->slot = CMT_NONE;
+    node->ref = 0;
+    cmt->buckets[b] = n;
+    return n;
+}
+
+// 从链表和哈希链上摘下节点并放回空闲链，占着的槽一并释放
+static void node_release(Cmt *cmt, int32_t n) {
+    cmt_node *node = &cmt->nodes[n];
+    list_remove(cmt, n);
+    int32_t *p = &cmt->buckets[bucket_of(cmt, node->key)];
+    while (*p != n) {
+        p = &cmt->nodes[*p].hnext;
+    }
+    *p = node->hnext;
+    if (node->slot != CMT_NONE) {
+        cmt->free_slots[cmt->free_slot_count++] = node->slot;
+    }
+    node->hnext = cmt->free_node;
+    cmt->free_node = n;
+}
+
+// 腾出节点n的槽，节点本身由调用方处理
+static int64_t evict_slot(Cmt *cmt, int32_t n) {
+    cmt_node *node = &cmt->nodes[n];
+    cmt->free_slots[cmt->free_slot_count++] = node->slot;
+    node->slot = CMT_NONE;
+    cmt->evictions++;
+    return (int64_t)node->key;
+}
+
+static void touch(Cmt *cmt, int32_t n) {
+    cmt_node *node = &cmt->nodes[n];
+    switch (cmt->policy) {
+    case CMT_LRU:
+        list_move(cmt, LIST_MAIN, n);
+        break;
+    case CMT_CLOCK:
+        node->ref = 1;
+        break;
+    case CMT_SLRU:
+        list_move(cmt, LIST_PROTECTED, n);
+        // 保护段超出配额时把最久未用的降回试用段
+        if ((uint64_t)cmt->lists[LIST_PROTECTED].size * 100 >
+            (uint64_t)cmt->capacity * CMT_SLRU_PROTECTED_PERCENT) {
+            list_move(cmt, LIST_PROBATION, cmt->lists[LIST_PROTECTED].head);
+        }
+        break;
+    case CMT_ARC:
+        list_move(cmt, LIST_T2, n);
+        break;
+    }
+}
+
+int32_t CmtLookup(Cmt *cmt, uint64_t key) {
+    int32_t n = find(cmt, key);
+    if (n == CMT_NONE || cmt->nodes[n].slot == CMT_NONE) {
+        cmt->misses++;
+        return CMT_NONE;
+    }
+    cmt->hits++;
+    touch(cmt, n);
+    return cmt->nodes[n].slot;
+}
+
+// 非ARC策略选出被逐出的节点
+static int32_t pick_victim(Cmt *cmt) {
+    switch (cmt->policy) {
+    case CMT_CLOCK:
+        // 链表当作环，head是指针所在处：访问位为1的清零后转到末尾
+        while (cmt->nodes[cmt->lists[LIST_MAIN].head].ref) {
+            int32_t n = cmt->lists[LIST_MAIN].head;
+            cmt->nodes[n].ref = 0;
+            list_move(cmt, LIST_MAIN, n);
+        }
+        return cmt->lists[LIST_MAIN].head;
+    case CMT_SLRU:
+        if (cmt->lists[LIST_PROBATION].size) {
+            return cmt->lists[LIST_PROBATION].head;
+        }
+        return cmt->lists[LIST_PROTECTED].head;
+    default:
+        return cmt->lists[LIST_MAIN].head;
+    }
+}
+
+// ARC影子命中时调整后的目标大小p
+static uint32_t arc_adapted_target(const Cmt *cmt, bool hit_b2) {
+    const cmt_list *b1 = &cmt->lists[LIST_B1], *b2 = &cmt->lists[LIST_B2];
+    if (!hit_b2) {
+        uint32_t delta = b2->size > b1->size ? b2->size / b1->size : 1;
+        return cmt->arc_target + delta < cmt->capacity ? cmt->arc_target + delta : cmt->capacity;
+    }
+    uint32_t delta = b1->size > b2->size ? b1->size / b2->size : 1;
+    return cmt->arc_target > delta ? cmt->arc_target - delta : 0;
+}
+
+// ARC的REPLACE按目标大小p选出的节点：T1或T2中最久未用的一项
+static int32_t arc_choose(const Cmt *cmt, bool hit_b2, uint32_t target) {
+    uint32_t t1 = cmt->lists[LIST_T1].size;
+    if (t1 && ((hit_b2 && t1 == target) || t1 > target || !cmt->lists[LIST_T2].size)) {
+        return cmt->lists[LIST_T1].head;
+    }
+    return cmt->lists[LIST_T2].head;
+}
+
+// ARC的REPLACE：逐出选中的一项，留作影子
+static int64_t arc_replace(Cmt *cmt, bool hit_b2) {
+    int32_t n = arc_choose(cmt, hit_b2, cmt->arc_target);
+    list_move(cmt, cmt->nodes[n].list == LIST_T1 ? LIST_B1 : LIST_B2, n);
+    return evict_slot(cmt, n);
+}
+
+static int32_t arc_insert(Cmt *cmt, uint64_t key, int64_t *victim) {
+    cmt_list *t1 = &cmt->lists[LIST_T1], *t2 = &cmt->lists[LIST_T2];
+    cmt_list *b1 = &cmt->lists[LIST_B1], *b2 = &cmt->lists[LIST_B2];
+    uint32_t c = cmt->capacity;
+    bool full = cmt->free_slot_count == 0;
+    int32_t n = find(cmt, key);
+    if (n != CMT_NONE) {
+        // 影子命中：按命中的是B1还是B2调整p，再放进T2
+        bool hit_b2 = cmt->nodes[n].list == LIST_B2;
+        cmt->arc_target = arc_adapted_target(cmt, hit_b2);
+        if (full) {
+            *victim = arc_replace(cmt, hit_b2);
+        }
+        list_move(cmt, LIST_T2, n);
+    } else {
+        if (t1->size + b1->size >= c) {
+            if (t1->size < c) {
+                node_release(cmt, b1->head);
+                if (full) {
+                    *victim = arc_replace(cmt, false);
+                }
+            } else {
+                // T1占满了整个缓存，直接丢掉它最久未用的一项，不留影子
+                int32_t old = t1->head;
+                *victim = evict_slot(cmt, old);
+                node_release(cmt, old);
+            }
+        } else if (t1->size + t2->size + b1->size + b2->size >= c) {
+            if (t1->size + t2->size + b1->size + b2->size >= 2 * c) {
+                node_release(cmt, b2->head);
+            }
+            if (full) {
+                *victim = arc_replace(cmt, false);
+            }
+        }
+        // 有key被删掉后缓存可能不满，影子仍然把节点用光时先丢最旧的影子
+        if (cmt->free_node == CMT_NONE) {
+            node_release(cmt, b1->size ? b1->head : b2->head);
+        }
+        n = node_alloc(cmt, key);
+        list_push(cmt, LIST_T1, n);
+    }
+    cmt->nodes[n].slot = cmt->free_slots[--cmt->free_slot_count];
+    return cmt->nodes[n].slot;
+}
+
+int64_t CmtVictim(Cmt *cmt, uint64_t key) {
+    if (cmt->free_slot_count) {
+        return CMT_NONE;
+    }
+    int32_t n;
+    if (cmt->policy != CMT_ARC) {
+        n = pick_victim(cmt);
+    } else {
+        // 与arc_insert的选择一致
+        int32_t ghost = find(cmt, key);
+        if (ghost != CMT_NONE) {
+            bool hit_b2 = cmt->nodes[ghost].list == LIST_B2;
+            n = arc_choose(cmt, hit_b2, arc_adapted_target(cmt, hit_b2));
+        } else if (cmt->lists[LIST_T1].size == cmt->capacity) {
+            n = cmt->lists[LIST_T1].head;
+        } else {
+            n = arc_choose(cmt, false, cmt->arc_target);
+        }
+    }
+    return (int64_t)cmt->nodes[n].key;
+}
+
+int32_t CmtInsert(Cmt *cmt, uint64_t key, int64_t *victim) {
+    *victim = CMT_NONE;
+    if (cmt->policy == CMT_ARC) {
+        return arc_insert(cmt, key, victim);
+    }
+    if (cmt->free_slot_count == 0) {
+        int32_t old = pick_victim(cmt);
+        *victim = evict_slot(cmt, old);
+        node_release(cmt, old);
+    }
+    int32_t n = node_alloc(cmt, key);
+    list_push(cmt, cmt->policy == CMT_SLRU ? LIST_PROBATION : LIST_MAIN, n);
+    cmt->nodes[n].slot = cmt->free_slots[--cmt->free_slot_count];
+    return cmt->nodes[n].slot;
+}
+
+int32_t CmtPeek(const Cmt *cmt, uint64_t key) {
+    int32_t n = find(cmt, key);
+    return n != CMT_NONE ? cmt->nodes[n].slot : CMT_NONE;
+}
+
+void CmtRemove(Cmt *cmt, uint64_t key) {
+    int32_t n = find(cmt, key);
+    if (n != CMT_NONE) {
+        node_release(cmt, n);
+    }
+}
+
+void CmtStats(const Cmt *cmt, ftl_stats *stats) {
+    stats->cmtHits += cmt->hits;
+    stats->cmtMisses += cmt->misses;
+    stats->cmtEvictions += cmt->evictions;
+}
@@ -0,0 +1,73 @@
+#ifndef CMT_H
+#define CMT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ftl_ops.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CMT_NONE (-1)
+#define CMT_SLRU_PROTECTED_PERCENT 80   // SLRU保护段占容量的比例
+
+// 链表，head为最久未用端，tail为最近使用端；节点之间用下标相连
+typedef struct {
+    int32_t head;
+    int32_t tail;
+    uint32_t size;
+} cmt_list;
+
+typedef struct {
+    uint64_t key;
+    int32_t hnext;          // 哈希链
+    int32_t prev;
+    int32_t next;
+    int32_t slot;           // 所在缓存槽，ARC的影子节点为CMT_NONE
+    uint8_t list;           // 所在链表
+    uint8_t ref;            // CLOCK的访问位
+} cmt_node;
+
+// 缓存映射表（CMT）：按key（映射页号）哈希索引，替换策略可选，查找、插入、删除都是O(1)。
+// 只管理key和槽号，槽中存什么由调用方决定；槽号在0到容量-1之间，逐出后由新插入的key复用。
+// ARC另外为最近逐出的key保留同样数量的影子节点，不占槽
+typedef struct {
+    cmt_policy policy;
+    uint32_t capacity;
+    cmt_node *nodes;
+    int32_t *buckets;
+    uint64_t bucket_mask;
+    int32_t free_node;      // 空闲节点链，用hnext相连
+    int32_t *free_slots;
+    uint32_t free_slot_count;
+    cmt_list lists[4];      // LRU/CLOCK用0；SLRU为试用段、保护段；ARC为T1、T2、B1、B2
+    uint32_t arc_target;    // ARC中T1的目标大小p
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+} Cmt;
+
+// capacity为可缓存的key数。失败返回false
+bool CmtInit(Cmt *cmt, uint32_t capacity, cmt_policy policy);
+void CmtFree(Cmt *cmt);
+uint64_t CmtMemory(const Cmt *cmt);
+// 命中时按策略记一次访问并返回槽号，否则返回CMT_NONE；计入命中率
+int32_t CmtLookup(Cmt *cmt, uint64_t key);
+// 插入不在缓存中的key并返回其槽号。缓存已满时先按策略逐出一项，*victim为被逐出的key，
+// 返回的就是它腾出的槽，调用方要先处理槽中原有的内容；没有逐出时*victim为CMT_NONE
+int32_t CmtInsert(Cmt *cmt, uint64_t key, int64_t *victim);
+// 插入不在缓存中的key时会被逐出的key，缓存未满时返回CMT_NONE。CLOCK的指针可能因此前移
+int64_t CmtVictim(Cmt *cmt, uint64_t key);
+// 返回key所在的槽，不在缓存中时返回CMT_NONE；不计入命中率也不调整位置
+int32_t CmtPeek(const Cmt *cmt, uint64_t key);
+// 从缓存中去掉key，不留影子
+void CmtRemove(Cmt *cmt, uint64_t key);
+// 累加到stats的cmtHits、cmtMisses和cmtEvictions
+void CmtStats(const Cmt *cmt, ftl_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CMT_H
@@ -1,355 +1,546 @@
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
-#include "ftl.h"
+#include "ftl_ops.h"
+#include "write_buffer.h"
+#include "arena.h"
+#include "section.h"
+#include "group_dir.h"
+#include "xlate_cache.h"
+#include "checkpoint.h"
+#include "journal.h"
 
 #define MAX_RECURSION_DEPTH 16
-#define NUMBER_OF_SECTORS 250000
 #define SECTORS_PER_GROUP 256
 #define FLASH_PAGE_SIZE 4096
-#define WRITE_BUFFER_SIZE 256
-#define INVALID_START 0xFF  // 使用0xFF表示无效（uint8_t的最大值）
+#define COMPACT_LEVELS 4        // 组的层数超过该值时压缩
+#define COMPACT_MIN_SLOTS 8     // 压缩后槽位至少再增长该值才重新检查
+#define COMPACT_LEVEL_SLOTS 64  // 单层槽位达到该值时压缩
+#define BITMAP_WORDS (SECTORS_PER_GROUP / 64)
 
-static uint64_t memoryUsed = 0;
-static uint64_t memoryMax = 0;
-
-// 写缓冲区结构
-typedef struct {
-    uint64_t lba[WRITE_BUFFER_SIZE];
-    int count;
-    uint32_t next_ppn;
-} WriteBuffer;
-
-typedef struct {
-    uint8_t start;
-    uint8_t length;
-    uint8_t step;
-    uint32_t b;   //应该可以移除
-    // 移除了valid字段
-} section;
 
+// 层内各段按start升序排列，覆盖的范围互不重叠
 typedef struct {
     section *sec;
-    uint8_t size;
-    uint8_t capacity;
+    uint16_t size;          // 一层最多可有256个段，uint8在扩容翻倍时会回绕成0
+    uint16_t capacity;
 } levelsec;
 
+typedef uint64_t level_bitmap[BITMAP_WORDS];
+
+// 读时先查mapped，没写过的偏移直接返回；否则第一个present含该偏移的层就是答案所在层。
+// 只有一层的组不需要present，大多数组都是这样，因此层数达到2时才分配
 typedef struct {
     levelsec *levels;
+    level_bitmap *present;  // present[j]为第j层各段步长点的并集；为NULL时读逐层查找
     uint8_t level_count;
+    uint16_t compact_floor; // 槽位总数达到该值前不再尝试压缩，避免反复压缩已经紧凑的组
+    uint64_t mapped[BITMAP_WORDS];  // 写过的偏移，只增不减；推过最底层被丢弃的偏移仍置位
 } table;
 
 typedef struct {
-    table t[NUMBER_OF_SECTORS];
+    GroupDir groups;        // 组号到table的目录，组表在首次落盘写到时分配
     WriteBuffer write_buffer;
+    XlateCache cache;       // 读结果缓存，落盘时整体失效
+    Arena arena;            // levels和各层的段数组都从这里分配，占用即memoryUsed
 } FTL;
 
-static FTL *ftl = NULL;
-
-void FTLInit() {
-    ftl = calloc(1, sizeof(FTL));
+static FTL *create_instance(const ftl_config *config) {
+    // memoryUsed只统计段映射占用的内存，组目录不计入
+    FTL *ftl = FTLAllocInstance(sizeof(FTL));
     if (!ftl) {
-        return;
+        return NULL;
     }
+    ArenaInit(&ftl->arena);
     
-    memoryUsed += sizeof(FTL);
-    ftl->write_buffer.next_ppn = 1000;
+    uint64_t groups = (config->lba_count + SECTORS_PER_GROUP - 1) / SECTORS_PER_GROUP;
+    if (!GroupDirInit(&ftl->groups, groups, sizeof(table))) {
+        free(ftl);
+        return NULL;
+    }
+    if (!WriteBufferInit(&ftl->write_buffer, config, SECTORS_PER_GROUP)) {
+        GroupDirFree(&ftl->groups);
+        free(ftl);
+        return NULL;
+    }
+    if (!XlateCacheInit(&ftl->cache, config->xlate_cache_entries)) {
+        WriteBufferFree(&ftl->write_buffer);
+        GroupDirFree(&ftl->groups);
+        free(ftl);
+        return NULL;
+    }
+    return ftl;
 }
 
-void FTLDestroy() {
+static void FTLDestroy(void *handle) {
+    FTL *ftl = handle;
     if (!ftl) return;
     
-    for (int i = 0; i < NUMBER_OF_SECTORS; i++) {
-        for (int j = 0; j < ftl->t[i].level_count; j++) {
-            if (ftl->t[i].levels[j].sec) {
-                free(ftl->t[i].levels[j].sec);
+    ArenaFree(&ftl->arena);
+    GroupDirFree(&ftl->groups);
+    WriteBufferFree(&ftl->write_buffer);
+    XlateCacheFree(&ftl->cache);
+    free(ftl);
+}
+
+// 层内各段按start升序排列且互不重叠。返回最后一个start不大于offset的段的下标，
+// 没有时返回-1。无分支的二分查找，循环次数只取决于段数
+static inline int find_section(const levelsec *lsec, int offset) {
+    const section *base = lsec->sec;
+    int n = lsec->size;
+    if (n == 0 || section_start(base[0]) > offset) {
+        return -1;
+    }
+    while (n > 1) {
+        int half = n >> 1;
+        base = section_start(base[half]) <= offset ? base + half : base;
+        n -= half;
+    }
+    return (int)(base - lsec->sec);
+}
+
+static inline bool bitmap_test(const uint64_t *bits, int offset) {
+    return (bits[offset / 64] >> (offset % 64) & 1) != 0;
+}
+
+// 段的各个步长点
+static void section_points(section sec, uint64_t *bits) {
+    memset(bits, 0, BITMAP_WORDS * sizeof(uint64_t));
+    int step = section_step(sec);
+    int end = step ? section_end(sec) : section_start(sec);
+    for (int o = section_start(sec); o <= end; o += step ? step : 1) {
+        bits[o / 64] |= 1ULL << (o % 64);
+    }
+}
+
+static void release_present(FTL *ftl, table *t) {
+    ArenaRelease(&ftl->arena, t->present, t->level_count * sizeof(level_bitmap));
+    t->present = NULL;
+}
+
+// 按各层现有的段重建present，分配失败时不用present
+static void build_present(FTL *ftl, table *t) {
+    t->present = ArenaAlloc(&ftl->arena, t->level_count * sizeof(level_bitmap));
+    if (!t->present) {
+        return;
+    }
+    memset(t->present, 0, t->level_count * sizeof(level_bitmap));
+    for (int j = 0; j < t->level_count; j++) {
+        for (int i = 0; i < t->levels[j].size; i++) {
+            level_bitmap points;
+            section_points(t->levels[j].sec[i], points);
+            for (int w = 0; w < BITMAP_WORDS; w++) {
+                t->present[j][w] |= points[w];
             }
         }
-        if (ftl->t[i].levels) {
-            free(ftl->t[i].levels);
-        }
     }
-    free(ftl);
-    ftl = NULL;
 }
 
-void sort_lba_array(uint64_t *lba_array, int size) {
-    for (int i = 1; i < size; i++) {
-        uint64_t key = lba_array[i];
-        int j = i - 1;
-        while (j >= 0 && lba_array[j] > key) {
-            lba_array[j + 1] = lba_array[j];
-            j--;
+// 确保第level层存在，返回该层
+static levelsec *ensure_level(FTL *ftl, int idx, int level) {
+    table *t = GroupDirTouch(&ftl->groups, idx);
+    if (!t) {
+        return NULL;
+    }
+    while (t->level_count <= level) {
+        uint8_t new_count = t->level_count + 1;
+        levelsec *new_levels = ArenaRealloc(&ftl->arena, t->levels, t->level_count * sizeof(levelsec),
+                                            new_count * sizeof(levelsec));
+        if (!new_levels) {
+            fprintf(stderr, "Failed to realloc memory for levels\n");
+            return NULL;
+        }
+        t->levels = new_levels;
+
+        // 初始化新扩展的层级
+        memset(&t->levels[t->level_count], 0, sizeof(levelsec));
+        if (t->present) {
+            level_bitmap *present = ArenaRealloc(&ftl->arena, t->present, t->level_count * sizeof(level_bitmap),
+                                                 new_count * sizeof(level_bitmap));
+            if (present) {
+                memset(&present[t->level_count], 0, sizeof(level_bitmap));
+                t->present = present;
+            } else {
+                release_present(ftl, t);
+            }
+            t->level_count = new_count;
+        } else {
+            t->level_count = new_count;
+            if (new_count >= 2) {
+                build_present(ftl, t);
+            }
         }
-        lba_array[j + 1] = key;
     }
+    return &t->levels[level];
 }
 
-// 判断section是否有效
-bool is_section_valid(section *sec) {
-    return sec->start != INVALID_START;
+// 按start有序插入，调用方保证新段与层内已有的段不重叠
+static bool level_insert(FTL *ftl, levelsec *lsec, section sec) {
+    if (lsec->size >= lsec->capacity) {
+        uint16_t new_capacity = lsec->capacity == 0 ? 4 : lsec->capacity * 2;
+        section *new_secs = ArenaRealloc(&ftl->arena, lsec->sec, lsec->capacity * sizeof(section),
+                                         new_capacity * sizeof(section));
+        if (!new_secs) {
+            fprintf(stderr, "Failed to realloc memory for sections\n");
+            return false;
+        }
+        lsec->sec = new_secs;
+        lsec->capacity = new_capacity;
+    }
+    int pos = find_section(lsec, section_start(sec)) + 1;
+    memmove(&lsec->sec[pos + 1], &lsec->sec[pos], (lsec->size - pos) * sizeof(section));
+    lsec->sec[pos] = sec;
+    lsec->size++;
+    return true;
 }
 
-// 重叠检测函数
-bool is_overlap(section *a, section *b) {
-    // 如果任意一个section无效，则不重叠
-    if (!is_section_valid(a) || !is_section_valid(b)) {
+// 截取段中落在[lo, hi]内的那些点，保持原步长，PPN随起点后移。没有点时返回false
+static bool clip_section(section sec, int lo, int hi, section *out) {
+    int start = section_start(sec);
+    int step = section_step(sec);
+    int last = step ? section_end(sec) : start;  // 步长为0的段只有起点一个点
+    if (lo < start) lo = start;
+    if (hi > last) hi = last;
+    if (lo > hi) {
         return false;
     }
-    
-    // 处理单个元素的情况
-    uint8_t a_end =(a->start + a->length) ;
-    uint8_t b_end =(b->start + b->length) ;
-    
-    // 对于单个元素，我们只检查精确匹配
-    
-    
-    // 对于连续序列，检查范围重叠
-    return !(a->start > b_end || a_end < b->start);
+    int first_k = step ? (lo - start + step - 1) / step : 0;
+    int last_k = step ? (hi - start) / step : 0;
+    if (first_k > last_k) {
+        return false;
+    }
+    *out = section_make(start + first_k * step, (last_k - first_k) * step, step, false,
+                        section_ppn(sec) + first_k);
+    return true;
 }
 
-// 简化的Insert函数 - 使用无效化而不是内存重新分配
-// 使用迭代方式优化的Insert函数
-// 修复后的Insert函数
-// 修改Insert函数，添加循环深度限制
-// 完整的带有循环深度限制的Insert函数
-void Insert(int idx, section new_sec, int start_level) {
-    memoryUsed += sizeof(section);
-
-    if (!ftl || idx < 0 || idx >= NUMBER_OF_SECTORS) {
+// 在start_level层插入新段。与它范围重叠的旧段被切开：新段范围之外的前后两截留在本层，
+// 范围之内的那些点推到下一层（新段的步长点之间仍由它们提供映射），下一层依此类推。
+// 每层因此保持有序且互不重叠；推过MAX_RECURSION_DEPTH层的最旧数据被丢弃
+static void Insert(FTL *ftl, int idx, section new_sec, int start_level) {
+    if (!ftl || idx < 0 || start_level >= MAX_RECURSION_DEPTH) {
         return;
     }
+    levelsec *lsec = ensure_level(ftl, idx, start_level);
+    if (!lsec) {
+        return;
+    }
+
+    int lo = section_start(new_sec), hi = section_end(new_sec);
+    // 层内有序且不重叠，与[lo, hi]重叠的段是连续的一段
+    int first = find_section(lsec, lo);
+    if (first < 0 || section_end(lsec->sec[first]) < lo) {
+        first++;
+    }
+    int last = first;
+    while (last < lsec->size && section_start(lsec->sec[last]) <= hi) {
+        last++;
+    }
 
-    int current_level = start_level;
-    section current_sec = new_sec;
+    // 只有第一个和最后一个重叠段可能伸出[lo, hi]，留在本层的最多两截
+    section kept[2];
+    int kept_count = 0;
+    section pushed[SECTORS_PER_GROUP];
+    int pushed_count = 0;
+    int removed = last - first;
+    for (int i = first; i < last; i++) {
+        section old = lsec->sec[i];
+        if (clip_section(old, 0, lo - 1, &kept[kept_count])) kept_count++;
+        if (clip_section(old, hi + 1, SECTORS_PER_GROUP - 1, &kept[kept_count])) kept_count++;
+        if (clip_section(old, lo, hi, &pushed[pushed_count])) pushed_count++;
+    }
+    if (removed > 0) {
+        memmove(&lsec->sec[first], &lsec->sec[last], (lsec->size - last) * sizeof(section));
+        lsec->size -= removed;
+    }
 
-    while (current_level < MAX_RECURSION_DEPTH) {
-        // 确保层级有足够的空间
-        while (ftl->t[idx].level_count <= current_level) {
-            uint8_t new_count = ftl->t[idx].level_count + 1;
-            levelsec *new_levels = realloc(ftl->t[idx].levels, new_count * sizeof(levelsec));
-            if (!new_levels) {
-                fprintf(stderr, "Failed to realloc memory for levels\n");
-                return;
+    // 推走的点都在[lo, hi]内，其余的点仍在本层；新段的点由本层提供
+    table *t = GroupDirFind(&ftl->groups, idx);
+    level_bitmap points;
+    if (t->present) {
+        for (int i = 0; i < pushed_count; i++) {
+            section_points(pushed[i], points);
+            for (int w = 0; w < BITMAP_WORDS; w++) {
+                t->present[start_level][w] &= ~points[w];
             }
-            ftl->t[idx].levels = new_levels;
-
-            // 初始化新扩展的层级
-            ftl->t[idx].levels[ftl->t[idx].level_count].sec = NULL;
-            ftl->t[idx].levels[ftl->t[idx].level_count].size = 0;
-            ftl->t[idx].levels[ftl->t[idx].level_count].capacity = 0;
-            ftl->t[idx].level_count = new_count;
         }
+    }
+    section_points(new_sec, points);
+    for (int w = 0; w < BITMAP_WORDS; w++) {
+        if (t->present) {
+            t->present[start_level][w] |= points[w];
+        }
+        t->mapped[w] |= points[w];
+    }
 
-        levelsec *current_level_ptr = &ftl->t[idx].levels[current_level];
-        section *conflict_sec = NULL;
-        int conflict_index = -1;
+    bool ok = level_insert(ftl, lsec, new_sec);
+    for (int i = 0; ok && i < kept_count; i++) {
+        ok = level_insert(ftl, lsec, kept[i]);
+    }
 
-        // 查找冲突的section
-        for (int i = 0; i < current_level_ptr->size; i++) {
-            section *existing_sec = &current_level_ptr->sec[i];
-            if (existing_sec->start != 0xFF && is_overlap(existing_sec, &current_sec)) {
-                conflict_sec = existing_sec;
-                conflict_index = i;
-                break;
+    // 递归可能扩展levels数组，之后不再使用lsec
+    for (int i = 0; i < pushed_count; i++) {
+        Insert(ftl, idx, pushed[i], start_level + 1);
+    }
+}
+
+// 按层从上到下查找组内偏移的映射，未映射返回0。
+// 每层最多一个段覆盖该偏移，不在它的步长点上就交给下一层；present不含该偏移的层直接跳过
+static uint64_t lookup_offset(table *t, uint8_t offset) {
+    if (!bitmap_test(t->mapped, offset)) {
+        return 0;
+    }
+    for (int level = 0; level < t->level_count; level++) {
+        levelsec *lsec = &t->levels[level];
+        if (t->present && !bitmap_test(t->present[level], offset)) {
+            continue;
+        }
+        int i = find_section(lsec, offset);
+        if (i < 0) {
+            continue;
+        }
+        section sec = lsec->sec[i];
+        if (offset > section_end(sec)) {
+            continue;
+        }
+        int delta = offset - section_start(sec);
+        int step = section_step(sec);
+        if (step > 0) {
+            if (delta % step == 0) {
+                return (section_ppn(sec) + delta / step) * FLASH_PAGE_SIZE;
             }
+        } else if (delta == 0) {
+            // 单个点
+            return section_ppn(sec) * FLASH_PAGE_SIZE;
         }
+    }
+    
+    return 0; // 未找到映射
+}
 
-        if (conflict_sec != NULL) {
-            // 如果存在重叠的section，根据重叠类型进行处理
-
-            // 1. **新section被旧section完全包含**：把旧section分割成三部分
-            if (current_sec.start <= conflict_sec->start && (current_sec.start + current_sec.length) >= (conflict_sec->start + conflict_sec->length)) {
-                // 保留中间重叠部分到下一层
-                section front_part = *conflict_sec;
-                section overlap_part = *conflict_sec;
-                section back_part = *conflict_sec;
-
-                // 前后部分无重叠，保持在当前层
-                front_part.length = current_sec.start - front_part.start;
-                back_part.start = current_sec.start + current_sec.length;
-                back_part.length = (front_part.start + front_part.length) - back_part.start;
-
-                // 重叠部分推到下一层
-                overlap_part.start = current_sec.start;
-                overlap_part.length = current_sec.length;
-
-                conflict_sec->start = 0xFF;  // 无效化当前冲突的section
-
-                // 插入前后部分到当前层
-                if (front_part.length > 0) {
-                    if (current_level_ptr->size >= current_level_ptr->capacity) {
-                        uint8_t new_capacity = current_level_ptr->capacity == 0 ? 4 : current_level_ptr->capacity * 2;
-                        section *new_secs = realloc(current_level_ptr->sec, new_capacity * sizeof(section));
-                        if (!new_secs) {
-                            fprintf(stderr, "Failed to realloc memory for sections\n");
-                            return;
-                        }
-                        current_level_ptr->sec = new_secs;
-                        current_level_ptr->capacity = new_capacity;
-                    }
-                    current_level_ptr->sec[current_level_ptr->size++] = front_part;
-                    memoryUsed += sizeof(section);
-                }
+// 一次性求出组内每个偏移映射到的PPN，与逐个调用lookup_offset一致，未映射为0：
+// 层内各段互不重叠，上层步长点上已命中的偏移不再被下层覆盖
+static void materialize_group(table *t, uint64_t *map) {
+    bool resolved[SECTORS_PER_GROUP] = {false};
+    memset(map, 0, SECTORS_PER_GROUP * sizeof(uint64_t));
 
-                if (back_part.length > 0) {
-                    if (current_level_ptr->size >= current_level_ptr->capacity) {
-                        uint8_t new_capacity = current_level_ptr->capacity == 0 ? 4 : current_level_ptr->capacity * 2;
-                        section *new_secs = realloc(current_level_ptr->sec, new_capacity * sizeof(section));
-                        if (!new_secs) {
-                            fprintf(stderr, "Failed to realloc memory for sections\n");
-                            return;
-                        }
-                        current_level_ptr->sec = new_secs;
-                        current_level_ptr->capacity = new_capacity;
-                    }
-                    current_level_ptr->sec[current_level_ptr->size++] = back_part;
-                    memoryUsed += sizeof(section);
-                }
+    for (int level = 0; level < t->level_count; level++) {
+        levelsec *lsec = &t->levels[level];
 
-                // 将重叠部分插入下一层
-                if (overlap_part.length > 0) {
-                    Insert(idx, overlap_part, current_level + 1);
+        for (int i = 0; i < lsec->size; i++) {
+            section sec = lsec->sec[i];
+            int step = section_step(sec) ? section_step(sec) : 1;
+            int end = section_step(sec) ? section_end(sec) : section_start(sec);
+            for (int o = section_start(sec), k = 0; o <= end; o += step, k++) {
+                if (!resolved[o]) {
+                    map[o] = section_ppn(sec) + k;
+                    resolved[o] = true;
                 }
-
-                // 当前层已经处理完，直接退出
-                break;
             }
+        }
+    }
+}
 
-            // 2. **新section仅与旧section的前部重叠**：将旧section分割
-            else if (current_sec.start < (conflict_sec->start + conflict_sec->length) && (current_sec.start + current_sec.length) <= (conflict_sec->start + conflict_sec->length)) {
-                // 旧section的前部分与新section重叠，后部分保持在当前层
-                section overlap_part = *conflict_sec;
-                section back_part = *conflict_sec;
-
-                // 前部分无重叠，保持在当前层
-                overlap_part.length = current_sec.start - overlap_part.start;
-                back_part.start = current_sec.start + current_sec.length;
-                back_part.length = (overlap_part.start + overlap_part.length) - back_part.start;
-
-                conflict_sec->start = 0xFF;  // 无效化当前冲突的section
-
-                // 插入前部分到当前层
-                if (overlap_part.length > 0) {
-                    if (current_level_ptr->size >= current_level_ptr->capacity) {
-                        uint8_t new_capacity = current_level_ptr->capacity == 0 ? 4 : current_level_ptr->capacity * 2;
-                        section *new_secs = realloc(current_level_ptr->sec, new_capacity * sizeof(section));
-                        if (!new_secs) {
-                            fprintf(stderr, "Failed to realloc memory for sections\n");
-                            return;
-                        }
-                        current_level_ptr->sec = new_secs;
-                        current_level_ptr->capacity = new_capacity;
-                    }
-                    current_level_ptr->sec[current_level_ptr->size++] = overlap_part;
-                    memoryUsed += sizeof(section);
-                }
-
-                // 插入后部分到当前层
-                if (back_part.length > 0) {
-                    if (current_level_ptr->size >= current_level_ptr->capacity) {
-                        uint8_t new_capacity = current_level_ptr->capacity == 0 ? 4 : current_level_ptr->capacity * 2;
-                        section *new_secs = realloc(current_level_ptr->sec, new_capacity * sizeof(section));
-                        if (!new_secs) {
-                            fprintf(stderr, "Failed to realloc memory for sections\n");
-                            return;
-                        }
-                        current_level_ptr->sec = new_secs;
-                        current_level_ptr->capacity = new_capacity;
-                    }
-                    current_level_ptr->sec[current_level_ptr->size++] = back_part;
-                    memoryUsed += sizeof(section);
-                }
+static void free_levels(FTL *ftl, table *t) {
+    release_present(ftl, t);
+    for (int j = 0; j < t->level_count; j++) {
+        ArenaRelease(&ftl->arena, t->levels[j].sec, t->levels[j].capacity * sizeof(section));
+    }
+    ArenaRelease(&ftl->arena, t->levels, t->level_count * sizeof(levelsec));
+    t->levels = NULL;
+    t->level_count = 0;
+}
 
-                // 将重叠部分插入下一层
-                Insert(idx, overlap_part, current_level + 1);
+typedef struct {
+    uint64_t ppn;
+    int offset;
+} mapped_offset;
+
+static int cmp_mapped_offset(const void *a, const void *b) {
+    const mapped_offset *x = a, *y = b;
+    if (x->ppn != y->ppn) {
+        return x->ppn < y->ppn ? -1 : 1;
+    }
+    return x->offset - y->offset;
+}
 
-                // 当前层已经处理完，直接退出
-                break;
+// succ[o]为PPN正好比map[o]大一的偏移中大于o的最小者，没有时为-1
+static void build_successors(const uint64_t *map, int *succ) {
+    mapped_offset sorted[SECTORS_PER_GROUP];
+    int n = 0;
+    for (int o = 0; o < SECTORS_PER_GROUP; o++) {
+        succ[o] = -1;
+        if (map[o]) {
+            sorted[n].ppn = map[o];
+            sorted[n].offset = o;
+            n++;
+        }
+    }
+    qsort(sorted, n, sizeof(mapped_offset), cmp_mapped_offset);
+
+    for (int i = 0; i < n; i++) {
+        mapped_offset key = { sorted[i].ppn + 1, sorted[i].offset + 1 };
+        int lo = 0, hi = n;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (cmp_mapped_offset(&sorted[mid], &key) < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
             }
+        }
+        if (lo < n && sorted[lo].ppn == key.ppn) {
+            succ[sorted[i].offset] = sorted[lo].offset;
+        }
+    }
+}
 
-            // 3. **新section仅与旧section的后部重叠**：将旧section分割
-            else if (current_sec.start >= conflict_sec->start && (current_sec.start + current_sec.length) > conflict_sec->start) {
-                // 旧section的后部分与新section重叠，前部分保持在当前层
-                section front_part = *conflict_sec;
-                section overlap_part = *conflict_sec;
-
-                // 后部分无重叠，保持在当前层
-                front_part.length = current_sec.start - front_part.start;
-                overlap_part.start = current_sec.start + current_sec.length;
-                overlap_part.length = front_part.length - overlap_part.start;
-
-                conflict_sec->start = 0xFF;  // 无效化当前冲突的section
-
-                // 插入前部分到当前层
-                if (front_part.length > 0) {
-                    if (current_level_ptr->size >= current_level_ptr->capacity) {
-                        uint8_t new_capacity = current_level_ptr->capacity == 0 ? 4 : current_level_ptr->capacity * 2;
-                        section *new_secs = realloc(current_level_ptr->sec, new_capacity * sizeof(section));
-                        if (!new_secs) {
-                            fprintf(stderr, "Failed to realloc memory for sections\n");
-                            return;
-                        }
-                        current_level_ptr->sec = new_secs;
-                        current_level_ptr->capacity = new_capacity;
-                    }
-                    current_level_ptr->sec[current_level_ptr->size++] = front_part;
-                    memoryUsed += sizeof(section);
-                }
+// 压缩一个组：取出当前生效的映射，重新编码成尽量少的层。
+// 每层从小到大贪心地取PPN连续、步长相同的序列，层内各段互不重叠；
+// 落在某段两个步长点之间的偏移在该层查不到，留给下一层。
+// 被上层完全遮住的段不会再出现。编码不了时保持原样
+static void compact_group(FTL *ftl, table *t) {
+    uint64_t map[SECTORS_PER_GROUP];
+    bool pending[SECTORS_PER_GROUP];
+    int remaining = 0;
+    int old_slots = 0, old_widest = 0;
+
+    for (int j = 0; j < t->level_count; j++) {
+        old_slots += t->levels[j].size;
+        if (t->levels[j].size > old_widest) {
+            old_widest = t->levels[j].size;
+        }
+    }
+    materialize_group(t, map);
+    for (int o = 0; o < SECTORS_PER_GROUP; o++) {
+        pending[o] = map[o] != 0;
+        remaining += pending[o];
+    }
+    int succ[SECTORS_PER_GROUP];
+    build_successors(map, succ);
 
-                // 插入重叠部分到下一层
-                if (overlap_part.length > 0) {
-                    Insert(idx, overlap_part, current_level + 1);
-                }
+    section runs[MAX_RECURSION_DEPTH][SECTORS_PER_GROUP];
+    int sizes[MAX_RECURSION_DEPTH];
+    int level_count = 0;
+    int new_slots = 0, new_widest = 0;
 
-                // 当前层已经处理完，直接退出
-                break;
+    while (remaining > 0) {
+        if (level_count >= MAX_RECURSION_DEPTH - 1) {
+            return;
+        }
+        // 最后一层只放单点段，单点之间不会互相遮挡，剩下的偏移一层放完
+        bool singles_only = level_count == MAX_RECURSION_DEPTH - 2;
+        int n = 0;
+        int o = 0;
+        while (o < SECTORS_PER_GROUP) {
+            if (!pending[o]) {
+                o++;
+                continue;
             }
-        } else {
-            // 4. **没有冲突，直接插入当前层**
-            if (current_level_ptr->size >= current_level_ptr->capacity) {
-                uint8_t new_capacity = current_level_ptr->capacity == 0 ? 4 : current_level_ptr->capacity * 2;
-                section *new_secs = realloc(current_level_ptr->sec, new_capacity * sizeof(section));
-                if (!new_secs) {
-                    fprintf(stderr, "Failed to realloc memory for sections\n");
-                    return;
+            // PPN正好接上的后继偏移还没编码时，以两者的距离为步长向后延伸
+            int end = o;
+            int step = 0;
+            int next = succ[o];
+            if (!singles_only && next > o && next - o <= SECTION_MAX_STEP && pending[next]) {
+                step = next - o;
+                end = next;
+                while (succ[end] == end + step && pending[succ[end]]) {
+                    end += step;
                 }
-                current_level_ptr->sec = new_secs;
-                current_level_ptr->capacity = new_capacity;
             }
-            current_level_ptr->sec[current_level_ptr->size++] = current_sec;
-            memoryUsed += sizeof(section);
-            break;
+
+            for (int p = o; p <= end; p += step ? step : 1) {
+                pending[p] = false;
+                remaining--;
+            }
+            runs[level_count][n++] = section_make(o, end - o, step, false, map[o]);
+            o = end + 1;
+        }
+        sizes[level_count++] = n;
+        new_slots += n;
+        if (n > new_widest) {
+            new_widest = n;
         }
     }
-}
 
+    // 段数、层数、最宽一层都没有减少就不替换。压缩后每层最多256个段，各层大小因此有界
+    if (new_slots >= old_slots && level_count >= t->level_count && new_widest >= old_widest) {
+        return;
+    }
 
+    levelsec *levels = NULL;
+    if (level_count > 0) {
+        levels = ArenaAlloc(&ftl->arena, level_count * sizeof(levelsec));
+        if (!levels) {
+            return;
+        }
+        for (int j = 0; j < level_count; j++) {
+            // 与Insert的扩容方式一致，容量取2的幂
+            int capacity = 4;
+            while (capacity < sizes[j]) {
+                capacity *= 2;
+            }
+            levels[j].sec = ArenaAlloc(&ftl->arena, capacity * sizeof(section));
+            if (!levels[j].sec) {
+                for (int k = 0; k < j; k++) {
+                    ArenaRelease(&ftl->arena, levels[k].sec, levels[k].capacity * sizeof(section));
+                }
+                ArenaRelease(&ftl->arena, levels, level_count * sizeof(levelsec));
+                return;
+            }
+            memcpy(levels[j].sec, runs[j], sizes[j] * sizeof(section));
+            levels[j].size = sizes[j];
+            levels[j].capacity = capacity;
+        }
+    }
 
-// 在AlgorithmRun函数结束时添加统计信息
+    free_levels(ftl, t);
+    t->levels = levels;
+    t->level_count = level_count;
+    if (level_count >= 2) {
+        build_present(ftl, t);
+    }
+}
 
-// 检查LBA是否在写缓冲区中
-bool is_lba_in_write_buffer(uint64_t lba) {
-    if (!ftl || ftl->write_buffer.count == 0) {
-        return false;
+// 组的层数过多或某层过大时压缩，只检查本次落盘写到的组
+static void maybe_compact(FTL *ftl, int idx) {
+    table *t = GroupDirFind(&ftl->groups, idx);
+    if (!t) {
+        return;
     }
-    
-    for (int i = 0; i < ftl->write_buffer.count; i++) {
-        if (ftl->write_buffer.lba[i] == lba) {
-            return true;
+    int slots = 0, widest = 0;
+    for (int j = 0; j < t->level_count; j++) {
+        slots += t->levels[j].size;
+        if (t->levels[j].size > widest) {
+            widest = t->levels[j].size;
         }
     }
-    return false;
+    if (slots < t->compact_floor) {
+        return;
+    }
+    if (t->level_count > COMPACT_LEVELS || widest >= COMPACT_LEVEL_SLOTS) {
+        compact_group(ftl, t);
+
+        // 压缩后（或无法再压缩时）的槽位翻倍才重新检查，压缩开销按插入的段均摊
+        slots = 0;
+        for (int j = 0; j < t->level_count; j++) {
+            slots += t->levels[j].size;
+        }
+        int floor = slots * 2 + COMPACT_MIN_SLOTS;
+        t->compact_floor = floor > UINT16_MAX ? UINT16_MAX : floor;
+    }
 }
 
 // ProcessWriteBuffer函数
-void ProcessWriteBuffer() {
+static void ProcessWriteBuffer(FTL *ftl) {
     if (!ftl || ftl->write_buffer.count == 0) return;
+
+    // 映射即将改变，之前缓存的读结果全部作废
+    XlateCacheInvalidate(&ftl->cache);
     
-    sort_lba_array(ftl->write_buffer.lba, ftl->write_buffer.count);
+    WriteBufferSortLBA(&ftl->write_buffer);
     uint32_t current_ppn = ftl->write_buffer.next_ppn;
     
     int idx = 0;
@@ -369,17 +560,11 @@ void ProcessWriteBuffer() {
         // 处理当前组内的所有连续序列
         int group_idx = idx;
         while (group_idx <= group_end) {
-            section sec;
-            sec.start = ftl->write_buffer.lba[group_idx] % SECTORS_PER_GROUP;
-            sec.b = current_ppn * FLASH_PAGE_SIZE;
-            // 不再设置valid字段
+            int start = ftl->write_buffer.lba[group_idx] % SECTORS_PER_GROUP;
             
             // 检查是否是单个元素
             if (group_idx == group_end) {
-                sec.length = 0;
-                sec.step = 0;
-               
-                Insert(current_group, sec, 0);
+                Insert(ftl, current_group, section_make(start, 0, 0, false, current_ppn), 0);
                 current_ppn += 1;
                 group_idx++;
                 continue;
@@ -389,8 +574,8 @@ void ProcessWriteBuffer() {
             int step = ftl->write_buffer.lba[group_idx + 1] - ftl->write_buffer.lba[group_idx];
             int sequence_end = group_idx;
             
-            // 查找具有相同步长的连续序列
-            for (int i = group_idx + 1; i <= group_end; i++) {
+            // 查找具有相同步长的连续序列，步长超出编码范围时按单个元素处理
+            for (int i = group_idx + 1; i <= group_end && step <= SECTION_MAX_STEP; i++) {
                 if (ftl->write_buffer.lba[i] - ftl->write_buffer.lba[i - 1] == step) {
                     sequence_end = i;
                 } else {
@@ -400,172 +585,226 @@ void ProcessWriteBuffer() {
             
             if (sequence_end > group_idx) {
                 // 找到连续序列
-                sec.length = (ftl->write_buffer.lba[sequence_end] % SECTORS_PER_GROUP) - 
-                            (ftl->write_buffer.lba[group_idx] % SECTORS_PER_GROUP);
-                sec.step = step;
+                int length = (ftl->write_buffer.lba[sequence_end] % SECTORS_PER_GROUP) - start;
                 
-                Insert(current_group, sec, 0);
+                Insert(ftl, current_group, section_make(start, length, step, false, current_ppn), 0);
                 current_ppn += (sequence_end - group_idx) + 1;
                 group_idx = sequence_end + 1;
             } else {
                 // 单个元素
-                sec.length = 0;
-                sec.step = 0;
-               
-                Insert(current_group, sec, 0);
+                Insert(ftl, current_group, section_make(start, 0, 0, false, current_ppn), 0);
                 current_ppn += 1;
                 group_idx++;
             }
         }
         
+        maybe_compact(ftl, current_group);
         idx = group_end + 1;
     }
     
-    ftl->write_buffer.next_ppn = current_ppn;
-    ftl->write_buffer.count = 0;
+    WriteBufferCommit(&ftl->write_buffer, current_ppn);
 }
 
 // 修改FTLRead函数，在读取前检查写缓冲区
-uint64_t FTLRead(uint64_t lba) {
+static uint64_t FTLRead(void *handle, uint64_t lba) {
+    FTL *ftl = handle;
     if (!ftl) {
         return 0;
     }
     
-    // 检查LBA是否在写缓冲区中，如果是则先处理缓冲区
-    if (is_lba_in_write_buffer(lba)) {
-        ProcessWriteBuffer();
+    // 仍在写缓冲区中的LBA直接返回落盘时将分配的PPN，不提前落盘
+    uint32_t pending_ppn;
+    if (WriteBufferPendingPPN(&ftl->write_buffer, lba, &pending_ppn)) {
+        return (uint64_t)pending_ppn * FLASH_PAGE_SIZE;
     }
     
-    int idx = lba / SECTORS_PER_GROUP;
+    uint64_t idx = lba / SECTORS_PER_GROUP;
     uint8_t offset = lba % SECTORS_PER_GROUP;
     
-    if (idx < 0 || idx >= NUMBER_OF_SECTORS) {
-        printf("[FTLRead Error] Invalid index: %d for LBA: %lu\n", idx, lba);
+    if (idx >= ftl->groups.group_count) {
+        printf("[FTLRead Error] Invalid index: %lu for LBA: %lu\n", idx, lba);
         return 0;
     }
     
-    table *t = &ftl->t[idx];
-    
-    // 从顶层到底层搜索
-    for (int level = 0; level < t->level_count; level++) {
-        levelsec *lsec = &t->levels[level];
-        
-        for (int i = 0; i < lsec->size; i++) {
-            section *sec = &lsec->sec[i];
-            
-            // 跳过无效的section
-            if (!is_section_valid(sec)) {
-                continue;
-            }
-            
-            // 检查LBA是否在这个段内
-            if (offset >= sec->start && offset <= sec->start + sec->length) {
-                
-                    // 精确映射：使用步长计算
-                    if (sec->step > 0) {
-                        // 检查是否在步长点上
-                        if ((offset - sec->start) % sec->step == 0) {
-                            uint32_t ppa_offset = (offset - sec->start) / sec->step;
-                            uint64_t result = sec->b + ppa_offset * FLASH_PAGE_SIZE;
-                            return result;
-                        }
-                    }
-                else {
-                    // 近似段（单个点）：直接匹配start值
-                    if (offset == sec->start) {
-                        return sec->b;
-                    }
-                }
-                break; // 在这个段中但没找到匹配，跳出内层循环
-            }
-        }
+    // 从未写过的组没有分配组表
+    table *t = GroupDirFind(&ftl->groups, idx);
+    if (!t) {
+        return 0;
     }
     
-    return 0; // 未找到映射
+    uint64_t result;
+    if (XlateCacheLookup(&ftl->cache, lba, &result)) {
+        return result;
+    }
+    result = lookup_offset(t, offset);
+    XlateCacheStore(&ftl->cache, lba, result);
+    return result;
 }
 
-bool FTLModify(uint64_t lba) {
+static bool FTLModify(void *handle, uint64_t lba) {
+    FTL *ftl = handle;
     if (!ftl) {
         return false;
     }
     
-    // 添加到写缓冲区
-    if (ftl->write_buffer.count < WRITE_BUFFER_SIZE) {
-        ftl->write_buffer.lba[ftl->write_buffer.count++] = lba;
-    } else {
+    if (lba / SECTORS_PER_GROUP >= ftl->groups.group_count) {
+        return false;
+    }
+    
+    // 添加到写缓冲区，已缓冲的LBA原地覆盖
+    if (!WriteBufferAdd(&ftl->write_buffer, lba)) {
         return false;
     }
     
     // 如果缓冲区满了，处理缓冲区
-    if (ftl->write_buffer.count >= WRITE_BUFFER_SIZE) {
-        ProcessWriteBuffer();
+    if (ftl->write_buffer.count >= ftl->write_buffer.capacity) {
+        ProcessWriteBuffer(ftl);
     }
     
     return true;
 }
 
-uint32_t AlgorithmRun(IOVector *ioVector, const char *filename) {
-    if (!ioVector) {
-        return RETURN_ERROR;
-    }
-    
-    if (!ioVector->ioArray) {
-        return RETURN_ERROR;
-    }
-    
-    struct timeval start, end;
-    FILE *file = filename ? fopen(filename, "w") : stdout;
-    if (!file) {
-        printf("[AlgorithmRun Error] Failed to open output file: %s\n", filename);
-        return RETURN_ERROR;
+// 落盘后等日志写出，此前的修改在返回时都已持久
+static void FTLFlush(void *handle) {
+    FTL *ftl = handle;
+    ProcessWriteBuffer(ftl);
+    JournalSync(ftl->write_buffer.journal);
+}
+
+static void *FTLInit(const ftl_config *config) {
+    FTL *ftl = create_instance(config);
+    if (ftl && !WriteBufferAttachJournal(&ftl->write_buffer, config, FTLFlush, ftl)) {
+        FTLDestroy(ftl);
+        return NULL;
     }
-    
-    // 初始化 FTL
-    FTLInit();
-    
-    // 重置内存统计
-    memoryUsed = 0;
-    memoryMax = 0;
+    return ftl;
+}
 
-    // 记录开始时间
-    gettimeofday(&start, NULL);
+static void FTLStats(void *handle, ftl_stats *stats) {
+    FTL *ftl = handle;
+    stats->memoryUsed = ftl->arena.live;
+    stats->memoryMax = ftl->arena.peak;
+    stats->cacheMemory = XlateCacheMemory(&ftl->cache);
+    JournalStats(ftl->write_buffer.journal, stats);
+}
 
-    for (uint64_t i = 0; i < ioVector->len; ++i) {
-        if (ioVector->ioArray[i].type == IO_READ) {
-            uint64_t ret = FTLRead(ioVector->ioArray[i].lba);
-            fprintf(file, "%llu\n", (unsigned long long)ret);
-        } else {
-            if (!FTLModify(ioVector->ioArray[i].lba)) {
-                printf("[AlgorithmRun Error] Failed to modify LBA: %lu\n", ioVector->ioArray[i].lba);
-            }
+// 检查点载荷：组数、写缓冲区，然后是每个写过的组：组号、compact_floor和层数、mapped、
+// 各层的段数和容量及段数组，最后是CKPT_END。present不写出，恢复时由段重新算出
+static bool FTLCheckpoint(void *handle, const char *path) {
+    FTL *ftl = handle;
+    CkptWriter w;
+    if (!CkptCreate(&w, path, ftl_ops_segments.name)) {
+        return false;
+    }
+    CkptPutU64(&w, ftl->groups.group_count);
+    WriteBufferSave(&ftl->write_buffer, &w);
+    uint64_t group = 0;
+    for (table *t; (t = GroupDirNext(&ftl->groups, &group)); group++) {
+        if (t->level_count == 0) {
+            continue;
         }
-        
-        if (memoryUsed > memoryMax) {
-            memoryMax = memoryUsed;
+        CkptPutU64(&w, group);
+        CkptPutU64(&w, (uint64_t)t->compact_floor << 8 | t->level_count);
+        CkptPut(&w, t->mapped, sizeof(t->mapped));
+        for (int j = 0; j < t->level_count; j++) {
+            levelsec *lsec = &t->levels[j];
+            CkptPutU64(&w, (uint64_t)lsec->capacity << 16 | lsec->size);
+            CkptPut(&w, lsec->sec, lsec->size * sizeof(section));
         }
     }
-    
-    // 处理缓冲区中剩余的数据
-    ProcessWriteBuffer();
-
-    // 记录结束时间
-    gettimeofday(&end, NULL);
+    CkptPutU64(&w, CKPT_END);
+    // 检查点已包含日志中的全部记录
+    return CkptCommit(&w) && JournalTruncate(ftl->write_buffer.journal);
+}
 
-    FTLDestroy();
+// 按原容量分配各层并整块拷入段数组，占用的内存与写出时相同
+static bool load_group(FTL *ftl, CkptImage *img, uint64_t group) {
+    uint64_t counts;
+    const uint64_t *mapped;
+    if (!CkptGetU64(img, &counts) || !(mapped = CkptGet(img, sizeof(level_bitmap)))) {
+        return false;
+    }
+    int level_count = counts & 0xFF;
+    table *t = GroupDirTouch(&ftl->groups, group);
+    if (!t || t->level_count || level_count == 0) {
+        return false;
+    }
+    t->levels = ArenaAlloc(&ftl->arena, level_count * sizeof(levelsec));
+    if (!t->levels) {
+        return false;
+    }
+    memset(t->levels, 0, level_count * sizeof(levelsec));
+    t->level_count = level_count;
+    t->compact_floor = counts >> 8;
+    memcpy(t->mapped, mapped, sizeof(t->mapped));
+
+    for (int j = 0; j < level_count; j++) {
+        uint64_t sizes;
+        if (!CkptGetU64(img, &sizes) || sizes >> 16 > UINT16_MAX || (sizes & 0xFFFF) > sizes >> 16) {
+            return false;
+        }
+        levelsec *lsec = &t->levels[j];
+        int size = sizes & 0xFFFF;
+        const section *sec = CkptGet(img, size * sizeof(section));
+        if (!sec) {
+            return false;
+        }
+        if (sizes >> 16) {
+            lsec->sec = ArenaAlloc(&ftl->arena, (sizes >> 16) * sizeof(section));
+            if (!lsec->sec) {
+                return false;
+            }
+            lsec->capacity = sizes >> 16;
+            memcpy(lsec->sec, sec, size * sizeof(section));
+            lsec->size = size;
+        }
+    }
+    if (level_count >= 2) {
+        build_present(ftl, t);
+    }
+    return true;
+}
 
-    if (file != stdout) {
-        fclose(file);
+static void *FTLRestore(const ftl_config *config, const char *path) {
+    CkptImage img;
+    if (!CkptOpen(&img, path, ftl_ops_segments.name)) {
+        return NULL;
     }
-    
-    // 计算秒数和微秒数
-    long seconds = end.tv_sec - start.tv_sec;
-    long useconds = end.tv_usec - start.tv_usec;
-
-    // 总微秒数
-    double during = (seconds * 1000000.0 + useconds) / 1000.0;  // 转换为毫秒
-    double throughput = (double)ioVector->len / during;
-    printf("algorithmRunningDuration:\t %f ms\n", throughput);
-    printf("Max memory used:\t\t %llu B\n", (unsigned long long)memoryMax);
-
-    return RETURN_OK;
-}
\ No newline at end of file
+    FTL *ftl = create_instance(config);
+    if (!ftl) {
+        CkptClose(&img);
+        return NULL;
+    }
+    uint64_t group_count, group;
+    bool ok = CkptGetU64(&img, &group_count) && group_count == ftl->groups.group_count &&
+              WriteBufferLoad(&ftl->write_buffer, &img);
+    while (ok && (ok = CkptGetU64(&img, &group)) && group != CKPT_END) {
+        ok = load_group(ftl, &img, group);
+    }
+    CkptClose(&img);
+    if (!ok) {
+        fprintf(stderr, "Cannot restore %s from %s: corrupt payload or different LBA range\n",
+                ftl_ops_segments.name, path);
+        FTLDestroy(ftl);
+        return NULL;
+    }
+    // 检查点之后的更新在日志中
+    if (!WriteBufferAttachJournal(&ftl->write_buffer, config, FTLFlush, ftl)) {
+        FTLDestroy(ftl);
+        return NULL;
+    }
+    return ftl;
+}
+
+const ftl_ops ftl_ops_segments = {
+    .name = "segments",
+    .group_size = SECTORS_PER_GROUP,
+    .init = FTLInit,
+    .destroy = FTLDestroy,
+    .read = FTLRead,
+    .modify = FTLModify,
+    .flush = FTLFlush,
+    .stats = FTLStats,
+    .checkpoint = FTLCheckpoint,
+    .restore = FTLRestore,
+};
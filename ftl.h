@@ -4,20 +4,40 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "../public.h"
+#include "ftl_ops.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-void FTLInit();
-void FTLDestroy();
-uint64_t FTLRead(uint64_t lba);
-bool FTLModify(uint64_t lba);
+// 不透明的FTL实例句柄，同一进程内可以同时存在多个互不影响的实例
+typedef struct FTLHandle FTLHandle;
+
+// scheme为NULL时取FTL_SCHEME（多个时取第一个），默认segments；
+// config为NULL时使用FTLDefaultConfig。失败返回NULL
+FTLHandle *FTLInit(const char *scheme, const ftl_config *config);
+void FTLDestroy(FTLHandle *ftl);
+uint64_t FTLRead(FTLHandle *ftl, uint64_t lba);
+bool FTLModify(FTLHandle *ftl, uint64_t lba);
+// 把写缓冲区中尚未落盘的映射写入映射表
+void FTLFlush(FTLHandle *ftl);
+void FTLStats(FTLHandle *ftl, ftl_stats *stats);
+// 把实例的映射表和写缓冲区写入检查点文件，方案不支持或写入失败时返回false
+bool FTLCheckpoint(FTLHandle *ftl, const char *path);
+// 从FTLCheckpoint写出的文件恢复实例，代替FTLInit；scheme和config的含义同FTLInit。失败返回NULL
+FTLHandle *FTLRestore(const char *scheme, const ftl_config *config, const char *path);
+// FTL_SCHEME可以是逗号分隔的多个方案，在同一份trace上依次运行；
+// FTL_SHARDS=N时支持分片的方案按LBA组拆成N个实例并行回放；
+// FTL_RESTORE=文件时从检查点恢复代替初始化，FTL_CHECKPOINT=文件时回放结束后写出检查点，
+// FTL_JOURNAL=文件时记映射日志，启动时先在检查点（或空表）上重放；
+// 多个方案时这些文件名加上.方案名；
+// 实例配置取自FTLConfigFromEnv
 uint32_t AlgorithmRun(IOVector *ioVector, const char *filename);
+uint32_t AlgorithmRunScheme(const char *scheme, IOVector *ioVector, const char *filename);
 
 
 #ifdef __cplusplus
 }
 #endif
 
-#endif  // FTL_H
\ No newline at end of file
+#endif  // FTL_H
@@ -1,144 +1,185 @@
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
-#include "ftl.h"
+#include "ftl_ops.h"
+#include "write_buffer.h"
+#include "arena.h"
+#include "section.h"
+#include "group_dir.h"
+#include "xlate_cache.h"
+#include "section_scan.h"
+#include "checkpoint.h"
+#include "journal.h"
 
 #define MAX_RECURSION_DEPTH 16
-#define NUMBER_OF_SECTORS 250000
 #define SECTORS_PER_GROUP 256
 #define FLASH_PAGE_SIZE 4096
-#define WRITE_BUFFER_SIZE 256
 #define INVALID_START 0xFF  // 使用0xFF表示无效（uint8_t的最大值）
+#define COMPACT_LEVELS 4        // 组的层数超过该值时压缩
+#define COMPACT_MIN_SLOTS 8     // 槽位不少于该值且一半以上是无效段时压缩
+#define COMPACT_LEVEL_SLOTS 64  // 单层槽位达到该值时压缩
 
-static uint64_t memoryUsed = 0;
-static uint64_t memoryMax = 0;
-
-// 写缓冲区结构
-typedef struct {
-    uint64_t lba[WRITE_BUFFER_SIZE];
-    int count;
-    uint32_t next_ppn;
-} WriteBuffer;
-
-typedef struct {
-    uint8_t start;
-    uint8_t length;
-    uint8_t step;
-    uint32_t b; 
-    bool accuracy;  
-    // 移除了valid字段
-} section;
 
 typedef struct {
     section *sec;
-    uint8_t size;
-    uint8_t capacity;
+    uint16_t size;          // 一层最多可有256个段，uint8在扩容翻倍时会回绕成0
+    uint16_t capacity;
+    section_bounds bounds;  // 段多的层另存起止偏移，读时整批比较
 } levelsec;
 
 typedef struct {
     levelsec *levels;
     uint8_t level_count;
+    uint16_t compact_floor; // 槽位总数达到该值前不再尝试压缩，避免反复压缩已经紧凑的组
+    uint64_t mapped[SECTORS_PER_GROUP / 64];  // 写过的偏移，只增不减；没写过的偏移读时不查各层
 } table;
 
 typedef struct {
-    table t[NUMBER_OF_SECTORS];
+    GroupDir groups;        // 组号到table的目录，组表在首次落盘写到时分配
     WriteBuffer write_buffer;
+    XlateCache cache;       // 读结果缓存，落盘时整体失效
+    Arena arena;            // levels和各层的段数组都从这里分配，占用即memoryUsed
 } FTL;
 
-static FTL *ftl = NULL;
-
-void FTLInit() {
-    ftl = calloc(1, sizeof(FTL));
+static FTL *create_instance(const ftl_config *config) {
+    // memoryUsed只统计段映射占用的内存，组目录不计入
+    FTL *ftl = FTLAllocInstance(sizeof(FTL));
     if (!ftl) {
-        return;
+        return NULL;
     }
+    ArenaInit(&ftl->arena);
     
-    memoryUsed += sizeof(FTL);
-    ftl->write_buffer.next_ppn = 1000;
+    uint64_t groups = (config->lba_count + SECTORS_PER_GROUP - 1) / SECTORS_PER_GROUP;
+    if (!GroupDirInit(&ftl->groups, groups, sizeof(table))) {
+        free(ftl);
+        return NULL;
+    }
+    if (!WriteBufferInit(&ftl->write_buffer, config, SECTORS_PER_GROUP)) {
+        GroupDirFree(&ftl->groups);
+        free(ftl);
+        return NULL;
+    }
+    if (!XlateCacheInit(&ftl->cache, config->xlate_cache_entries)) {
+        WriteBufferFree(&ftl->write_buffer);
+        GroupDirFree(&ftl->groups);
+        free(ftl);
+        return NULL;
+    }
+    return ftl;
 }
 
-void FTLDestroy() {
+static void FTLDestroy(void *handle) {
+    FTL *ftl = handle;
     if (!ftl) return;
     
-    for (int i = 0; i < NUMBER_OF_SECTORS; i++) {
-        for (int j = 0; j < ftl->t[i].level_count; j++) {
-            if (ftl->t[i].levels[j].sec) {
-                free(ftl->t[i].levels[j].sec);
-            }
-        }
-        if (ftl->t[i].levels) {
-            free(ftl->t[i].levels);
-        }
-    }
+    ArenaFree(&ftl->arena);
+    GroupDirFree(&ftl->groups);
+    WriteBufferFree(&ftl->write_buffer);
+    XlateCacheFree(&ftl->cache);
     free(ftl);
-    ftl = NULL;
-}
-
-void sort_lba_array(uint64_t *lba_array, int size) {
-    for (int i = 1; i < size; i++) {
-        uint64_t key = lba_array[i];
-        int j = i - 1;
-        while (j >= 0 && lba_array[j] > key) {
-            lba_array[j + 1] = lba_array[j];
-            j--;
-        }
-        lba_array[j + 1] = key;
-    }
 }
 
 // 判断section是否有效
-bool is_section_valid(section *sec) {
-    return sec->start != INVALID_START;
+static bool is_section_valid(section *sec) {
+    return section_start(*sec) != INVALID_START;
 }
 
 // 重叠检测函数
-bool is_overlap(section *a, section *b) {
+static bool is_overlap(section *a, section *b) {
     // 如果任意一个section无效，则不重叠
     if (!is_section_valid(a) || !is_section_valid(b)) {
         return false;
     }
     
     // 处理单个元素的情况
-    uint8_t a_end = a->accuracy ? (a->start + a->length) : a->start;
-    uint8_t b_end = b->accuracy ? (b->start + b->length) : b->start;
+    int a_start = section_start(*a), b_start = section_start(*b);
+    int a_end = section_accuracy(*a) ? section_end(*a) : a_start;
+    int b_end = section_accuracy(*b) ? section_end(*b) : b_start;
     
     // 对于单个元素，我们只检查精确匹配
-    if (!a->accuracy && !b->accuracy) {
-        return a->start == b->start;
+    if (!section_accuracy(*a) && !section_accuracy(*b)) {
+        return a_start == b_start;
     }
     
     // 对于连续序列，检查范围重叠
-    return !(a->start > b_end || a_end < b->start);
+    return !(a_start > b_end || a_end < b_start);
+}
+
+// 同步第i个段的起止偏移副本，无效段的范围为空
+static void sync_bounds(levelsec *lsec, int i) {
+    section *sec = &lsec->sec[i];
+    if (is_section_valid(sec)) {
+        section_bounds_set(&lsec->bounds, i, section_start(*sec), section_end(*sec));
+    } else {
+        section_bounds_set(&lsec->bounds, i, INVALID_START, 0);
+    }
+}
+
+// 在层末尾追加一个段
+static bool level_append(FTL *ftl, levelsec *lsec, section sec) {
+    if (lsec->size >= lsec->capacity) {
+        uint16_t new_capacity = lsec->capacity == 0 ? 4 : lsec->capacity * 2;
+        section *new_secs = ArenaRealloc(&ftl->arena, lsec->sec, lsec->capacity * sizeof(section),
+                                         new_capacity * sizeof(section));
+        if (!new_secs) return false;
+        lsec->sec = new_secs;
+        lsec->capacity = new_capacity;
+    }
+    bool created;
+    if (!SectionBoundsReserve(&ftl->arena, &lsec->bounds, lsec->size + 1, &created)) {
+        return false;
+    }
+    lsec->sec[lsec->size++] = sec;
+    if (created) {
+        for (int i = 0; i < lsec->size; i++) {
+            sync_bounds(lsec, i);
+        }
+    } else {
+        sync_bounds(lsec, lsec->size - 1);
+    }
+    return true;
+}
+
+// 层内从from起第一个覆盖offset的有效段的下标，没有时返回-1
+static int first_covering(const levelsec *lsec, int from, uint8_t offset) {
+    if (lsec->bounds.starts) {
+        return SectionScan(lsec->bounds.starts, lsec->bounds.ends, from, lsec->size, offset);
+    }
+    for (int i = from; i < lsec->size; i++) {
+        section sec = lsec->sec[i];
+        if (section_start(sec) != INVALID_START && section_start(sec) <= offset && offset <= section_end(sec)) {
+            return i;
+        }
+    }
+    return -1;
 }
 
 // 简化的Insert函数 - 使用无效化而不是内存重新分配
-void Insert(int idx, section new_sec, int start_level) {
-    memoryUsed += sizeof(section);
-    if (!ftl || idx < 0 || idx >= NUMBER_OF_SECTORS) {
+static void Insert(FTL *ftl, int idx, section new_sec, int start_level) {
+    table *t = ftl ? GroupDirTouch(&ftl->groups, idx) : NULL;
+    if (!t) {
         return;
     }
-    
     int current_level = start_level;
     section current_sec = new_sec;
     
     while (current_level < MAX_RECURSION_DEPTH) {
         // 确保有足够的层级
-        while (ftl->t[idx].level_count <= current_level) {
-            uint8_t new_count = ftl->t[idx].level_count + 1;
-            levelsec *new_levels = realloc(ftl->t[idx].levels, new_count * sizeof(levelsec));
+        while (t->level_count <= current_level) {
+            uint8_t new_count = t->level_count + 1;
+            levelsec *new_levels = ArenaRealloc(&ftl->arena, t->levels,
+                                                t->level_count * sizeof(levelsec),
+                                                new_count * sizeof(levelsec));
             if (!new_levels) return;
-            ftl->t[idx].levels = new_levels;
+            t->levels = new_levels;
             
-            ftl->t[idx].levels[ftl->t[idx].level_count].sec = NULL;
-            ftl->t[idx].levels[ftl->t[idx].level_count].size = 0;
-            ftl->t[idx].levels[ftl->t[idx].level_count].capacity = 0;
-            ftl->t[idx].level_count = new_count;
+            memset(&t->levels[t->level_count], 0, sizeof(levelsec));
+            t->level_count = new_count;
         }
         
-        levelsec *current_level_ptr = &ftl->t[idx].levels[current_level];
+        levelsec *current_level_ptr = &t->levels[current_level];
         section *conflict_sec = NULL;
         int conflict_index = -1;
         
@@ -157,55 +198,322 @@ void Insert(int idx, section new_sec, int start_level) {
             section temp_sec = *conflict_sec;
             
             // 无效化当前层的冲突section
-            conflict_sec->start = INVALID_START;
+            *conflict_sec = section_make(INVALID_START, 0, 0, false, 0);
+            sync_bounds(current_level_ptr, conflict_index);
             
             // 插入当前section到当前层
-            if (current_level_ptr->size >= current_level_ptr->capacity) {
-                uint8_t new_capacity = current_level_ptr->capacity == 0 ? 4 : current_level_ptr->capacity * 2;
-                section *new_secs = realloc(current_level_ptr->sec, new_capacity * sizeof(section));
-                if (!new_secs) return;
-                current_level_ptr->sec = new_secs;
-                current_level_ptr->capacity = new_capacity;
-            }
-            current_level_ptr->sec[current_level_ptr->size++] = current_sec;
+            if (!level_append(ftl, current_level_ptr, current_sec)) return;
             
             // 将冲突的section作为下一轮要处理的section
             current_sec = temp_sec;
             current_level++;
         } else {
             // 没有冲突，直接插入当前层
-            if (current_level_ptr->size >= current_level_ptr->capacity) {
-                uint8_t new_capacity = current_level_ptr->capacity == 0 ? 4 : current_level_ptr->capacity * 2;
-                section *new_secs = realloc(current_level_ptr->sec, new_capacity * sizeof(section));
-                if (!new_secs) return;
-                current_level_ptr->sec = new_secs;
-                current_level_ptr->capacity = new_capacity;
-            }
-            current_level_ptr->sec[current_level_ptr->size++] = current_sec;
+            level_append(ftl, current_level_ptr, current_sec);
             break;
         }
     }
 }
 
-// 检查写缓冲区中是否包含指定的LBA
-bool is_lba_in_write_buffer(uint64_t lba) {
-    if (!ftl || ftl->write_buffer.count == 0) {
-        return false;
+// 按层从上到下查找组内偏移的映射，未映射返回0
+static uint64_t lookup_offset(table *t, uint8_t offset) {
+    for (int level = 0; level < t->level_count; level++) {
+        levelsec *lsec = &t->levels[level];
+        
+        // 每层只看第一个覆盖该偏移的段，不在它的步长点上就交给下一层
+        int i = first_covering(lsec, 0, offset);
+        if (i < 0) {
+            continue;
+        }
+        section *sec = &lsec->sec[i];
+        int delta = offset - section_start(*sec);
+        if (section_accuracy(*sec)) {
+            // 精确映射：使用步长计算
+            int step = section_step(*sec);
+            // 检查是否在步长点上
+            if (step > 0 && delta % step == 0) {
+                return (section_ppn(*sec) + delta / step) * FLASH_PAGE_SIZE;
+            }
+        } else {
+            // 近似段（单个点）：直接匹配start值
+            if (delta == 0) {
+                return section_ppn(*sec) * FLASH_PAGE_SIZE;
+            }
+        }
     }
     
-    for (int i = 0; i < ftl->write_buffer.count; i++) {
-        if (ftl->write_buffer.lba[i] == lba) {
-            return true;
+    return 0; // 未找到映射
+}
+
+// 一次性求出组内每个偏移映射到的PPN，与逐个调用lookup_offset一致，未映射为0：
+// 每层里第一个覆盖该偏移的段说了算，不在步长点上就交给下一层
+static void materialize_group(table *t, uint64_t *map) {
+    bool resolved[SECTORS_PER_GROUP] = {false};
+    memset(map, 0, SECTORS_PER_GROUP * sizeof(uint64_t));
+
+    for (int level = 0; level < t->level_count; level++) {
+        levelsec *lsec = &t->levels[level];
+        bool claimed[SECTORS_PER_GROUP] = {false};
+
+        for (int i = 0; i < lsec->size; i++) {
+            section *sec = &lsec->sec[i];
+            if (!is_section_valid(sec)) {
+                continue;
+            }
+            int start = section_start(*sec);
+            int step = section_step(*sec);
+            int end = section_end(*sec);
+            if (end >= SECTORS_PER_GROUP) {
+                end = SECTORS_PER_GROUP - 1;
+            }
+            for (int o = start; o <= end; o++) {
+                if (claimed[o]) {
+                    continue;
+                }
+                claimed[o] = true;
+                if (resolved[o]) {
+                    continue;
+                }
+                if (section_accuracy(*sec)) {
+                    if (step > 0 && (o - start) % step == 0) {
+                        map[o] = section_ppn(*sec) + (o - start) / step;
+                        resolved[o] = true;
+                    }
+                } else if (o == start) {
+                    map[o] = section_ppn(*sec);
+                    resolved[o] = true;
+                }
+            }
+        }
+    }
+}
+
+static void free_levels(FTL *ftl, table *t) {
+    for (int j = 0; j < t->level_count; j++) {
+        ArenaRelease(&ftl->arena, t->levels[j].sec, t->levels[j].capacity * sizeof(section));
+        SectionBoundsRelease(&ftl->arena, &t->levels[j].bounds);
+    }
+    ArenaRelease(&ftl->arena, t->levels, t->level_count * sizeof(levelsec));
+    t->levels = NULL;
+    t->level_count = 0;
+}
+
+typedef struct {
+    uint64_t ppn;
+    int offset;
+} mapped_offset;
+
+static int cmp_mapped_offset(const void *a, const void *b) {
+    const mapped_offset *x = a, *y = b;
+    if (x->ppn != y->ppn) {
+        return x->ppn < y->ppn ? -1 : 1;
+    }
+    return x->offset - y->offset;
+}
+
+// succ[o]为PPN正好比map[o]大一的偏移中大于o的最小者，没有时为-1
+static void build_successors(const uint64_t *map, int *succ) {
+    mapped_offset sorted[SECTORS_PER_GROUP];
+    int n = 0;
+    for (int o = 0; o < SECTORS_PER_GROUP; o++) {
+        succ[o] = -1;
+        if (map[o]) {
+            sorted[n].ppn = map[o];
+            sorted[n].offset = o;
+            n++;
+        }
+    }
+    qsort(sorted, n, sizeof(mapped_offset), cmp_mapped_offset);
+
+    for (int i = 0; i < n; i++) {
+        mapped_offset key = { sorted[i].ppn + 1, sorted[i].offset + 1 };
+        int lo = 0, hi = n;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (cmp_mapped_offset(&sorted[mid], &key) < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo < n && sorted[lo].ppn == key.ppn) {
+            succ[sorted[i].offset] = sorted[lo].offset;
+        }
+    }
+}
+
+// 压缩一个组：取出当前生效的映射，重新编码成尽量少的层。
+// 每层从小到大贪心地取PPN连续、步长相同的序列，层内各段互不重叠；
+// 落在某段两个步长点之间的偏移在该层查不到，留给下一层。
+// 无效段和被上层完全遮住的段都不会再出现。编码不了时保持原样
+static void compact_group(FTL *ftl, table *t) {
+    uint64_t map[SECTORS_PER_GROUP];
+    bool pending[SECTORS_PER_GROUP];
+    int remaining = 0;
+    int old_slots = 0, old_widest = 0;
+
+    for (int j = 0; j < t->level_count; j++) {
+        old_slots += t->levels[j].size;
+        if (t->levels[j].size > old_widest) {
+            old_widest = t->levels[j].size;
+        }
+    }
+    materialize_group(t, map);
+    for (int o = 0; o < SECTORS_PER_GROUP; o++) {
+        pending[o] = map[o] != 0;
+        remaining += pending[o];
+    }
+    int succ[SECTORS_PER_GROUP];
+    build_successors(map, succ);
+
+    section runs[MAX_RECURSION_DEPTH][SECTORS_PER_GROUP];
+    int sizes[MAX_RECURSION_DEPTH];
+    int level_count = 0;
+    int new_slots = 0, new_widest = 0;
+
+    while (remaining > (pending[INVALID_START] ? 1 : 0)) {
+        if (level_count >= MAX_RECURSION_DEPTH - 1) {
+            return;
+        }
+        // 最后一层只放单点段，单点之间不会互相遮挡，剩下的偏移一层放完
+        bool singles_only = level_count == MAX_RECURSION_DEPTH - 2;
+        int n = 0;
+        int o = 0;
+        while (o < SECTORS_PER_GROUP) {
+            if (!pending[o]) {
+                o++;
+                continue;
+            }
+            if (o == INVALID_START) {
+                break;
+            }
+
+            // PPN正好接上的后继偏移还没编码时，以两者的距离为步长向后延伸
+            int end = o;
+            int step = 0;
+            int next = succ[o];
+            if (!singles_only && next > o && next - o <= SECTION_MAX_STEP && pending[next]) {
+                step = next - o;
+                end = next;
+                while (succ[end] == end + step && pending[succ[end]]) {
+                    end += step;
+                }
+            }
+
+            for (int p = o; p <= end; p += step ? step : 1) {
+                pending[p] = false;
+                remaining--;
+            }
+            runs[level_count][n++] = section_make(o, end - o, step, step > 0, map[o]);
+            o = end + 1;
+        }
+        sizes[level_count++] = n;
+        new_slots += n;
+        if (n > new_widest) {
+            new_widest = n;
+        }
+    }
+
+    // 偏移255不能作为段首（与INVALID_START相同）。单独放在最底层，从一个上层已命中的偏移x起步，
+    // 步长取255-x只落在255上，x和两者之间的偏移在这一层都查不到东西。步长超出编码范围时不压缩
+    if (pending[INVALID_START]) {
+        int x = INVALID_START - 1;
+        while (x >= 0 && map[x] == 0) {
+            x--;
+        }
+        if (x < 0 || INVALID_START - x > SECTION_MAX_STEP || level_count >= MAX_RECURSION_DEPTH) {
+            return;
+        }
+        runs[level_count][0] = section_make(x, INVALID_START - x, INVALID_START - x, true,
+                                            map[INVALID_START] - 1);
+        sizes[level_count++] = 1;
+        new_slots += 1;
+    }
+
+    // 段数、层数、最宽一层都没有减少就不替换。压缩后每层最多255个段，各层大小因此有界
+    if (new_slots >= old_slots && level_count >= t->level_count && new_widest >= old_widest) {
+        return;
+    }
+
+    levelsec *levels = NULL;
+    if (level_count > 0) {
+        levels = ArenaAlloc(&ftl->arena, level_count * sizeof(levelsec));
+        if (!levels) {
+            return;
+        }
+        for (int j = 0; j < level_count; j++) {
+            // 与Insert的扩容方式一致，容量取2的幂
+            int capacity = 4;
+            while (capacity < sizes[j]) {
+                capacity *= 2;
+            }
+            memset(&levels[j], 0, sizeof(levelsec));
+            levels[j].sec = ArenaAlloc(&ftl->arena, capacity * sizeof(section));
+            levels[j].capacity = capacity;
+            bool created;
+            if (!levels[j].sec || !SectionBoundsReserve(&ftl->arena, &levels[j].bounds, sizes[j], &created)) {
+                for (int k = 0; k <= j; k++) {
+                    ArenaRelease(&ftl->arena, levels[k].sec, levels[k].capacity * sizeof(section));
+                    SectionBoundsRelease(&ftl->arena, &levels[k].bounds);
+                }
+                ArenaRelease(&ftl->arena, levels, level_count * sizeof(levelsec));
+                return;
+            }
+            memcpy(levels[j].sec, runs[j], sizes[j] * sizeof(section));
+            levels[j].size = sizes[j];
+            for (int i = 0; i < sizes[j]; i++) {
+                sync_bounds(&levels[j], i);
+            }
         }
     }
-    return false;
+
+    free_levels(ftl, t);
+    t->levels = levels;
+    t->level_count = level_count;
+}
+
+// 组的层数过多、某层过大或无效段过半时压缩，只检查本次落盘写到的组
+static void maybe_compact(FTL *ftl, int idx) {
+    table *t = GroupDirFind(&ftl->groups, idx);
+    if (!t) {
+        return;
+    }
+    int slots = 0, dead = 0, widest = 0;
+    for (int j = 0; j < t->level_count; j++) {
+        levelsec *lsec = &t->levels[j];
+        slots += lsec->size;
+        if (lsec->size > widest) {
+            widest = lsec->size;
+        }
+        for (int i = 0; i < lsec->size; i++) {
+            dead += !is_section_valid(&lsec->sec[i]);
+        }
+    }
+    if (slots < t->compact_floor) {
+        return;
+    }
+    if (t->level_count > COMPACT_LEVELS || widest >= COMPACT_LEVEL_SLOTS ||
+        (slots >= COMPACT_MIN_SLOTS && dead * 2 >= slots)) {
+        compact_group(ftl, t);
+
+        // 压缩后（或无法再压缩时）的槽位翻倍才重新检查，压缩开销按插入的段均摊
+        slots = 0;
+        for (int j = 0; j < t->level_count; j++) {
+            slots += t->levels[j].size;
+        }
+        int floor = slots * 2 + COMPACT_MIN_SLOTS;
+        t->compact_floor = floor > UINT16_MAX ? UINT16_MAX : floor;
+    }
 }
 
 // ProcessWriteBuffer函数
-void ProcessWriteBuffer() {
+static void ProcessWriteBuffer(FTL *ftl) {
     if (!ftl || ftl->write_buffer.count == 0) return;
+
+    // 映射即将改变，之前缓存的读结果全部作废
+    XlateCacheInvalidate(&ftl->cache);
     
-    sort_lba_array(ftl->write_buffer.lba, ftl->write_buffer.count);
+    WriteBufferSortLBA(&ftl->write_buffer);
     uint32_t current_ppn = ftl->write_buffer.next_ppn;
     
     int idx = 0;
@@ -221,21 +529,22 @@ void ProcessWriteBuffer() {
             }
             group_end = i;
         }
+        table *t = GroupDirTouch(&ftl->groups, current_group);
+        if (t) {
+            for (int i = idx; i <= group_end; i++) {
+                uint8_t offset = ftl->write_buffer.lba[i] % SECTORS_PER_GROUP;
+                t->mapped[offset / 64] |= 1ULL << (offset % 64);
+            }
+        }
         
         // 处理当前组内的所有连续序列
         int group_idx = idx;
         while (group_idx <= group_end) {
-            section sec;
-            sec.start = ftl->write_buffer.lba[group_idx] % SECTORS_PER_GROUP;
-            sec.b = current_ppn * FLASH_PAGE_SIZE;
-            // 不再设置valid字段
+            int start = ftl->write_buffer.lba[group_idx] % SECTORS_PER_GROUP;
             
             // 检查是否是单个元素
             if (group_idx == group_end) {
-                sec.length = 0;
-                sec.step = 0;
-                sec.accuracy = 0;
-                Insert(current_group, sec, 0);
+                Insert(ftl, current_group, section_make(start, 0, 0, false, current_ppn), 0);
                 current_ppn += 1;
                 group_idx++;
                 continue;
@@ -245,8 +554,8 @@ void ProcessWriteBuffer() {
             int step = ftl->write_buffer.lba[group_idx + 1] - ftl->write_buffer.lba[group_idx];
             int sequence_end = group_idx;
             
-            // 查找具有相同步长的连续序列
-            for (int i = group_idx + 1; i <= group_end; i++) {
+            // 查找具有相同步长的连续序列，步长超出编码范围时按单个元素处理
+            for (int i = group_idx + 1; i <= group_end && step <= SECTION_MAX_STEP; i++) {
                 if (ftl->write_buffer.lba[i] - ftl->write_buffer.lba[i - 1] == step) {
                     sequence_end = i;
                 } else {
@@ -256,173 +565,233 @@ void ProcessWriteBuffer() {
             
             if (sequence_end > group_idx) {
                 // 找到连续序列
-                sec.length = (ftl->write_buffer.lba[sequence_end] % SECTORS_PER_GROUP) - 
-                            (ftl->write_buffer.lba[group_idx] % SECTORS_PER_GROUP);
-                sec.step = step;
-                sec.accuracy = 1;
-                Insert(current_group, sec, 0);
+                int length = (ftl->write_buffer.lba[sequence_end] % SECTORS_PER_GROUP) - start;
+                Insert(ftl, current_group, section_make(start, length, step, true, current_ppn), 0);
                 current_ppn += (sequence_end - group_idx) + 1;
                 group_idx = sequence_end + 1;
             } else {
                 // 单个元素
-                sec.length = 0;
-                sec.step = 0;
-                sec.accuracy = 0;
-                Insert(current_group, sec, 0);
+                Insert(ftl, current_group, section_make(start, 0, 0, false, current_ppn), 0);
                 current_ppn += 1;
                 group_idx++;
             }
         }
         
+        maybe_compact(ftl, current_group);
         idx = group_end + 1;
     }
     
-    ftl->write_buffer.next_ppn = current_ppn;
-    ftl->write_buffer.count = 0;
+    WriteBufferCommit(&ftl->write_buffer, current_ppn);
 }
 
 // 修改FTLRead函数，在读之前检查写缓冲区
-uint64_t FTLRead(uint64_t lba) {
+static uint64_t FTLRead(void *handle, uint64_t lba) {
+    FTL *ftl = handle;
     if (!ftl) {
         return 0;
     }
     
-    // 检查写缓冲区中是否有这个LBA
-    if (is_lba_in_write_buffer(lba)) {
-        // 如果有，先处理写缓冲区
-        ProcessWriteBuffer();
+    // 仍在写缓冲区中的LBA直接返回落盘时将分配的PPN，不提前落盘
+    uint32_t pending_ppn;
+    if (WriteBufferPendingPPN(&ftl->write_buffer, lba, &pending_ppn)) {
+        return (uint64_t)pending_ppn * FLASH_PAGE_SIZE;
     }
     
-    int idx = lba / SECTORS_PER_GROUP;
+    uint64_t idx = lba / SECTORS_PER_GROUP;
     uint8_t offset = lba % SECTORS_PER_GROUP;
     
-    if (idx < 0 || idx >= NUMBER_OF_SECTORS) {
-        printf("[FTLRead Error] Invalid index: %d for LBA: %lu\n", idx, lba);
+    if (idx >= ftl->groups.group_count) {
+        printf("[FTLRead Error] Invalid index: %lu for LBA: %lu\n", idx, lba);
         return 0;
     }
     
-    table *t = &ftl->t[idx];
-    
-    // 从顶层到底层搜索
-    for (int level = 0; level < t->level_count; level++) {
-        levelsec *lsec = &t->levels[level];
-        
-        for (int i = 0; i < lsec->size; i++) {
-            section *sec = &lsec->sec[i];
-            
-            // 跳过无效的section
-            if (!is_section_valid(sec)) {
-                continue;
-            }
-            
-            // 检查LBA是否在这个段内
-            if (offset >= sec->start && offset <= sec->start + sec->length) {
-                if (sec->accuracy) {
-                    // 精确映射：使用步长计算
-                    if (sec->step > 0) {
-                        // 检查是否在步长点上
-                        if ((offset - sec->start) % sec->step == 0) {
-                            uint32_t ppa_offset = (offset - sec->start) / sec->step;
-                            uint64_t result = sec->b + ppa_offset * FLASH_PAGE_SIZE;
-                            return result;
-                        }
-                    }
-                } else {
-                    // 近似段（单个点）：直接匹配start值
-                    if (offset == sec->start) {
-                        return sec->b;
-                    }
-                }
-                break; // 在这个段中但没找到匹配，跳出内层循环
-            }
-        }
+    // 从未写过的组没有分配组表，从未写过的偏移不在mapped中
+    table *t = GroupDirFind(&ftl->groups, idx);
+    if (!t || (t->mapped[offset / 64] >> (offset % 64) & 1) == 0) {
+        return 0;
     }
     
-    return 0; // 未找到映射
+    uint64_t result;
+    if (XlateCacheLookup(&ftl->cache, lba, &result)) {
+        return result;
+    }
+    result = lookup_offset(t, offset);
+    XlateCacheStore(&ftl->cache, lba, result);
+    return result;
 }
 
-bool FTLModify(uint64_t lba) {
+static bool FTLModify(void *handle, uint64_t lba) {
+    FTL *ftl = handle;
     if (!ftl) {
         return false;
     }
     
-    // 添加到写缓冲区
-    if (ftl->write_buffer.count < WRITE_BUFFER_SIZE) {
-        ftl->write_buffer.lba[ftl->write_buffer.count++] = lba;
-    } else {
+    if (lba / SECTORS_PER_GROUP >= ftl->groups.group_count) {
+        return false;
+    }
+    
+    // 添加到写缓冲区，已缓冲的LBA原地覆盖
+    if (!WriteBufferAdd(&ftl->write_buffer, lba)) {
         return false;
     }
     
     // 如果缓冲区满了，处理缓冲区
-    if (ftl->write_buffer.count >= WRITE_BUFFER_SIZE) {
-        ProcessWriteBuffer();
+    if (ftl->write_buffer.count >= ftl->write_buffer.capacity) {
+        ProcessWriteBuffer(ftl);
     }
     
     return true;
 }
 
-uint32_t AlgorithmRun(IOVector *ioVector, const char *filename) {
-    if (!ioVector) {
-        return RETURN_ERROR;
-    }
-    
-    if (!ioVector->ioArray) {
-        return RETURN_ERROR;
-    }
-    
-    struct timeval start, end;
-    FILE *file = filename ? fopen(filename, "w") : stdout;
-    if (!file) {
-        printf("[AlgorithmRun Error] Failed to open output file: %s\n", filename);
-        return RETURN_ERROR;
+// 落盘后等日志写出，此前的修改在返回时都已持久
+static void FTLFlush(void *handle) {
+    FTL *ftl = handle;
+    ProcessWriteBuffer(ftl);
+    JournalSync(ftl->write_buffer.journal);
+}
+
+static void *FTLInit(const ftl_config *config) {
+    FTL *ftl = create_instance(config);
+    if (ftl && !WriteBufferAttachJournal(&ftl->write_buffer, config, FTLFlush, ftl)) {
+        FTLDestroy(ftl);
+        return NULL;
     }
-    
-    // 初始化 FTL
-    FTLInit();
-    
-    // 重置内存统计
-    memoryUsed = 0;
-    memoryMax = 0;
+    return ftl;
+}
 
-    // 记录开始时间
-    gettimeofday(&start, NULL);
+static void FTLStats(void *handle, ftl_stats *stats) {
+    FTL *ftl = handle;
+    stats->memoryUsed = ftl->arena.live;
+    stats->memoryMax = ftl->arena.peak;
+    stats->cacheMemory = XlateCacheMemory(&ftl->cache);
+    JournalStats(ftl->write_buffer.journal, stats);
+}
 
-    for (uint64_t i = 0; i < ioVector->len; ++i) {
-        if (ioVector->ioArray[i].type == IO_READ) {
-            uint64_t ret = FTLRead(ioVector->ioArray[i].lba);
-            fprintf(file, "%llu\n", (unsigned long long)ret);
-        } else {
-            if (!FTLModify(ioVector->ioArray[i].lba)) {
-                printf("[AlgorithmRun Error] Failed to modify LBA: %lu\n", ioVector->ioArray[i].lba);
-            }
+// 检查点载荷：组数、写缓冲区，然后是每个写过的组：组号、compact_floor和层数、mapped、
+// 各层的段数和容量及段数组（含作废的段），最后是CKPT_END。起止偏移副本恢复时重建
+static bool FTLCheckpoint(void *handle, const char *path) {
+    FTL *ftl = handle;
+    CkptWriter w;
+    if (!CkptCreate(&w, path, ftl_ops_cascade.name)) {
+        return false;
+    }
+    CkptPutU64(&w, ftl->groups.group_count);
+    WriteBufferSave(&ftl->write_buffer, &w);
+    uint64_t group = 0;
+    for (table *t; (t = GroupDirNext(&ftl->groups, &group)); group++) {
+        // 压缩可能把全部作废的组清成0层，mapped仍要保留
+        if (!t->levels && !(t->mapped[0] | t->mapped[1] | t->mapped[2] | t->mapped[3])) {
+            continue;
         }
-        
-        if (memoryUsed > memoryMax) {
-            memoryMax = memoryUsed;
+        CkptPutU64(&w, group);
+        CkptPutU64(&w, (uint64_t)t->compact_floor << 8 | t->level_count);
+        CkptPut(&w, t->mapped, sizeof(t->mapped));
+        for (int j = 0; j < t->level_count; j++) {
+            levelsec *lsec = &t->levels[j];
+            CkptPutU64(&w, (uint64_t)lsec->capacity << 16 | lsec->size);
+            CkptPut(&w, lsec->sec, lsec->size * sizeof(section));
         }
     }
-    
-    // 处理缓冲区中剩余的数据
-    ProcessWriteBuffer();
+    CkptPutU64(&w, CKPT_END);
+    // 检查点已包含日志中的全部记录
+    return CkptCommit(&w) && JournalTruncate(ftl->write_buffer.journal);
+}
 
-    // 记录结束时间
-    gettimeofday(&end, NULL);
+// 按原容量分配各层并整块拷入段数组，占用的内存与写出时相同
+static bool load_group(FTL *ftl, CkptImage *img, uint64_t group) {
+    uint64_t counts;
+    const uint64_t *mapped;
+    if (!CkptGetU64(img, &counts) || !(mapped = CkptGet(img, sizeof(uint64_t) * (SECTORS_PER_GROUP / 64)))) {
+        return false;
+    }
+    int level_count = counts & 0xFF;
+    table *t = GroupDirTouch(&ftl->groups, group);
+    if (!t || t->levels) {
+        return false;
+    }
+    t->compact_floor = counts >> 8;
+    memcpy(t->mapped, mapped, sizeof(t->mapped));
+    if (level_count == 0) {
+        return true;
+    }
+    t->levels = ArenaAlloc(&ftl->arena, level_count * sizeof(levelsec));
+    if (!t->levels) {
+        return false;
+    }
+    memset(t->levels, 0, level_count * sizeof(levelsec));
+    t->level_count = level_count;
 
-    FTLDestroy();
+    for (int j = 0; j < level_count; j++) {
+        uint64_t sizes;
+        if (!CkptGetU64(img, &sizes) || sizes >> 16 > UINT16_MAX || (sizes & 0xFFFF) > sizes >> 16) {
+            return false;
+        }
+        levelsec *lsec = &t->levels[j];
+        int size = sizes & 0xFFFF;
+        const section *sec = CkptGet(img, size * sizeof(section));
+        if (!sec) {
+            return false;
+        }
+        if (sizes >> 16) {
+            lsec->sec = ArenaAlloc(&ftl->arena, (sizes >> 16) * sizeof(section));
+            if (!lsec->sec) {
+                return false;
+            }
+            lsec->capacity = sizes >> 16;
+            bool created;
+            if (!SectionBoundsReserve(&ftl->arena, &lsec->bounds, size, &created)) {
+                return false;
+            }
+            memcpy(lsec->sec, sec, size * sizeof(section));
+            lsec->size = size;
+            for (int i = 0; i < size; i++) {
+                sync_bounds(lsec, i);
+            }
+        }
+    }
+    return true;
+}
 
-    if (file != stdout) {
-        fclose(file);
+static void *FTLRestore(const ftl_config *config, const char *path) {
+    CkptImage img;
+    if (!CkptOpen(&img, path, ftl_ops_cascade.name)) {
+        return NULL;
     }
-    
-    // 计算秒数和微秒数
-    long seconds = end.tv_sec - start.tv_sec;
-    long useconds = end.tv_usec - start.tv_usec;
-
-    // 总微秒数
-    double during = (seconds * 1000000.0 + useconds) / 1000.0; 
-    double throughput = (double)ioVector->len/during; // 转换为毫秒
-    printf("algorithmRunningDuration:\t %f ms\n", throughput);
-    printf("Max memory used:\t\t %llu B\n", (unsigned long long)memoryMax);
-
-    return RETURN_OK;
-}
\ No newline at end of file
+    FTL *ftl = create_instance(config);
+    if (!ftl) {
+        CkptClose(&img);
+        return NULL;
+    }
+    uint64_t group_count, group;
+    bool ok = CkptGetU64(&img, &group_count) && group_count == ftl->groups.group_count &&
+              WriteBufferLoad(&ftl->write_buffer, &img);
+    while (ok && (ok = CkptGetU64(&img, &group)) && group != CKPT_END) {
+        ok = load_group(ftl, &img, group);
+    }
+    CkptClose(&img);
+    if (!ok) {
+        fprintf(stderr, "Cannot restore %s from %s: corrupt payload or different LBA range\n",
+                ftl_ops_cascade.name, path);
+        FTLDestroy(ftl);
+        return NULL;
+    }
+    // 检查点之后的更新在日志中
+    if (!WriteBufferAttachJournal(&ftl->write_buffer, config, FTLFlush, ftl)) {
+        FTLDestroy(ftl);
+        return NULL;
+    }
+    return ftl;
+}
+
+const ftl_ops ftl_ops_cascade = {
+    .name = "cascade",
+    .group_size = SECTORS_PER_GROUP,
+    .init = FTLInit,
+    .destroy = FTLDestroy,
+    .read = FTLRead,
+    .modify = FTLModify,
+    .flush = FTLFlush,
+    .stats = FTLStats,
+    .checkpoint = FTLCheckpoint,
+    .restore = FTLRestore,
+};
@@ -1,10 +1,9 @@
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
 #include <stdbool.h>
 #include <stdio.h>
 
-#include "ftl.h"
+#include "ftl_ops.h"
 
 #define MAX_MAPPING_ENTRIES (64 * 1000 * 1000)
 #define CACHE_SIZE 16
@@ -13,10 +12,6 @@
 #define BLOCK_SIZE 4096
 #define CACHE_GROUP 15625
 
-static uint64_t memoryUsed = 0;
-static uint64_t memoryMax = 0;
-
-
 
 typedef struct {
     uint64_t valid;
@@ -27,23 +22,25 @@ typedef struct {
     ppn_entry *ppn;
     uint64_t cacheppn;
     // 记录哪些ppn组在cache中
+    uint64_t full_merges;   // 每次改写都把整块换到空闲块，相当于一次完全合并
+    uint64_t copies;
+    uint64_t memoryUsed;
+    uint64_t memoryMax;
 } FTL;
 
-static FTL *ftl = NULL;
-
-void FTLInit() {
-    ftl = (FTL*)malloc(sizeof(FTL));
+static void *FTLInit(const ftl_config *config) {
+    FTL *ftl = FTLAllocInstance(sizeof(FTL));
     if (!ftl) {
         perror("Failed to allocate FTL");
-        exit(EXIT_FAILURE);
+        return NULL;
     }
-    memoryUsed+=sizeof(FTL);
+    ftl->memoryUsed+=sizeof(FTL);
     // 分配PPN数组
     ftl->ppn = (ppn_entry*)calloc(PPN_COUNT, sizeof(ppn_entry));
     if (!ftl->ppn) {
         perror("Failed to allocate PPN array");
         free(ftl);
-        exit(EXIT_FAILURE);
+        return NULL;
     }
     for(int i=0;i<PPN_COUNT;++i){
         ftl->ppn[i].valid=0;
@@ -51,10 +48,12 @@ void FTLInit() {
     }
     // 初始化cache
     ftl->cacheppn=1000*PPN_COUNT;
-    memoryUsed +=PPN_COUNT * sizeof(ppn_entry);
+    ftl->memoryUsed +=PPN_COUNT * sizeof(ppn_entry);
+    return ftl;
 }
 
-void FTLDestroy() {
+static void FTLDestroy(void *handle) {
+    FTL *ftl = handle;
     if (ftl) {
         // 释放cache中的动态数组
       
@@ -65,11 +64,11 @@ void FTLDestroy() {
         }
         
         free(ftl);
-        ftl = NULL;
     }
 }
 
-uint64_t FTLRead(uint64_t lba) {
+static uint64_t FTLRead(void *handle, uint64_t lba) {
+    FTL *ftl = handle;
     if (!ftl) return 0;
     int index= lba / BLOCKS_PER_PAGE;
     int offset = lba % BLOCKS_PER_PAGE;
@@ -77,8 +76,8 @@ uint64_t FTLRead(uint64_t lba) {
 }
 
 
-
-bool FTLModify(uint64_t lba) {
+static bool FTLModify(void *handle, uint64_t lba) {
+    FTL *ftl = handle;
     if (!ftl) return false;
     
     int ppn_index = lba / BLOCKS_PER_PAGE;
@@ -87,10 +86,12 @@ bool FTLModify(uint64_t lba) {
     if (ppn_index >= PPN_COUNT) {
         return false; // 越界
     }
-    if((ftl->ppn[ppn_index].valid&(1<<offset))==0){
-        ftl->ppn[ppn_index].valid |= (1<<offset);
+    if((ftl->ppn[ppn_index].valid&(UINT64_C(1)<<offset))==0){
+        ftl->ppn[ppn_index].valid |= (UINT64_C(1)<<offset);
         
         return true;}//不是重写，直接秒
+    ftl->full_merges++;
+    ftl->copies += __builtin_popcountll(ftl->ppn[ppn_index].valid);
     uint64_t t=ftl->ppn[ppn_index].pba;
     ftl->ppn[ppn_index].pba=ftl->cacheppn;
     ftl->cacheppn=t;
@@ -98,51 +99,24 @@ bool FTLModify(uint64_t lba) {
     
 }
 
-uint32_t AlgorithmRun(IOVector *ioVector, const char *outputFile) {
-    struct timeval start, end;
-    long seconds, useconds;
-    double during;
-    uint64_t ret;
-    
-    FILE *file = fopen(outputFile, "w");
-    if (!file) {
-        perror("Failed to open outputFile");
-        return RETURN_ERROR;
-    }
-    memoryUsed = 0;
-    memoryMax = 0;
-    FTLInit();
-    
-    
-
-    gettimeofday(&start, NULL);
-
-    for (uint32_t i = 0; i < ioVector->len; ++i) {
-        if (ioVector->ioArray[i].type == IO_READ) {
-            ret = FTLRead(ioVector->ioArray[i].lba);
-            fprintf(file, "%llu\n", (unsigned long long)ret);
-        } else {
-            FTLModify(ioVector->ioArray[i].lba);
-        }
-        
-        if (memoryUsed > memoryMax) {
-            memoryMax = memoryUsed;
-        }
-    }
-
-    gettimeofday(&end, NULL);
-
-    FTLDestroy();
-
-    fclose(file);
-    
-    seconds = end.tv_sec - start.tv_sec;
-    useconds = end.tv_usec - start.tv_usec;
-
-    during = (seconds * 1000000.0 + useconds) / 1000.0;
-    double throughput = (double) ioVector->len / during;
-    printf("algorithmRunningDuration:\t %f ms\n", throughput);
-    printf("Max memory used:\t\t %llu B\n", (unsigned long long)memoryMax);
+static void FTLStats(void *handle, ftl_stats *stats) {
+    FTL *ftl = handle;
+    stats->memoryUsed = ftl->memoryUsed;
+    stats->memoryMax = ftl->memoryMax > ftl->memoryUsed ? ftl->memoryMax : ftl->memoryUsed;
+    stats->fullMerges = ftl->full_merges;
+    stats->mergeCopies = ftl->copies;
+    stats->blockErases = ftl->full_merges;
+}
 
-    return RETURN_OK;
-}
\ No newline at end of file
+const ftl_ops ftl_ops_contrast = {
+    .name = "contrast",
+    .group_size = 0,
+    .init = FTLInit,
+    .destroy = FTLDestroy,
+    .read = FTLRead,
+    .modify = FTLModify,
+    .flush = NULL,
+    .stats = FTLStats,
+    .checkpoint = NULL,
+    .restore = NULL,
+};
@@ -1,252 +1,462 @@
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
 #include <stdbool.h>
 #include <stdio.h>
 
-#include "ftl.h"
+#include "ftl_ops.h"
+#include "cmt.h"
+#include "gtd.h"
+#include "sketch.h"
 
 #define MAX_MAPPING_ENTRIES (64 * 1000 * 1000)
-#define CACHE_SIZE 16
 #define PPN_COUNT 1000000
 #define BLOCKS_PER_PAGE 64
 #define BLOCK_SIZE 4096
-#define CACHE_GROUP 15625
+#define PREFETCH_TRIGGER 2      // 连续这么多次以同一步长前进才当作顺序流
+#define PREFETCH_MAX_STRIDE 8   // 步长（组数）更大的不预取
+#define PREFETCH_MIN_DEPTH 4
+#define PREFETCH_MAX_DEPTH 256
+#define PREFETCH_STREAMS 4      // 同时跟踪的流数，穿插的随机访问不会打断顺序流
+#define BYPASS_PAGES 4          // 未准入的读所用的翻译页副本数，扫描和其他未命中不会互相换出
 
-static uint64_t memoryUsed = 0;
-static uint64_t memoryMax = 0;
 
+// 缓存项的内容，按CMT的槽号索引；缓存的是第几组PPN由CMT记录
 typedef struct {
-    int size;
-    int idx; //表示Cache存储的是第几组PPN
-    uint64_t valid;
-    uint64_t pba;
+    uint64_t map;   // 该组PPN的映射，未命中时从翻译页读入
+    uint64_t valid; // 重写过、数据在pba块中的页
+    uint64_t pba;   // 槽自带的空闲块，接收重写
+    bool prefetched;    // 预取进来后还没被访问过
+    bool dirty;         // map比翻译页中的新，逐出前要写回
 } cache_entry;
 
 typedef struct {
-    uint64_t valid;
-    uint64_t pba;
-} ppn_entry;
+    uint64_t last;          // 流上一次访问的ppn组
+    int64_t stride;
+    uint32_t run;           // 连续以stride前进的次数
+    uint64_t stamp;         // 最近一次访问的时刻，新流替换最久未动的流
+} prefetch_stream;
 
+// 顺序预取：按访问的ppn组识别等步长流，未命中时把刚读入的翻译页中沿步长的后续几组一并放进cache。
+// 预取的项被用到时深度加倍，没用到就被逐出时减半
 typedef struct {
-    ppn_entry *ppn;
-    cache_entry cache[CACHE_SIZE];
-    uint64_t incache[CACHE_GROUP]; // 记录哪些ppn组在cache中
+    prefetch_stream streams[PREFETCH_STREAMS];
+    uint64_t clock;
+    uint32_t depth;
+    uint32_t max_depth;     // 0表示不预取
+    uint64_t prefetched;
+    uint64_t hits;
+} Prefetcher;
+
+typedef struct {
+    uint64_t *written;      // 每组PPN中写过的页，首次写入只改这里，不经过缓存
+    cache_entry *cache;
+    Cmt cmt;                // 哪些ppn组在cache中、在哪个槽
+    Gtd gtd;                // 各组PPN的映射按翻译页存放
+    uint32_t *dirty_count;  // 各翻译页在cache中的脏项数
+    uint64_t writebacks_avoided;  // 并入别的写回或在cache中合并掉的翻译页写
+    Prefetcher prefetch;
+    FreqSketch sketch;      // 准入过滤用的访问频率，table为NULL表示不过滤
+    uint64_t last_recorded; // 连续访问同一组只计一次
+    uint64_t *bypass_pages; // 未准入的读从翻译页副本取映射，同一页上的后续读不再读闪存
+    uint64_t bypass_tvpn[BYPASS_PAGES];
+    uint64_t bypass_stamp[BYPASS_PAGES];  // 最近一次使用的时刻，换掉最久未用的副本
+    uint64_t bypass_clock;
+    uint64_t rejected;
+    uint64_t memoryUsed;
+    uint64_t memoryMax;
 } FTL;
 
-static FTL *ftl = NULL;
+static void FTLDestroy(void *handle);
 
-void FTLInit() {
-    ftl = (FTL*)malloc(sizeof(FTL));
+static void *FTLInit(const ftl_config *config) {
+    FTL *ftl = FTLAllocInstance(sizeof(FTL));
     if (!ftl) {
         perror("Failed to allocate FTL");
-        exit(EXIT_FAILURE);
+        return NULL;
     }
-    memoryUsed+=sizeof(FTL);
-    // 分配PPN数组
-    ftl->ppn = (ppn_entry*)calloc(PPN_COUNT, sizeof(ppn_entry));
-    if (!ftl->ppn) {
+    ftl->memoryUsed+=sizeof(FTL);
+    // 分配写入位图
+    ftl->written = (uint64_t*)calloc(PPN_COUNT, sizeof(uint64_t));
+    if (!ftl->written) {
         perror("Failed to allocate PPN array");
         free(ftl);
-        exit(EXIT_FAILURE);
+        return NULL;
+    }
+    ftl->memoryUsed +=PPN_COUNT * sizeof(uint64_t);
+    // 映射表在翻译页中，内存里只有目录
+    if (!GtdInit(&ftl->gtd, PPN_COUNT, config)) {
+        FTLDestroy(ftl);
+        return NULL;
+    }
+    ftl->memoryUsed += GtdMemory(&ftl->gtd);
+    ftl->dirty_count = (uint32_t*)calloc(ftl->gtd.page_count, sizeof(uint32_t));
+    if (!ftl->dirty_count) {
+        perror("Failed to allocate dirty counts");
+        FTLDestroy(ftl);
+        return NULL;
     }
-    for(int i=0;i<PPN_COUNT;++i){
-        ftl->ppn[i].valid=0;
-        ftl->ppn[i].pba=i*1000;
+    ftl->memoryUsed += ftl->gtd.page_count * sizeof(uint32_t);
+    // 初始化cache，每个槽带一个空闲块
+    uint32_t entries = config->cmt_entries;
+    ftl->cache = (cache_entry*)calloc(entries, sizeof(cache_entry));
+    if (!ftl->cache || !CmtInit(&ftl->cmt, entries, config->cmt_policy)) {
+        perror("Failed to allocate cache");
+        FTLDestroy(ftl);
+        return NULL;
     }
-    // 初始化cache
-    for (int i = 0; i < CACHE_SIZE; ++i) {
-        ftl->cache[i].idx = -1;
-        ftl->cache[i].size = 0;
+    for (uint32_t i = 0; i < entries; ++i) {
         ftl->cache[i].valid = 0;
-        ftl->cache[i].pba = (i+PPN_COUNT)*1000;
+        ftl->cache[i].pba = ((uint64_t)i+PPN_COUNT)*1000;
+    }
+    ftl->memoryUsed += (uint64_t)entries * sizeof(cache_entry) + CmtMemory(&ftl->cmt);
+    if (config->cmt_admission) {
+        if (!SketchInit(&ftl->sketch, entries)) {
+            FTLDestroy(ftl);
+            return NULL;
+        }
+        size_t bytes = (size_t)BYPASS_PAGES * ftl->gtd.page_entries * sizeof(uint64_t);
+        ftl->bypass_pages = (uint64_t*)malloc(bytes);
+        if (!ftl->bypass_pages) {
+            perror("Failed to allocate bypass pages");
+            FTLDestroy(ftl);
+            return NULL;
+        }
+        ftl->memoryUsed += SketchMemory(&ftl->sketch) + bytes;
     }
-    for(int i=0;i<CACHE_GROUP;++i){
-        ftl->incache[i]=0;
+    ftl->last_recorded = UINT64_MAX;
+    for (int i = 0; i < BYPASS_PAGES; ++i) {
+        ftl->bypass_tvpn[i] = UINT64_MAX;
     }
-    memoryUsed +=PPN_COUNT * sizeof(ppn_entry);
+    // 预取最多占一半cache，免得把工作集挤出去
+    if (config->cmt_prefetch) {
+        ftl->prefetch.max_depth = entries / 2 < PREFETCH_MAX_DEPTH ? entries / 2 : PREFETCH_MAX_DEPTH;
+    }
+    return ftl;
 }
 
-void FTLDestroy() {
+static void FTLDestroy(void *handle) {
+    FTL *ftl = handle;
     if (ftl) {
-        // 释放cache中的动态数组
-      
+        // 释放cache
+        CmtFree(&ftl->cmt);
+        SketchFree(&ftl->sketch);
+        free(ftl->bypass_pages);
+        free(ftl->cache);
+        GtdFree(&ftl->gtd);
+        free(ftl->dirty_count);
         
-        // 释放PPN数组
-        if (ftl->ppn) {
-            free(ftl->ppn);
+        // 释放写入位图
+        if (ftl->written) {
+            free(ftl->written);
         }
         
         free(ftl);
-        ftl = NULL;
     }
 }
 
-uint64_t FTLRead(uint64_t lba) {
-    if (!ftl) return 0;
-    
-    uint64_t ppn_index = lba / BLOCKS_PER_PAGE;
-    int offset = lba % BLOCKS_PER_PAGE;
-    int ppn_group = ppn_index / 64;
-    int ppn_offset = ppn_index % 64;
-    if((ftl->incache[ppn_group]&(1<<ppn_offset))!=0){
-        for(int i=0;i<CACHE_SIZE;++i){
-            if(ftl->cache[i].idx==ppn_index){
-                if((ftl->cache[i].valid&(1<<offset))!=0){return ftl->cache[i].pba+offset;}
-            } 
-        }
-    }
-    // 首先在cache中查找
-    
-    
-    // 在PPN中查找
-    
-    return ftl->ppn[ppn_index].pba + offset ;
-    
-    
-     // 未找到
+// 格式化时第i组PPN映射到的块
+static inline uint64_t InitialMap(uint64_t ppn_index) {
+    return ppn_index * 1000;
 }
 
-int CleanCache() {
-    int max_size = 0;
-    int max_index = -1;
-    
-    // 找到最大的cache条目
-    for (int i = 0; i < CACHE_SIZE; ++i) {
-        if (ftl->cache[i].size > max_size) {
-            max_size = ftl->cache[i].size;
-            max_index = i;
-        }
+// 从翻译页读出一组PPN的映射
+static uint64_t LoadMap(FTL *ftl, uint64_t ppn_index) {
+    Gtd *gtd = &ftl->gtd;
+    if (!GtdRead(gtd, GtdPageOf(gtd, ppn_index))) {
+        return InitialMap(ppn_index);
     }
-    
-    if (max_index == -1 || max_size == 0) {
-        return 0;
+    return gtd->page[ppn_index % gtd->page_entries];
+}
+
+// 有重写或映射改过的项要在逐出前写回翻译页，各翻译页的这种项数记在dirty_count中
+static inline bool NeedsWriteBack(const cache_entry *e) {
+    return e->valid || e->dirty;
+}
+
+// 重写的数据并入槽自带的块，它成为这一组的新映射，换下来的块留给这个槽。
+// 只改cache中的映射，翻译页等逐出时再写；上一次合并的结果还没写回就被覆盖时省掉一次写
+static void Merge(FTL *ftl, cache_entry *e) {
+    uint64_t thepba = e->map;
+    e->map = e->pba;
+    e->pba = thepba;
+    e->valid = 0;
+    if (e->dirty) {
+        ftl->writebacks_avoided++;
     }
-    
-    
-    int ppn_group= ftl->cache[max_index].idx / 64;
-    int ppn_offset = ftl->cache[max_index].idx % 64;
-    ftl->incache[ppn_group] &= ~(1<<ppn_offset);//将cache中的ppn组标记为不在cache中
-    // 将cache内容写回PPN
-    uint64_t ppn_index = ftl->cache[max_index].idx;
-    uint64_t thepba =ftl->ppn[ppn_index].pba;
-    ftl->ppn[ppn_index].pba = ftl->cache[max_index].pba;
-    
-    // 释放cache内存
-    ftl->cache[max_index].idx = -1;
-    ftl->cache[max_index].size = 0;
-    ftl->cache[max_index].pba = thepba;
-    ftl->cache[max_index].valid = 0;
-    
-    return max_index;
+    e->dirty = true;
 }
 
-bool FTLModify(uint64_t lba) {
-    if (!ftl) return false;
-    
-    uint64_t ppn_index = lba / BLOCKS_PER_PAGE;
-    uint64_t offset = lba % BLOCKS_PER_PAGE;
-    
-    if (ppn_index >= PPN_COUNT) {
-        return false; // 越界
+// 批量更新：把被逐出的项连同cache中同一翻译页上所有要写回的项一起写回，翻译页只读写一次。
+// 同页的项有重写时顺带合并，写回后都变成干净的
+static void WriteBack(FTL *ftl, cache_entry *e, uint64_t ppn_index) {
+    Gtd *gtd = &ftl->gtd;
+    uint64_t tvpn = GtdPageOf(gtd, ppn_index);
+    uint64_t first = tvpn * gtd->page_entries;
+    if (!GtdRead(gtd, tvpn)) {
+        for (uint32_t i = 0; i < gtd->page_entries; ++i) {
+            gtd->page[i] = InitialMap(first + i);
+        }
     }
-    if((ftl->ppn[ppn_index].valid&(1<<offset))==0){
-        ftl->ppn[ppn_index].valid |= (1<<offset);
-        
-        return true;}//不是重写，直接秒
-    int ppn_group = ppn_index / 64;
-    int ppn_offset = ppn_index % 64;
-    if((ftl->incache[ppn_group]&(1<<ppn_offset))!=0){//本组在cache中
-        for(int i=0;i<CACHE_SIZE;++i){
-            if(ftl->cache[i].idx==ppn_index){
-                if((ftl->cache[i].valid&(1<<offset))==0){
-                    ftl->cache[i].valid |= (1<<offset);
-                    return true;}
-                else{
-                    
-                    ftl->incache[ppn_group] &= ~(1<<ppn_offset);//将cache中的ppn组标记为不在cache中
-    // 将cache内容写回PPN
-                    
-                    uint64_t thepba =ftl->ppn[ppn_index].pba;
-                    ftl->ppn[ppn_index].pba = ftl->cache[i].pba;
-    
-    // 释放cache内存
-                    ftl->cache[i].idx = -1;
-                    ftl->cache[i].size = 0;
-                    ftl->cache[i].pba = thepba;
-                    ftl->cache[i].valid = 0;
-                    return true;
-                }
+    if (e->valid) {
+        Merge(ftl, e);
+    }
+    gtd->page[ppn_index - first] = e->map;
+    // 槽已经分给了新的key，先清掉标记，扫描时不会把它当作新key的项
+    e->dirty = false;
+    uint32_t others = --ftl->dirty_count[tvpn];
+    ftl->writebacks_avoided += others;
+    for (uint32_t i = 0; others && i < gtd->page_entries && first + i < PPN_COUNT; ++i) {
+        int32_t s = CmtPeek(&ftl->cmt, first + i);
+        if (s != CMT_NONE && NeedsWriteBack(&ftl->cache[s])) {
+            cache_entry *other = &ftl->cache[s];
+            if (other->valid) {
+                Merge(ftl, other);
             }
+            gtd->page[i] = other->map;
+            other->dirty = false;
+            others--;
+        }
     }
+    ftl->dirty_count[tvpn] = 0;
+    GtdWrite(gtd, tvpn);
+    for (int i = 0; ftl->bypass_pages && i < BYPASS_PAGES; ++i) {
+        if (ftl->bypass_tvpn[i] == tvpn) {
+            memcpy(ftl->bypass_pages + (size_t)i * gtd->page_entries, gtd->page, gtd->page_entries * sizeof(uint64_t));
+        }
     }
-    
-    for(int i=0;i<CACHE_SIZE;++i){
-        if(ftl->cache[i].size==0){
-            ftl->cache[i].idx=ppn_index;
-            ftl->cache[i].size=1;
+}
 
-            ftl->cache[i].valid|=1<<offset;
-            ftl->incache[ppn_group]|=1<<ppn_offset;//将cache中的ppn组标记为在cache中
-            return true;
+// 为ppn组分配一个槽；缓存已满时CMT按替换策略逐出一组，干净的直接丢弃
+static int32_t Admit(FTL *ftl, uint64_t ppn_index) {
+    int64_t victim;
+    int32_t slot = CmtInsert(&ftl->cmt, ppn_index, &victim);
+    cache_entry *e = &ftl->cache[slot];
+    if (victim != CMT_NONE) {
+        if (NeedsWriteBack(e)) {
+            WriteBack(ftl, e, (uint64_t)victim);
+        }
+        if (e->prefetched) {
+            ftl->prefetch.depth /= 2;
         }
     }
-    int theindex = CleanCache();
-    ftl->cache[theindex].idx=ppn_index;
-    ftl->cache[theindex].size=1;
-
-    ftl->cache[theindex].valid|=1<<offset;
-    ftl->incache[ppn_group]|=1<<ppn_offset;//将cache中的ppn组标记为在cache中
-    return true;
-    
-    
+    e->prefetched = false;
+    e->dirty = false;
+    return slot;
 }
 
-uint32_t AlgorithmRun(IOVector *ioVector, const char *outputFile) {
-    struct timeval start, end;
-    long seconds, useconds;
-    double during;
-    uint64_t ret;
-    
-    FILE *file = fopen(outputFile, "w");
-    if (!file) {
-        perror("Failed to open outputFile");
-        return RETURN_ERROR;
-    }
-    memoryUsed = 0;
-    memoryMax = 0;
-    FTLInit();
-    
-    
+// 把这次访问归入一个流，返回该流；不在等步长流中时返回NULL
+static const prefetch_stream *DetectStride(Prefetcher *pf, uint64_t ppn_index) {
+    if (!pf->max_depth) {
+        return NULL;
+    }
+    prefetch_stream *match = NULL, *near = NULL, *oldest = &pf->streams[0];
+    for (int i = 0; i < PREFETCH_STREAMS; i++) {
+        prefetch_stream *st = &pf->streams[i];
+        int64_t delta = (int64_t)(ppn_index - st->last);
+        if (delta == 0 || delta == st->stride) {
+            match = st;
+            break;
+        }
+        if (!near && delta >= -PREFETCH_MAX_STRIDE && delta <= PREFETCH_MAX_STRIDE) {
+            near = st;
+        }
+        if (st->stamp < oldest->stamp) {
+            oldest = st;
+        }
+    }
+    prefetch_stream *st = match ? match : near ? near : oldest;
+    int64_t delta = (int64_t)(ppn_index - st->last);
+    if (match) {
+        st->run += delta != 0;
+    } else {
+        // 附近的流换一个步长重新计数，都不相干时占用最久未动的流
+        st->stride = near ? delta : 0;
+        st->run = 0;
+    }
+    st->last = ppn_index;
+    st->stamp = ++pf->clock;
+    bool strided = st->run >= PREFETCH_TRIGGER && st->stride != 0 &&
+                   st->stride >= -PREFETCH_MAX_STRIDE && st->stride <= PREFETCH_MAX_STRIDE;
+    return strided ? st : NULL;
+}
 
-    gettimeofday(&start, NULL);
+// TinyLFU准入：缓存已满时，新项的访问频率要高于将被它挤掉的项才放入，一次性扫描不会冲掉热点。
+// 读未命中和预取都要经过过滤，写入总是放入
+static bool Admissible(FTL *ftl, uint64_t ppn_index) {
+    if (!ftl->sketch.table) {
+        return true;
+    }
+    int64_t victim = CmtVictim(&ftl->cmt, ppn_index);
+    return victim == CMT_NONE ||
+           SketchEstimate(&ftl->sketch, ppn_index) > SketchEstimate(&ftl->sketch, (uint64_t)victim);
+}
 
-    for (uint32_t i = 0; i < ioVector->len; ++i) {
-        if (ioVector->ioArray[i].type == IO_READ) {
-            ret = FTLRead(ioVector->ioArray[i].lba);
-            fprintf(file, "%llu\n", (unsigned long long)ret);
+// 不进cache的读：映射取自翻译页副本，副本中没有这一页时才读闪存。不在cache中的项都是干净的，
+// 写回同一页时副本随之更新，所以副本中这些项总是最新的
+static uint64_t BypassRead(FTL *ftl, uint64_t ppn_index) {
+    Gtd *gtd = &ftl->gtd;
+    uint64_t tvpn = GtdPageOf(gtd, ppn_index);
+    int hit = -1, oldest = 0;
+    for (int i = 0; i < BYPASS_PAGES; ++i) {
+        if (ftl->bypass_tvpn[i] == tvpn) {
+            hit = i;
+            break;
+        }
+        if (ftl->bypass_stamp[i] < ftl->bypass_stamp[oldest]) {
+            oldest = i;
+        }
+    }
+    uint64_t *page;
+    if (hit >= 0) {
+        page = ftl->bypass_pages + (size_t)hit * gtd->page_entries;
+    } else {
+        hit = oldest;
+        page = ftl->bypass_pages + (size_t)hit * gtd->page_entries;
+        if (GtdRead(gtd, tvpn)) {
+            memcpy(page, gtd->page, gtd->page_entries * sizeof(uint64_t));
         } else {
-            FTLModify(ioVector->ioArray[i].lba);
+            for (uint32_t i = 0; i < gtd->page_entries; ++i) {
+                page[i] = InitialMap(tvpn * gtd->page_entries + i);
+            }
         }
-        
-        if (memoryUsed > memoryMax) {
-            memoryMax = memoryUsed;
+        ftl->bypass_tvpn[hit] = tvpn;
+    }
+    ftl->bypass_stamp[hit] = ++ftl->bypass_clock;
+    return page[ppn_index % gtd->page_entries];
+}
+
+// 返回ppn组所在的槽，不在cache中时读入。写入总要放进cache；
+// 读未命中而准入过滤不让放入时返回CMT_NONE，映射由*map带回
+static int32_t Fetch(FTL *ftl, uint64_t ppn_index, bool write, uint64_t *map) {
+    if (ftl->sketch.table && ppn_index != ftl->last_recorded) {
+        SketchIncrement(&ftl->sketch, ppn_index);
+        ftl->last_recorded = ppn_index;
+    }
+    Prefetcher *pf = &ftl->prefetch;
+    const prefetch_stream *stream = DetectStride(pf, ppn_index);
+    int32_t slot = CmtLookup(&ftl->cmt, ppn_index);
+    if (slot != CMT_NONE) {
+        if (ftl->cache[slot].prefetched) {
+            ftl->cache[slot].prefetched = false;
+            pf->hits++;
+            pf->depth = pf->depth * 2 < pf->max_depth ? pf->depth * 2 : pf->max_depth;
         }
+        return slot;
+    }
+    if (!write && !Admissible(ftl, ppn_index)) {
+        ftl->rejected++;
+        *map = BypassRead(ftl, ppn_index);
+        return CMT_NONE;
     }
 
-    gettimeofday(&end, NULL);
+    *map = LoadMap(ftl, ppn_index);
+    if (stream) {
+        // 只取刚读入的这一页中的项，不额外读翻译页。先把映射抄出来，逐出时的写回会用到页缓冲
+        Gtd *gtd = &ftl->gtd;
+        uint64_t tvpn = GtdPageOf(gtd, ppn_index);
+        bool mapped = gtd->dir[tvpn] != GTD_UNMAPPED;
+        uint64_t keys[PREFETCH_MAX_DEPTH], maps[PREFETCH_MAX_DEPTH];
+        uint32_t n = 0;
+        if (pf->depth < PREFETCH_MIN_DEPTH) {
+            pf->depth = PREFETCH_MIN_DEPTH < pf->max_depth ? PREFETCH_MIN_DEPTH : pf->max_depth;
+        }
+        for (uint32_t k = 1; k <= pf->depth; k++) {
+            uint64_t next = ppn_index + (uint64_t)(stream->stride * k);
+            if (next >= PPN_COUNT || GtdPageOf(gtd, next) != tvpn) {
+                break;
+            }
+            if (CmtPeek(&ftl->cmt, next) == CMT_NONE) {
+                keys[n] = next;
+                maps[n++] = mapped ? gtd->page[next % gtd->page_entries] : InitialMap(next);
+            }
+        }
+        // 按需访问的项最后放入，预取引起的逐出不会把它挤掉
+        for (uint32_t i = 0; i < n; i++) {
+            if (!Admissible(ftl, keys[i])) {
+                continue;
+            }
+            int32_t s = Admit(ftl, keys[i]);
+            ftl->cache[s].map = maps[i];
+            ftl->cache[s].prefetched = true;
+            pf->prefetched++;
+        }
+    }
+    slot = Admit(ftl, ppn_index);
+    ftl->cache[slot].map = *map;
+    return slot;
+}
 
-    FTLDestroy();
+static uint64_t FTLRead(void *handle, uint64_t lba) {
+    FTL *ftl = handle;
+    if (!ftl) return 0;
+    
+    uint64_t ppn_index = lba / BLOCKS_PER_PAGE;
+    int offset = lba % BLOCKS_PER_PAGE;
+    if (ppn_index >= PPN_COUNT) {
+        return 0; // 越界
+    }
+    uint64_t map;
+    int32_t slot = Fetch(ftl, ppn_index, false, &map);
+    if (slot == CMT_NONE) {
+        return map + offset;
+    }
+    if ((ftl->cache[slot].valid & (UINT64_C(1) << offset)) != 0) {
+        return ftl->cache[slot].pba + offset;
+    }
+    return ftl->cache[slot].map + offset;
+}
 
-    fclose(file);
+static bool FTLModify(void *handle, uint64_t lba) {
+    FTL *ftl = handle;
+    if (!ftl) return false;
     
-    seconds = end.tv_sec - start.tv_sec;
-    useconds = end.tv_usec - start.tv_usec;
+    uint64_t ppn_index = lba / BLOCKS_PER_PAGE;
+    uint64_t offset = lba % BLOCKS_PER_PAGE;
+    uint64_t bit = UINT64_C(1) << offset;
+    
+    if (ppn_index >= PPN_COUNT) {
+        return false; // 越界
+    }
+    if((ftl->written[ppn_index]&bit)==0){
+        ftl->written[ppn_index] |= bit;
+        
+        return true;}//不是重写，直接秒
+    uint64_t map;
+    int32_t slot = Fetch(ftl, ppn_index, true, &map);
+    cache_entry *e = &ftl->cache[slot];
+    if((e->valid&bit)==0){
+        if (!NeedsWriteBack(e)) {
+            ftl->dirty_count[GtdPageOf(&ftl->gtd, ppn_index)]++;
+        }
+        e->valid |= bit;
+        return true;
+    }
+    // 同一页再次被重写，先合并，这一组仍留在cache中
+    Merge(ftl, e);
+    return true;
+}
 
-    during = (seconds * 1000000.0 + useconds) / 1000.0;
-    double throughput = (double) ioVector->len / during;
-    printf("algorithmRunningDuration:\t %f ms\n", throughput);
-    printf("Max memory used:\t\t %llu B\n", (unsigned long long)memoryMax);
+static void FTLStats(void *handle, ftl_stats *stats) {
+    FTL *ftl = handle;
+    stats->memoryUsed = ftl->memoryUsed;
+    stats->memoryMax = ftl->memoryMax > ftl->memoryUsed ? ftl->memoryMax : ftl->memoryUsed;
+    CmtStats(&ftl->cmt, stats);
+    GtdStats(&ftl->gtd, stats);
+    stats->tpageWritesAvoided = ftl->writebacks_avoided;
+    stats->cmtPrefetched = ftl->prefetch.prefetched;
+    stats->cmtRejected = ftl->rejected;
+    stats->cmtPrefetchHits = ftl->prefetch.hits;
+}
 
-    return RETURN_OK;
-}
\ No newline at end of file
+const ftl_ops ftl_ops_dftl = {
+    .name = "dftl",
+    .group_size = 0,
+    .init = FTLInit,
+    .destroy = FTLDestroy,
+    .read = FTLRead,
+    .modify = FTLModify,
+    .flush = NULL,
+    .stats = FTLStats,
+    .checkpoint = NULL,
+    .restore = NULL,
+};
@@ -0,0 +1,622 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "ftl.h"
+#include "ftl_ops.h"
+#include "ftl_shard.h"
+#include "sink.h"
+
+#define DEFAULT_SCHEME "segments"
+#define MAX_SCHEME_LIST 256
+#define CACHE_LINE_SIZE 64
+#define LARGE_INSTANCE (1 << 20)
+#define MAX_WRITE_BUFFER_SIZE (1 << 26)
+#define MAX_PLR_GAMMA 255
+#define MAX_LBA_COUNT (UINT64_C(1) << 38)
+#define MAX_XLATE_CACHE (1 << 24)
+#define MAX_CMT_ENTRIES (1 << 24)
+#define MAX_TPAGE_ENTRIES (1 << 20)
+#define MAX_TPAGE_LATENCY_US 1000000
+#define MAX_LOG_BLOCKS (1 << 20)
+
+// 已注册的映射方案
+static const ftl_ops *const registry[] = {
+    &ftl_ops_origin,
+    &ftl_ops_contrast,
+    &ftl_ops_hybrid,
+    &ftl_ops_dftl,
+    &ftl_ops_lea,
+    &ftl_ops_hash,
+    &ftl_ops_segments,
+    &ftl_ops_cascade,
+    NULL,
+};
+
+struct FTLHandle {
+    const ftl_ops *ops;
+    void *impl;
+};
+
+const ftl_ops *FTLLookup(const char *name) {
+    if (!name) {
+        return NULL;
+    }
+    for (int i = 0; registry[i]; i++) {
+        if (strcmp(registry[i]->name, name) == 0) {
+            return registry[i];
+        }
+    }
+    return NULL;
+}
+
+void *FTLAllocInstance(size_t size) {
+    // 大实例直接用calloc，由匿名映射按需清零，本身就独占页面
+    if (size >= LARGE_INSTANCE) {
+        return calloc(1, size);
+    }
+    size = (size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    void *p = NULL;
+    if (posix_memalign(&p, CACHE_LINE_SIZE, size) != 0) {
+        return NULL;
+    }
+    memset(p, 0, size);
+    return p;
+}
+
+// FTL_SCHEME未设置时使用默认方案
+static const char *scheme_list() {
+    const char *s = getenv("FTL_SCHEME");
+    return (s && *s) ? s : DEFAULT_SCHEME;
+}
+
+void FTLDefaultConfig(ftl_config *config) {
+    memset(config, 0, sizeof(*config));
+    config->ppn_base = FTL_DEFAULT_PPN_BASE;
+    config->write_buffer_size = FTL_DEFAULT_WRITE_BUFFER_SIZE;
+    config->group_sort = false;
+    config->plr_gamma = FTL_DEFAULT_PLR_GAMMA;
+    config->lba_count = FTL_DEFAULT_LBA_COUNT;
+    config->xlate_cache_entries = FTL_DEFAULT_XLATE_CACHE;
+    config->cmt_entries = FTL_DEFAULT_CMT_ENTRIES;
+    config->cmt_policy = CMT_LRU;
+    config->cmt_prefetch = true;
+    config->tpage_entries = FTL_DEFAULT_TPAGE_ENTRIES;
+    config->log_blocks = FTL_DEFAULT_LOG_BLOCKS;
+    config->log_assoc = LOG_FAST;
+}
+
+void FTLConfigFromEnv(ftl_config *config) {
+    FTLDefaultConfig(config);
+
+    const char *s = getenv("FTL_WRITE_BUFFER");
+    if (s && *s) {
+        long n = atol(s);
+        if (n > 0 && n <= MAX_WRITE_BUFFER_SIZE) {
+            config->write_buffer_size = (uint32_t)n;
+        } else {
+            printf("[AlgorithmRun] Ignoring FTL_WRITE_BUFFER=%s\n", s);
+        }
+    }
+    s = getenv("FTL_SORT");
+    if (s && strcmp(s, "group") == 0) {
+        config->group_sort = true;
+    }
+    s = getenv("FTL_LBA_COUNT");
+    if (s && *s) {
+        unsigned long long n = strtoull(s, NULL, 10);
+        if (n > 0 && n <= MAX_LBA_COUNT) {
+            config->lba_count = n;
+        } else {
+            printf("[AlgorithmRun] Ignoring FTL_LBA_COUNT=%s\n", s);
+        }
+    }
+    s = getenv("FTL_XLATE_CACHE");
+    if (s && *s) {
+        long n = atol(s);
+        if (n >= 0 && n <= MAX_XLATE_CACHE) {
+            config->xlate_cache_entries = (uint32_t)n;
+        } else {
+            printf("[AlgorithmRun] Ignoring FTL_XLATE_CACHE=%s\n", s);
+        }
+    }
+    s = getenv("FTL_GAMMA");
+    if (s && *s) {
+        long n = atol(s);
+        if (n >= 0 && n <= MAX_PLR_GAMMA) {
+            config->plr_gamma = (uint32_t)n;
+        } else {
+            printf("[AlgorithmRun] Ignoring FTL_GAMMA=%s\n", s);
+        }
+    }
+    s = getenv("FTL_JOURNAL");
+    if (s && *s) {
+        config->journal_path = s;
+    }
+    s = getenv("FTL_JOURNAL_SYNC");
+    if (s && *s) {
+        if (strcmp(s, "commit") == 0) {
+            config->journal_sync = JOURNAL_SYNC_COMMIT;
+        } else if (strcmp(s, "periodic") == 0) {
+            config->journal_sync = JOURNAL_SYNC_PERIODIC;
+        } else if (strcmp(s, "none") == 0) {
+            config->journal_sync = JOURNAL_SYNC_NONE;
+        } else {
+            printf("[AlgorithmRun] Ignoring FTL_JOURNAL_SYNC=%s\n", s);
+        }
+    }
+    s = getenv("FTL_CMT_ENTRIES");
+    if (s && *s) {
+        long n = atol(s);
+        if (n > 0 && n <= MAX_CMT_ENTRIES) {
+            config->cmt_entries = (uint32_t)n;
+        } else {
+            printf("[AlgorithmRun] Ignoring FTL_CMT_ENTRIES=%s\n", s);
+        }
+    }
+    s = getenv("FTL_CMT_POLICY");
+    if (s && *s) {
+        if (strcmp(s, "lru") == 0) {
+            config->cmt_policy = CMT_LRU;
+        } else if (strcmp(s, "clock") == 0) {
+            config->cmt_policy = CMT_CLOCK;
+        } else if (strcmp(s, "slru") == 0) {
+            config->cmt_policy = CMT_SLRU;
+        } else if (strcmp(s, "arc") == 0) {
+            config->cmt_policy = CMT_ARC;
+        } else {
+            printf("[AlgorithmRun] Ignoring FTL_CMT_POLICY=%s\n", s);
+        }
+    }
+    s = getenv("FTL_CMT_PREFETCH");
+    if (s && *s) {
+        if (strcmp(s, "on") == 0) {
+            config->cmt_prefetch = true;
+        } else if (strcmp(s, "off") == 0) {
+            config->cmt_prefetch = false;
+        } else {
+            printf("[AlgorithmRun] Ignoring FTL_CMT_PREFETCH=%s\n", s);
+        }
+    }
+    s = getenv("FTL_CMT_ADMISSION");
+    if (s && *s) {
+        if (strcmp(s, "on") == 0) {
+            config->cmt_admission = true;
+        } else if (strcmp(s, "off") == 0) {
+            config->cmt_admission = false;
+        } else {
+            printf("[AlgorithmRun] Ignoring FTL_CMT_ADMISSION=%s\n", s);
+        }
+    }
+    s = getenv("FTL_EAGER_INIT");
+    if (s && *s) {
+        if (strcmp(s, "on") == 0) {
+            config->eager_init = true;
+        } else if (strcmp(s, "off") == 0) {
+            config->eager_init = false;
+        } else {
+            printf("[AlgorithmRun] Ignoring FTL_EAGER_INIT=%s\n", s);
+        }
+    }
+    s = getenv("FTL_PACKED_MAP");
+    if (s && *s) {
+        if (strcmp(s, "on") == 0) {
+            config->packed_map = true;
+        } else if (strcmp(s, "off") == 0) {
+            config->packed_map = false;
+        } else {
+            printf("[AlgorithmRun] Ignoring FTL_PACKED_MAP=%s\n", s);
+        }
+    }
+    s = getenv("FTL_LOG_BLOCKS");
+    if (s && *s) {
+        long n = atol(s);
+        // 各关联方式所需的最少日志块数由hybrid的init检查
+        if (n >= 1 && n <= MAX_LOG_BLOCKS) {
+            config->log_blocks = (uint32_t)n;
+        } else {
+            printf("[AlgorithmRun] Ignoring FTL_LOG_BLOCKS=%s\n", s);
+        }
+    }
+    s = getenv("FTL_LOG_ASSOC");
+    if (s && *s) {
+        if (strcmp(s, "fast") == 0) {
+            config->log_assoc = LOG_FAST;
+        } else if (strcmp(s, "bast") == 0) {
+            config->log_assoc = LOG_BAST;
+        } else {
+            printf("[AlgorithmRun] Ignoring FTL_LOG_ASSOC=%s\n", s);
+        }
+    }
+    s = getenv("FTL_TPAGE_ENTRIES");
+    if (s && *s) {
+        long n = atol(s);
+        if (n > 0 && n <= MAX_TPAGE_ENTRIES) {
+            config->tpage_entries = (uint32_t)n;
+        } else {
+            printf("[AlgorithmRun] Ignoring FTL_TPAGE_ENTRIES=%s\n", s);
+        }
+    }
+    s = getenv("FTL_TPAGE_FILE");
+    if (s && *s) {
+        config->tpage_path = s;
+    }
+    s = getenv("FTL_TPAGE_READ_US");
+    if (s && *s) {
+        long n = atol(s);
+        if (n >= 0 && n <= MAX_TPAGE_LATENCY_US) {
+            config->tpage_read_us = (uint32_t)n;
+        } else {
+            printf("[AlgorithmRun] Ignoring FTL_TPAGE_READ_US=%s\n", s);
+        }
+    }
+    s = getenv("FTL_TPAGE_WRITE_US");
+    if (s && *s) {
+        long n = atol(s);
+        if (n >= 0 && n <= MAX_TPAGE_LATENCY_US) {
+            config->tpage_write_us = (uint32_t)n;
+        } else {
+            printf("[AlgorithmRun] Ignoring FTL_TPAGE_WRITE_US=%s\n", s);
+        }
+    }
+}
+
+// scheme为NULL时取FTL_SCHEME中的第一个
+static const ftl_ops *resolve_scheme(const char *scheme) {
+    char name[MAX_SCHEME_LIST];
+    if (!scheme) {
+        // 多个方案时取第一个
+        snprintf(name, sizeof(name), "%s", scheme_list());
+        name[strcspn(name, ",")] = '\0';
+        scheme = name;
+    }
+
+    const ftl_ops *ops = FTLLookup(scheme);
+    if (!ops) {
+        printf("[FTLInit Error] Unknown FTL scheme: %s\n", scheme);
+    }
+    return ops;
+}
+
+// path不为NULL时从检查点恢复，否则新建
+static FTLHandle *open_handle(const char *scheme, const ftl_config *config, const char *path) {
+    const ftl_ops *ops = resolve_scheme(scheme);
+    if (!ops) {
+        return NULL;
+    }
+    if (path && !ops->restore) {
+        printf("[FTLInit Error] %s does not support checkpoints\n", ops->name);
+        return NULL;
+    }
+
+    FTLHandle *ftl = malloc(sizeof(FTLHandle));
+    if (!ftl) {
+        return NULL;
+    }
+    ftl_config defaults;
+    if (!config) {
+        FTLDefaultConfig(&defaults);
+        config = &defaults;
+    }
+    ftl->ops = ops;
+    ftl->impl = path ? ops->restore(config, path) : ops->init(config);
+    if (!ftl->impl) {
+        free(ftl);
+        return NULL;
+    }
+    return ftl;
+}
+
+FTLHandle *FTLInit(const char *scheme, const ftl_config *config) {
+    return open_handle(scheme, config, NULL);
+}
+
+FTLHandle *FTLRestore(const char *scheme, const ftl_config *config, const char *path) {
+    return path ? open_handle(scheme, config, path) : NULL;
+}
+
+bool FTLCheckpoint(FTLHandle *ftl, const char *path) {
+    if (!ftl || !path || !ftl->ops->checkpoint) {
+        return false;
+    }
+    return ftl->ops->checkpoint(ftl->impl, path);
+}
+
+void FTLDestroy(FTLHandle *ftl) {
+    if (!ftl) return;
+    ftl->ops->destroy(ftl->impl);
+    free(ftl);
+}
+
+uint64_t FTLRead(FTLHandle *ftl, uint64_t lba) {
+    return ftl ? ftl->ops->read(ftl->impl, lba) : 0;
+}
+
+bool FTLModify(FTLHandle *ftl, uint64_t lba) {
+    return ftl ? ftl->ops->modify(ftl->impl, lba) : false;
+}
+
+void FTLFlush(FTLHandle *ftl) {
+    if (ftl && ftl->ops->flush) {
+        ftl->ops->flush(ftl->impl);
+    }
+}
+
+void FTLStats(FTLHandle *ftl, ftl_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (ftl) {
+        ftl->ops->stats(ftl->impl, stats);
+    }
+}
+
+static uint64_t count_reads(IOVector *ioVector) {
+    uint64_t readCount = 0;
+    for (uint64_t i = 0; i < ioVector->len; ++i) {
+        if (ioVector->ioArray[i].type == IO_READ) {
+            readCount++;
+        }
+    }
+    return readCount;
+}
+
+// FTL_SHARDS未设置或不大于1时单线程运行
+static int shard_count() {
+    const char *s = getenv("FTL_SHARDS");
+    int n = s ? atoi(s) : 1;
+    if (n > MAX_SHARDS) n = MAX_SHARDS;
+    return n > 1 ? n : 1;
+}
+
+static void report(IOVector *ioVector, struct timeval *start, struct timeval *end, ftl_stats *stats) {
+    // 计算秒数和微秒数
+    long seconds = end->tv_sec - start->tv_sec;
+    long useconds = end->tv_usec - start->tv_usec;
+
+    double during = (seconds * 1000000.0 + useconds) / 1000.0;  // 转换为毫秒
+    double throughput = (double)ioVector->len / during;
+    printf("algorithmRunningDuration:\t %f ms\n", throughput);
+    printf("Max memory used:\t\t %llu B\n", (unsigned long long)stats->memoryMax);
+    if (stats->cacheMemory) {
+        printf("Read cache memory:\t\t %llu B\n", (unsigned long long)stats->cacheMemory);
+    }
+    if (stats->journalCommits) {
+        printf("Journal written:\t\t %llu B in %llu commits\n", (unsigned long long)stats->journalBytes,
+               (unsigned long long)stats->journalCommits);
+    }
+    uint64_t lookups = stats->cmtHits + stats->cmtMisses;
+    if (lookups) {
+        printf("CMT hit ratio:\t\t\t %f (%llu evictions)\n", (double)stats->cmtHits / lookups,
+               (unsigned long long)stats->cmtEvictions);
+        if (stats->cmtRejected) {
+            printf("CMT admission rejected:\t\t %llu\n", (unsigned long long)stats->cmtRejected);
+        }
+        if (stats->cmtPrefetched) {
+            printf("CMT prefetch:\t\t\t %llu loaded, %llu used\n", (unsigned long long)stats->cmtPrefetched,
+                   (unsigned long long)stats->cmtPrefetchHits);
+        }
+        printf("Translation pages:\t\t %llu reads, %llu writes (%llu write-backs avoided)\n",
+               (unsigned long long)stats->tpageReads, (unsigned long long)stats->tpageWrites,
+               (unsigned long long)stats->tpageWritesAvoided);
+    }
+    if (stats->switchMerges + stats->partialMerges + stats->fullMerges) {
+        printf("Block merges:\t\t\t %llu switch, %llu partial, %llu full (%llu page copies, %llu erases)\n",
+               (unsigned long long)stats->switchMerges, (unsigned long long)stats->partialMerges,
+               (unsigned long long)stats->fullMerges, (unsigned long long)stats->mergeCopies,
+               (unsigned long long)stats->blockErases);
+    }
+}
+
+// 检查点和日志文件，取自FTL_RESTORE、FTL_CHECKPOINT和FTL_JOURNAL，多个方案时加上方案名后缀；
+// 空串表示不使用
+typedef struct {
+    char restore[4096];
+    char checkpoint[4096];
+    char journal[4096];
+} ckpt_paths;
+
+static void checkpoint_path(char *path, size_t size, const char *env, const char *suffix) {
+    const char *s = getenv(env);
+    if (!s || !*s) {
+        path[0] = '\0';
+    } else if (suffix) {
+        snprintf(path, size, "%s.%s", s, suffix);
+    } else {
+        snprintf(path, size, "%s", s);
+    }
+}
+
+static double elapsed_ms(struct timeval *start, struct timeval *end) {
+    return (end->tv_sec - start->tv_sec) * 1000.0 + (end->tv_usec - start->tv_usec) / 1000.0;
+}
+
+static uint32_t run_single(const ftl_ops *ops, const ftl_config *config, IOVector *ioVector,
+                           ResultSink *sink, ftl_stats *stats, const ckpt_paths *paths) {
+    struct timeval start, end;
+
+    // 从检查点恢复代替初始化，单独计时
+    gettimeofday(&start, NULL);
+    void *ftl = paths->restore[0] ? ops->restore(config, paths->restore) : ops->init(config);
+    if (!ftl) {
+        printf("[AlgorithmRun Error] Failed to initialize FTL scheme: %s\n", ops->name);
+        return RETURN_ERROR;
+    }
+    if (paths->restore[0]) {
+        gettimeofday(&end, NULL);
+        printf("Restore duration:\t\t %f ms\n", elapsed_ms(&start, &end));
+    }
+
+    // 记录开始时间
+    gettimeofday(&start, NULL);
+
+    for (uint64_t i = 0; i < ioVector->len; ++i) {
+        if (ioVector->ioArray[i].type == IO_READ) {
+            SinkPut(sink, ops->read(ftl, ioVector->ioArray[i].lba));
+        } else {
+            if (!ops->modify(ftl, ioVector->ioArray[i].lba)) {
+                printf("[AlgorithmRun Error] Failed to modify LBA: %lu\n", ioVector->ioArray[i].lba);
+            }
+        }
+    }
+
+    // 处理缓冲区中剩余的数据
+    if (ops->flush) {
+        ops->flush(ftl);
+    }
+
+    // 记录结束时间
+    gettimeofday(&end, NULL);
+
+    memset(stats, 0, sizeof(*stats));
+    ops->stats(ftl, stats);
+    bool saved = !paths->checkpoint[0] || ops->checkpoint(ftl, paths->checkpoint);
+    ops->destroy(ftl);
+    report(ioVector, &start, &end, stats);
+    if (!saved) {
+        printf("[AlgorithmRun Error] Failed to write checkpoint: %s\n", paths->checkpoint);
+        return RETURN_ERROR;
+    }
+    return RETURN_OK;
+}
+
+static uint32_t run_sharded(const ftl_ops *ops, const ftl_config *config, IOVector *ioVector,
+                            ResultSink *sink, ftl_stats *stats, int shards) {
+    struct timeval start, end;
+
+    uint64_t *results = malloc(ioVector->len * sizeof(uint64_t));
+    ShardSet *set = ShardSetCreate(ops, config, shards);
+    if (!results || !set) {
+        printf("[AlgorithmRun Error] Failed to initialize %d shards of FTL scheme: %s\n", shards, ops->name);
+        free(results);
+        ShardSetDestroy(set);
+        return RETURN_ERROR;
+    }
+
+    gettimeofday(&start, NULL);
+    bool ok = ShardSetRun(set, ioVector, results);
+    gettimeofday(&end, NULL);
+
+    // 各分片乱序完成，读结果按原请求顺序输出
+    for (uint64_t i = 0; i < ioVector->len; ++i) {
+        if (ioVector->ioArray[i].type == IO_READ) {
+            SinkPut(sink, results[i]);
+        }
+    }
+
+    ShardSetStats(set, stats);
+    ShardSetDestroy(set);
+    free(results);
+    if (!ok) {
+        return RETURN_ERROR;
+    }
+    report(ioVector, &start, &end, stats);
+    return RETURN_OK;
+}
+
+// suffix不为NULL时加在检查点文件名后
+static uint32_t run_scheme(const ftl_ops *ops, IOVector *ioVector, const char *filename,
+                           uint64_t readCount, const SinkOptions *sinkOptions, const char *suffix) {
+    ftl_config config;
+    FTLConfigFromEnv(&config);
+
+    ckpt_paths paths;
+    checkpoint_path(paths.restore, sizeof(paths.restore), "FTL_RESTORE", suffix);
+    checkpoint_path(paths.checkpoint, sizeof(paths.checkpoint), "FTL_CHECKPOINT", suffix);
+    checkpoint_path(paths.journal, sizeof(paths.journal), "FTL_JOURNAL", suffix);
+    config.journal_path = paths.journal[0] ? paths.journal : NULL;
+    if ((paths.restore[0] && !ops->restore) || (paths.checkpoint[0] && !ops->checkpoint)) {
+        printf("[AlgorithmRun Error] %s does not support checkpoints\n", ops->name);
+        return RETURN_ERROR;
+    }
+
+    // 输出缓冲区按读请求数一次分配到位
+    ResultSink *sink = SinkOpen(filename, sinkOptions, readCount);
+    if (!sink) {
+        printf("[AlgorithmRun Error] Failed to open output file: %s\n", filename);
+        return RETURN_ERROR;
+    }
+
+    ftl_stats stats;
+    uint32_t ret;
+    int shards = shard_count();
+    if (shards > 1 && ops->group_size == 0) {
+        printf("[AlgorithmRun] %s does not support sharding, running single-threaded\n", ops->name);
+        shards = 1;
+    }
+    if (shards > 1 && (paths.restore[0] || paths.checkpoint[0])) {
+        printf("[AlgorithmRun] Checkpoints are per instance, running %s single-threaded\n", ops->name);
+        shards = 1;
+    }
+    if (shards > 1) {
+        ret = run_sharded(ops, &config, ioVector, sink, &stats, shards);
+    } else {
+        ret = run_single(ops, &config, ioVector, sink, &stats, &paths);
+    }
+
+    // 输出在计时区间之外统一写出
+    if (SinkClose(sink) != 0) {
+        printf("[AlgorithmRun Error] Failed to write output file: %s\n", filename);
+    }
+    return ret;
+}
+
+uint32_t AlgorithmRunScheme(const char *scheme, IOVector *ioVector, const char *filename) {
+    if (!ioVector || !ioVector->ioArray) {
+        return RETURN_ERROR;
+    }
+
+    const ftl_ops *ops = FTLLookup(scheme);
+    if (!ops) {
+        printf("[AlgorithmRun Error] Unknown FTL scheme: %s\n", scheme);
+        return RETURN_ERROR;
+    }
+
+    SinkOptions sinkOptions;
+    SinkOptionsFromEnv(&sinkOptions);
+    return run_scheme(ops, ioVector, filename, count_reads(ioVector), &sinkOptions, NULL);
+}
+
+uint32_t AlgorithmRun(IOVector *ioVector, const char *filename) {
+    if (!ioVector || !ioVector->ioArray) {
+        return RETURN_ERROR;
+    }
+
+    char list[MAX_SCHEME_LIST];
+    snprintf(list, sizeof(list), "%s", scheme_list());
+    bool multiple = strchr(list, ',') != NULL;
+
+    // 先校验所有方案名，避免跑到一半才失败
+    char check[MAX_SCHEME_LIST];
+    memcpy(check, list, sizeof(check));
+    char *save = NULL;
+    for (char *name = strtok_r(check, ",", &save); name; name = strtok_r(NULL, ",", &save)) {
+        if (!FTLLookup(name)) {
+            printf("[AlgorithmRun Error] Unknown FTL scheme: %s\n", name);
+            return RETURN_ERROR;
+        }
+    }
+
+    SinkOptions sinkOptions;
+    SinkOptionsFromEnv(&sinkOptions);
+    uint64_t readCount = count_reads(ioVector);
+
+    // 同一份内存中的trace依次跑每个方案，多个方案时输出文件加上方案名后缀
+    uint32_t ret = RETURN_OK;
+    save = NULL;
+    for (char *name = strtok_r(list, ",", &save); name; name = strtok_r(NULL, ",", &save)) {
+        char path[4096];
+        const char *out = filename;
+        if (multiple) {
+            printf("[%s]\n", name);
+            if (filename) {
+                snprintf(path, sizeof(path), "%s.%s", filename, name);
+                out = path;
+            }
+        }
+        if (run_scheme(FTLLookup(name), ioVector, out, readCount, &sinkOptions, multiple ? name : NULL) != RETURN_OK) {
+            ret = RETURN_ERROR;
+        }
+    }
+    return ret;
+}
@@ -1,23 +1,27 @@
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
-#include "ftl.h"
+#include "ftl_ops.h"
+#include "write_buffer.h"
+#include "arena.h"
+#include "section.h"
+#include "group_dir.h"
+#include "xlate_cache.h"
+#include "section_scan.h"
+#include "checkpoint.h"
+#include "journal.h"
 
 #define MAX_RECURSION_DEPTH 16
-#define NUMBER_OF_SECTORS 250000
 #define SECTORS_PER_GROUP 256
 #define FLASH_PAGE_SIZE 4096
-#define WRITE_BUFFER_SIZE 256
 #define INVALID_START 0xFF  // 使用0xFF表示无效（uint8_t的最大值）
 #define MAX_HASH_SIZE 16
 #define OFFSET 20
 #define GROUPNUM 4
+#define SQUEEZE_MIN_SLOTS 8     // 层内槽位不少于该值且一半以上是无效段时，原地去掉无效段
 
-static uint64_t memoryUsed = 0;
-static uint64_t memoryMax = 0;
 
 typedef struct {
     uint8_t lba;
@@ -29,27 +33,15 @@ typedef struct {
     uint8_t size;
 } grouphash;
 
-int hashfunc(int idx) {
+static int hashfunc(int idx) {
     return (idx + OFFSET) % MAX_HASH_SIZE;
 }
 
-// 写缓冲区结构
-typedef struct {
-    uint64_t lba[WRITE_BUFFER_SIZE];
-    int count;
-    uint32_t next_ppn;
-} WriteBuffer;
-
-typedef struct {
-    uint8_t start;
-    uint8_t length;
-    uint8_t step;
-    uint32_t b;
-} section;
-
 typedef struct {
     section *sec;
-    uint8_t size;
+    uint32_t size;
+    uint32_t dead;          // 作废后仍占位的段数，过半时整层去掉
+    section_bounds bounds;  // 段多的层另存起止偏移，读时整批比较
 } levelsec;
 
 typedef struct {
@@ -60,188 +52,220 @@ typedef struct {
 } table;
 
 typedef struct {
-    table t[NUMBER_OF_SECTORS];
+    GroupDir groups;        // 组号到table的目录，组表在首次落盘写到时分配
     WriteBuffer write_buffer;
+    XlateCache cache;       // 读结果缓存，落盘时整体失效
+    Arena arena;            // 段、层和组内哈希数组都从这里分配，占用即memoryUsed
 } FTL;
 
-static FTL *ftl = NULL;
-
-uint64_t HashRead(int lba) {
-    int idx_ = lba / SECTORS_PER_GROUP;
-    int idx = hashfunc(idx_);
+// 组内哈希按组号选桶，桶内存组内偏移
+static uint64_t HashRead(table *t, int group, uint8_t offset) {
+    grouphash *h = &t->hash[hashfunc(group)];
     
-    if (ftl->t[idx_].hash[idx].ghash == NULL) {
-        return 0;
-    }
-    
-    for (int i = 0; i < ftl->t[idx_].hash[idx].size; ++i) {
-        if (lba == ftl->t[idx_].hash[idx].ghash[i].lba) {
-            return ftl->t[idx_].hash[idx].ghash[i].ppn;
+    for (int i = 0; i < h->size; ++i) {
+        if (h->ghash[i].lba == offset) {
+            return h->ghash[i].ppn;
         }
     }
     return 0;
 }
 
-void HashWrite(int lba, uint64_t ppn) {
-    int idx_ = lba / SECTORS_PER_GROUP;
-    int idx = hashfunc(idx_);
+static void HashWrite(FTL *ftl, table *t, int group, uint8_t offset, uint64_t ppn) {
+    grouphash *h = &t->hash[hashfunc(group)];
     
     // 初始化哈希表或重新分配内存
-    if (ftl->t[idx_].hash[idx].ghash == NULL) {
-        ftl->t[idx_].hash[idx].ghash = malloc(sizeof(hash_entry));
-        if (!ftl->t[idx_].hash[idx].ghash) return;
-        ftl->t[idx_].hash[idx].ghash[0].lba = lba;
-        ftl->t[idx_].hash[idx].ghash[0].ppn = ppn;
-        ftl->t[idx_].hash[idx].size = 1;
-        memoryUsed += sizeof(hash_entry);
+    if (h->ghash == NULL) {
+        h->ghash = ArenaAlloc(&ftl->arena, sizeof(hash_entry));
+        if (!h->ghash) return;
+        h->ghash[0].lba = offset;
+        h->ghash[0].ppn = ppn;
+        h->size = 1;
         return;
     }
     
     // 查找是否已存在
-    bool find = false;
-    for (int i = 0; i < ftl->t[idx_].hash[idx].size; ++i) {
-        if (ftl->t[idx_].hash[idx].ghash[i].lba == lba) {
-            ftl->t[idx_].hash[idx].ghash[i].ppn = ppn;
-            find = true;
-            break;
+    for (int i = 0; i < h->size; ++i) {
+        if (h->ghash[i].lba == offset) {
+            h->ghash[i].ppn = ppn;
+            return;
         }
     }
     
-    if (!find) {
-        if (ftl->t[idx_].hash[idx].size < MAX_HASH_SIZE) {
-            // 重新分配内存以容纳新元素
-            hash_entry *new_ghash = realloc(ftl->t[idx_].hash[idx].ghash, 
-                                          (ftl->t[idx_].hash[idx].size + 1) * sizeof(hash_entry));
-            if (!new_ghash) return;
-            
-            ftl->t[idx_].hash[idx].ghash = new_ghash;
-            ftl->t[idx_].hash[idx].ghash[ftl->t[idx_].hash[idx].size].lba = lba;
-            ftl->t[idx_].hash[idx].ghash[ftl->t[idx_].hash[idx].size].ppn = ppn;
-            ftl->t[idx_].hash[idx].size++;
-            memoryUsed += sizeof(hash_entry);
-        }
-        // 如果达到MAX_HASH_SIZE限制，不添加新条目
+    // 如果达到MAX_HASH_SIZE限制，不添加新条目
+    if (h->size < MAX_HASH_SIZE) {
+        // 重新分配内存以容纳新元素
+        hash_entry *new_ghash = ArenaRealloc(&ftl->arena, h->ghash, h->size * sizeof(hash_entry),
+                                             (h->size + 1) * sizeof(hash_entry));
+        if (!new_ghash) return;
+        
+        h->ghash = new_ghash;
+        h->ghash[h->size].lba = offset;
+        h->ghash[h->size].ppn = ppn;
+        h->size++;
     }
 }
 
-void HashDelete(int group, uint8_t lba) {
-    int idx = hashfunc(group);
-    
-    if (ftl->t[group].hash[idx].ghash == NULL) {
-        return;
-    }
+static void HashDelete(FTL *ftl, table *t, int group, uint8_t offset) {
+    grouphash *h = &t->hash[hashfunc(group)];
     
-    for (int i = 0; i < ftl->t[group].hash[idx].size; ++i) {
-        if (ftl->t[group].hash[idx].ghash[i].lba == lba) {
+    for (int i = 0; i < h->size; ++i) {
+        if (h->ghash[i].lba == offset) {
             // 如果是最后一个元素，直接释放整个数组
-            if (ftl->t[group].hash[idx].size == 1) {
-                free(ftl->t[group].hash[idx].ghash);
-                ftl->t[group].hash[idx].ghash = NULL;
-                ftl->t[group].hash[idx].size = 0;
-                memoryUsed -= sizeof(hash_entry);
+            if (h->size == 1) {
+                ArenaRelease(&ftl->arena, h->ghash, sizeof(hash_entry));
+                h->ghash = NULL;
+                h->size = 0;
             } else {
-                // 移动元素并重新分配内存
-                for (int j = i; j < ftl->t[group].hash[idx].size - 1; ++j) {
-                    ftl->t[group].hash[idx].ghash[j] = ftl->t[group].hash[idx].ghash[j + 1];
+                // 移动元素并重新分配更小的内存
+                memmove(&h->ghash[i], &h->ghash[i + 1], (h->size - 1 - i) * sizeof(hash_entry));
+                h->size--;
+                hash_entry *new_ghash = ArenaRealloc(&ftl->arena, h->ghash, (h->size + 1) * sizeof(hash_entry),
+                                                     h->size * sizeof(hash_entry));
+                if (new_ghash) {
+                    h->ghash = new_ghash;
                 }
-                ftl->t[group].hash[idx].size--;
-                
-                // 重新分配更小的内存
-                hash_entry *new_ghash = realloc(ftl->t[group].hash[idx].ghash, 
-                                              ftl->t[group].hash[idx].size * sizeof(hash_entry));
-                if (new_ghash || ftl->t[group].hash[idx].size == 0) {
-                    ftl->t[group].hash[idx].ghash = new_ghash;
-                }
-                memoryUsed -= sizeof(hash_entry);
             }
             break;
         }
     }
 }
 
-void FTLInit() {
-    ftl = calloc(1, sizeof(FTL));
+static FTL *create_instance(const ftl_config *config) {
+    // memoryUsed只统计段映射占用的内存，组目录不计入
+    FTL *ftl = FTLAllocInstance(sizeof(FTL));
     if (!ftl) {
-        return;
+        return NULL;
     }
+    ArenaInit(&ftl->arena);
     
-    // 初始化所有结构
-    for (int i = 0; i < NUMBER_OF_SECTORS; ++i) {
-        ftl->t[i].level_count = 0;
-        ftl->t[i].levels = NULL;
-        
-        for (int j = 0; j < MAX_HASH_SIZE; ++j) {
-            ftl->t[i].hash[j].ghash = NULL;
-            ftl->t[i].hash[j].size = 0;
-        }
-        
-        for (int j = 0; j < GROUPNUM; ++j) {
-            ftl->t[i].valid[j] = 0;
-        }
+    // 组表在首次写到时分配并清零，不再逐个初始化
+    uint64_t groups = (config->lba_count + SECTORS_PER_GROUP - 1) / SECTORS_PER_GROUP;
+    if (!GroupDirInit(&ftl->groups, groups, sizeof(table))) {
+        free(ftl);
+        return NULL;
     }
-    
-    memoryUsed += sizeof(FTL);
-    ftl->write_buffer.next_ppn = 1000;
-    ftl->write_buffer.count = 0;
+    if (!WriteBufferInit(&ftl->write_buffer, config, SECTORS_PER_GROUP)) {
+        GroupDirFree(&ftl->groups);
+        free(ftl);
+        return NULL;
+    }
+    if (!XlateCacheInit(&ftl->cache, config->xlate_cache_entries)) {
+        WriteBufferFree(&ftl->write_buffer);
+        GroupDirFree(&ftl->groups);
+        free(ftl);
+        return NULL;
+    }
+    return ftl;
 }
 
-void FTLDestroy() {
+static void FTLDestroy(void *handle) {
+    FTL *ftl = handle;
     if (!ftl) return;
     
-    for (int i = 0; i < NUMBER_OF_SECTORS; i++) {
-        // 释放levels
-        for (int j = 0; j < ftl->t[i].level_count; j++) {
-            if (ftl->t[i].levels[j].sec) {
-                free(ftl->t[i].levels[j].sec);
-            }
-        }
-        if (ftl->t[i].levels) {
-            free(ftl->t[i].levels);
-        }
-        
-        // 释放hash
-        for (int j = 0; j < MAX_HASH_SIZE; ++j) {
-            if (ftl->t[i].hash[j].ghash) {
-                free(ftl->t[i].hash[j].ghash);
-            }
-        }
-    }
+    ArenaFree(&ftl->arena);
+    GroupDirFree(&ftl->groups);
+    WriteBufferFree(&ftl->write_buffer);
+    XlateCacheFree(&ftl->cache);
     free(ftl);
-    ftl = NULL;
-}
-
-void sort_lba_array(uint64_t *lba_array, int size) {
-    for (int i = 1; i < size; i++) {
-        uint64_t key = lba_array[i];
-        int j = i - 1;
-        while (j >= 0 && lba_array[j] > key) {
-            lba_array[j + 1] = lba_array[j];
-            j--;
-        }
-        lba_array[j + 1] = key;
-    }
 }
 
 // 判断section是否有效
-bool is_section_valid(section *sec) {
-    return sec->start != INVALID_START;
+static bool is_section_valid(section *sec) {
+    return section_start(*sec) != INVALID_START;
 }
 
 // 重叠检测函数
-bool is_overlap(section *a, section *b) {
+static bool is_overlap(section *a, section *b) {
     if (!is_section_valid(a) || !is_section_valid(b)) {
         return false;
     }
     
-    uint8_t a_end = (a->start + a->length) ;
-    uint8_t b_end =  (b->start + b->length) ;
-    
-    return !(a->start > b_end || a_end < b->start);
+    return !(section_start(*a) > section_end(*b) || section_end(*a) < section_start(*b));
+}
+
+// 同步第i个段的起止偏移副本，无效段的范围为空
+static void sync_bounds(levelsec *lsec, int i) {
+    section *sec = &lsec->sec[i];
+    if (is_section_valid(sec)) {
+        section_bounds_set(&lsec->bounds, i, section_start(*sec), section_end(*sec));
+    } else {
+        section_bounds_set(&lsec->bounds, i, INVALID_START, 0);
+    }
+}
+
+// 去掉层内的无效段，有效段保持原来的先后顺序，查找和冲突检测的结果都不变
+static void squeeze_level(FTL *ftl, levelsec *lsec) {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < lsec->size; i++) {
+        if (is_section_valid(&lsec->sec[i])) {
+            lsec->sec[n++] = lsec->sec[i];
+        }
+    }
+    if (n == 0) {
+        ArenaRelease(&ftl->arena, lsec->sec, lsec->size * sizeof(section));
+        lsec->sec = NULL;
+    } else {
+        section *secs = ArenaRealloc(&ftl->arena, lsec->sec, lsec->size * sizeof(section), n * sizeof(section));
+        if (secs) {
+            lsec->sec = secs;
+        }
+    }
+    lsec->size = n;
+    lsec->dead = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        sync_bounds(lsec, i);
+    }
+}
+
+// 在层末尾追加一个段
+static bool level_append(FTL *ftl, levelsec *lsec, section sec) {
+    // 哈希方案不重排各层，作废的段只在这里回收，否则热点组的层会无限增长
+    if (lsec->size >= SQUEEZE_MIN_SLOTS && lsec->dead * 2 >= lsec->size) {
+        squeeze_level(ftl, lsec);
+    }
+    if (lsec->size == UINT32_MAX) {
+        return false;
+    }
+    // 重新分配内存以容纳新元素
+    uint32_t new_size = lsec->size + 1;
+    section *new_secs = ArenaRealloc(&ftl->arena, lsec->sec, lsec->size * sizeof(section),
+                                     new_size * sizeof(section));
+    if (!new_secs) return false;
+    lsec->sec = new_secs;
+
+    bool created;
+    if (!SectionBoundsReserve(&ftl->arena, &lsec->bounds, new_size, &created)) {
+        return false;
+    }
+    lsec->sec[lsec->size] = sec;
+    lsec->size = new_size;
+    if (created) {
+        for (uint32_t i = 0; i < lsec->size; i++) {
+            sync_bounds(lsec, i);
+        }
+    } else {
+        sync_bounds(lsec, lsec->size - 1);
+    }
+    return true;
+}
+
+// 层内从from起第一个覆盖offset的有效段的下标，没有时返回-1
+static int first_covering(const levelsec *lsec, int from, uint8_t offset) {
+    if (lsec->bounds.starts) {
+        return SectionScan(lsec->bounds.starts, lsec->bounds.ends, from, lsec->size, offset);
+    }
+    for (int i = from; i < lsec->size; i++) {
+        section sec = lsec->sec[i];
+        if (section_start(sec) != INVALID_START && section_start(sec) <= offset && offset <= section_end(sec)) {
+            return i;
+        }
+    }
+    return -1;
 }
 
 // 简化的Insert函数
-void Insert(int idx, section new_sec, int start_level) {
-    if (!ftl || idx < 0 || idx >= NUMBER_OF_SECTORS) {
+static void Insert(FTL *ftl, table *t, section new_sec, int start_level) {
+    if (!ftl || !t) {
         return;
     }
     
@@ -250,19 +274,19 @@ void Insert(int idx, section new_sec, int start_level) {
     
     while (current_level < MAX_RECURSION_DEPTH) {
         // 确保有足够的层级
-        while (ftl->t[idx].level_count <= current_level) {
-            uint8_t new_count = ftl->t[idx].level_count + 1;
-            levelsec *new_levels = realloc(ftl->t[idx].levels, new_count * sizeof(levelsec));
+        while (t->level_count <= current_level) {
+            uint8_t new_count = t->level_count + 1;
+            levelsec *new_levels = ArenaRealloc(&ftl->arena, t->levels,
+                                                t->level_count * sizeof(levelsec),
+                                                new_count * sizeof(levelsec));
             if (!new_levels) return;
-            ftl->t[idx].levels = new_levels;
+            t->levels = new_levels;
             
-            ftl->t[idx].levels[ftl->t[idx].level_count].sec = NULL;
-            ftl->t[idx].levels[ftl->t[idx].level_count].size = 0;
-            ftl->t[idx].level_count = new_count;
-            memoryUsed += sizeof(levelsec);
+            memset(&t->levels[t->level_count], 0, sizeof(levelsec));
+            t->level_count = new_count;
         }
         
-        levelsec *current_level_ptr = &ftl->t[idx].levels[current_level];
+        levelsec *current_level_ptr = &t->levels[current_level];
         section *conflict_sec = NULL;
         int conflict_index = -1;
         
@@ -281,55 +305,32 @@ void Insert(int idx, section new_sec, int start_level) {
             section temp_sec = *conflict_sec;
             
             // 无效化当前层的冲突section
-            conflict_sec->start = INVALID_START;
+            *conflict_sec = section_make(INVALID_START, 0, 0, false, 0);
+            current_level_ptr->dead++;
+            sync_bounds(current_level_ptr, conflict_index);
             
             // 插入当前section到当前层
-            // 重新分配内存以容纳新元素
-            uint8_t new_size = current_level_ptr->size + 1;
-            section *new_secs = realloc(current_level_ptr->sec, new_size * sizeof(section));
-            if (!new_secs) return;
-            current_level_ptr->sec = new_secs;
-            current_level_ptr->sec[current_level_ptr->size] = current_sec;
-            current_level_ptr->size = new_size;
-            memoryUsed += sizeof(section);
+            if (!level_append(ftl, current_level_ptr, current_sec)) return;
             
             // 将冲突的section作为下一轮要处理的section
             current_sec = temp_sec;
             current_level++;
         } else {
             // 没有冲突，直接插入当前层
-            // 重新分配内存以容纳新元素
-            uint8_t new_size = current_level_ptr->size + 1;
-            section *new_secs = realloc(current_level_ptr->sec, new_size * sizeof(section));
-            if (!new_secs) return;
-            current_level_ptr->sec = new_secs;
-            current_level_ptr->sec[current_level_ptr->size] = current_sec;
-            current_level_ptr->size = new_size;
-            memoryUsed += sizeof(section);
+            level_append(ftl, current_level_ptr, current_sec);
             break;
         }
     }
 }
 
-// 检查写缓冲区中是否包含指定的LBA
-bool is_lba_in_write_buffer(uint64_t lba) {
-    if (!ftl || ftl->write_buffer.count == 0) {
-        return false;
-    }
-    
-    for (int i = 0; i < ftl->write_buffer.count; i++) {
-        if (ftl->write_buffer.lba[i] == lba) {
-            return true;
-        }
-    }
-    return false;
-}
-
 // ProcessWriteBuffer函数
-void ProcessWriteBuffer() {
+static void ProcessWriteBuffer(FTL *ftl) {
     if (!ftl || ftl->write_buffer.count == 0) return;
+
+    // 映射即将改变，之前缓存的读结果全部作废
+    XlateCacheInvalidate(&ftl->cache);
     
-    sort_lba_array(ftl->write_buffer.lba, ftl->write_buffer.count);
+    WriteBufferSortLBA(&ftl->write_buffer);
     uint32_t current_ppn = ftl->write_buffer.next_ppn;
     
     int idx = 0;
@@ -345,26 +346,29 @@ void ProcessWriteBuffer() {
             }
             group_end = i;
         }
+        table *t = GroupDirTouch(&ftl->groups, current_group);
+        if (!t) {
+            idx = group_end + 1;
+            continue;
+        }
         
         // 处理当前组内的所有连续序列
         int group_idx = idx;
         while (group_idx <= group_end) {
-            section sec;
-            sec.start = ftl->write_buffer.lba[group_idx] % SECTORS_PER_GROUP;
-            sec.b = current_ppn;
+            int start = ftl->write_buffer.lba[group_idx] % SECTORS_PER_GROUP;
             
             // 检查是否是单个元素
             if (group_idx == group_end) {
-                int sidx = sec.start / 64;
-                int offsetx = sec.start % 64;
+                int sidx = start / 64;
+                int offsetx = start % 64;
                 
                 // 如果之前有映射，先删除
-                if ((ftl->t[current_group].valid[sidx] & (1ULL << offsetx)) != 0) {
-                    HashDelete(current_group, sec.start);
+                if ((t->valid[sidx] & (1ULL << offsetx)) != 0) {
+                    HashDelete(ftl, t, current_group, start);
                 }
                 
-                ftl->t[current_group].valid[sidx] |= (1ULL << offsetx);
-                HashWrite(ftl->write_buffer.lba[group_idx], current_ppn);
+                t->valid[sidx] |= (1ULL << offsetx);
+                HashWrite(ftl, t, current_group, start, current_ppn);
                 
                 current_ppn += 1;
                 group_idx++;
@@ -375,8 +379,8 @@ void ProcessWriteBuffer() {
             int step = ftl->write_buffer.lba[group_idx + 1] - ftl->write_buffer.lba[group_idx];
             int sequence_end = group_idx;
             
-            // 查找具有相同步长的连续序列
-            for (int i = group_idx + 1; i <= group_end; i++) {
+            // 查找具有相同步长的连续序列，步长超出段编码范围时按单个元素放进哈希
+            for (int i = group_idx + 1; i <= group_end && step <= SECTION_MAX_STEP; i++) {
                 if (ftl->write_buffer.lba[i] - ftl->write_buffer.lba[i - 1] == step) {
                     sequence_end = i;
                 } else {
@@ -386,9 +390,7 @@ void ProcessWriteBuffer() {
             
             if (sequence_end > group_idx) {
                 // 找到连续序列
-                sec.length = (ftl->write_buffer.lba[sequence_end] % SECTORS_PER_GROUP) -
-                            (ftl->write_buffer.lba[group_idx] % SECTORS_PER_GROUP);
-                sec.step = step;
+                int length = (ftl->write_buffer.lba[sequence_end] % SECTORS_PER_GROUP) - start;
                 
                 // 清除连续序列中所有元素的valid位
                 for (int i = group_idx; i <= sequence_end; i++) {
@@ -396,27 +398,27 @@ void ProcessWriteBuffer() {
                     int sidx = current_offset / 64;
                     int offsetx = current_offset % 64;
                     
-                    if ((ftl->t[current_group].valid[sidx] & (1ULL << offsetx)) != 0) {
-                        HashDelete(current_group, current_offset);
+                    if ((t->valid[sidx] & (1ULL << offsetx)) != 0) {
+                        HashDelete(ftl, t, current_group, current_offset);
                     }
-                    ftl->t[current_group].valid[sidx] &= ~(1ULL << offsetx);
+                    t->valid[sidx] &= ~(1ULL << offsetx);
                 }
                 
-                Insert(current_group, sec, 0);
+                Insert(ftl, t, section_make(start, length, step, false, current_ppn), 0);
                 current_ppn += (sequence_end - group_idx) + 1;
                 group_idx = sequence_end + 1;
             } else {
                 // 单个元素
-                int sidx = sec.start / 64;
-                int offsetx = sec.start % 64;
+                int sidx = start / 64;
+                int offsetx = start % 64;
                 
                 // 如果之前有映射，先删除
-                if ((ftl->t[current_group].valid[sidx] & (1ULL << offsetx)) != 0) {
-                    HashDelete(current_group, sec.start);
+                if ((t->valid[sidx] & (1ULL << offsetx)) != 0) {
+                    HashDelete(ftl, t, current_group, start);
                 }
                 
-                ftl->t[current_group].valid[sidx] |= (1ULL << offsetx);
-                HashWrite(ftl->write_buffer.lba[group_idx], current_ppn);
+                t->valid[sidx] |= (1ULL << offsetx);
+                HashWrite(ftl, t, current_group, start, current_ppn);
                 
                 current_ppn += 1;
                 group_idx++;
@@ -426,140 +428,269 @@ void ProcessWriteBuffer() {
         idx = group_end + 1;
     }
     
-    ftl->write_buffer.next_ppn = current_ppn;
-    ftl->write_buffer.count = 0;
+    WriteBufferCommit(&ftl->write_buffer, current_ppn);
 }
 
-// 修改FTLRead函数，在读之前检查写缓冲区
-uint64_t FTLRead(uint64_t lba) {
-    if (!ftl) {
-        return 0;
-    }
-    
-    // 检查写缓冲区中是否有这个LBA
-    if (is_lba_in_write_buffer(lba)) {
-        // 如果有，先处理写缓冲区
-        ProcessWriteBuffer();
-    }
-    
-    int idx = lba / SECTORS_PER_GROUP;
-    uint8_t offset = lba % SECTORS_PER_GROUP;
-    
-    if (idx < 0 || idx >= NUMBER_OF_SECTORS) {
-        printf("[FTLRead Error] Invalid index: %d for LBA: %lu\n", idx, lba);
-        return 0;
-    }
-    
+// 组内偏移的映射：先查组内哈希，再从顶层到底层查段，未映射返回0
+static uint64_t lookup_offset(table *t, uint64_t group, uint8_t offset) {
     // 首先检查哈希表
     int sidx = offset / 64;
     int offsetx = offset % 64;
-    if ((ftl->t[idx].valid[sidx] & (1ULL << offsetx)) != 0) {
-        return HashRead(lba);
+    if ((t->valid[sidx] & (1ULL << offsetx)) != 0) {
+        return HashRead(t, group, offset);
     }
-    table *t = &ftl->t[idx];
     
     // 从顶层到底层搜索
     for (int level = 0; level < t->level_count; level++) {
         levelsec *lsec = &t->levels[level];
         
-        for (int i = 0; i < lsec->size; i++) {
+        // 依次检查覆盖该偏移的段，落在步长点上的即为映射
+        for (int i = first_covering(lsec, 0, offset); i >= 0; i = first_covering(lsec, i + 1, offset)) {
             section *sec = &lsec->sec[i];
-            
-            // 跳过无效的section
-            if (!is_section_valid(sec)) {
-                continue;
+            int delta = offset - section_start(*sec);
+            int step = section_step(*sec);
+            if (step > 0 && delta % step == 0) {
+                return section_ppn(*sec) + delta / step;
             }
-            
-            // 检查LBA是否在这个段内
-                // 精确映射：检查是否在序列中
-                if (offset >= sec->start && offset <= sec->start + sec->length) {
-                    if (sec->step > 0 && (offset - sec->start) % sec->step == 0) {
-                        uint32_t ppa_offset = (offset - sec->start) / sec->step;
-                        return sec->b + ppa_offset;
-                    }
-                }
         }
     }
     
     return 0; // 未找到映射
 }
 
-bool FTLModify(uint64_t lba) {
+// 修改FTLRead函数，在读之前检查写缓冲区
+static uint64_t FTLRead(void *handle, uint64_t lba) {
+    FTL *ftl = handle;
     if (!ftl) {
-        return false;
+        return 0;
     }
     
-    // 添加到写缓冲区
-    if (ftl->write_buffer.count < WRITE_BUFFER_SIZE) {
-        ftl->write_buffer.lba[ftl->write_buffer.count++] = lba;
-        return true;
-    } else {
-        // 缓冲区满了，先处理再添加
-        ProcessWriteBuffer();
-        if (ftl->write_buffer.count < WRITE_BUFFER_SIZE) {
-            ftl->write_buffer.lba[ftl->write_buffer.count++] = lba;
-            return true;
-        }
-        return false;
+    // 仍在写缓冲区中的LBA直接返回落盘时将分配的PPN，不提前落盘
+    uint32_t pending_ppn;
+    if (WriteBufferPendingPPN(&ftl->write_buffer, lba, &pending_ppn)) {
+        return pending_ppn;
     }
-}
-
-uint32_t AlgorithmRun(IOVector *ioVector, const char *filename) {
-    if (!ioVector) {
-        return RETURN_ERROR;
+    
+    uint64_t idx = lba / SECTORS_PER_GROUP;
+    uint8_t offset = lba % SECTORS_PER_GROUP;
+    
+    if (idx >= ftl->groups.group_count) {
+        printf("[FTLRead Error] Invalid index: %lu for LBA: %lu\n", idx, lba);
+        return 0;
     }
     
-    if (!ioVector->ioArray) {
-        return RETURN_ERROR;
+    // 从未写过的组没有分配组表
+    table *t = GroupDirFind(&ftl->groups, idx);
+    if (!t) {
+        return 0;
     }
     
-    struct timeval start, end;
-    FILE *file = filename ? fopen(filename, "w") : stdout;
-    if (!file) {
-        printf("[AlgorithmRun Error] Failed to open output file: %s\n", filename);
-        return RETURN_ERROR;
+    uint64_t result;
+    if (XlateCacheLookup(&ftl->cache, lba, &result)) {
+        return result;
+    }
+    result = lookup_offset(t, idx, offset);
+    XlateCacheStore(&ftl->cache, lba, result);
+    return result;
+}
+
+static bool FTLModify(void *handle, uint64_t lba) {
+    FTL *ftl = handle;
+    if (!ftl) {
+        return false;
     }
     
-    // 初始化 FTL
-    FTLInit();
+    if (lba / SECTORS_PER_GROUP >= ftl->groups.group_count) {
+        return false;
+    }
     
-    // 重置内存统计
-    memoryUsed = 0;
-    memoryMax = 0;
-    // 记录开始时间
-    gettimeofday(&start, NULL);
-    for (uint64_t i = 0; i < ioVector->len; ++i) {
-        if (ioVector->ioArray[i].type == IO_READ) {
-            uint64_t ret = FTLRead(ioVector->ioArray[i].lba);
-            fprintf(file, "%llu\n", (unsigned long long)ret);
-        } else {
-            if (!FTLModify(ioVector->ioArray[i].lba)) {
-                printf("[AlgorithmRun Error] Failed to modify LBA: %lu\n", ioVector->ioArray[i].lba);
+    // 添加到写缓冲区，已缓冲的LBA原地覆盖
+    if (WriteBufferAdd(&ftl->write_buffer, lba)) {
+        return true;
+    }
+    // 缓冲区满了，先处理再添加
+    ProcessWriteBuffer(ftl);
+    return WriteBufferAdd(&ftl->write_buffer, lba);
+}
+
+// 落盘后等日志写出，此前的修改在返回时都已持久
+static void FTLFlush(void *handle) {
+    FTL *ftl = handle;
+    ProcessWriteBuffer(ftl);
+    JournalSync(ftl->write_buffer.journal);
+}
+
+static void *FTLInit(const ftl_config *config) {
+    FTL *ftl = create_instance(config);
+    if (ftl && !WriteBufferAttachJournal(&ftl->write_buffer, config, FTLFlush, ftl)) {
+        FTLDestroy(ftl);
+        return NULL;
+    }
+    return ftl;
+}
+
+static void FTLStats(void *handle, ftl_stats *stats) {
+    FTL *ftl = handle;
+    stats->memoryUsed = ftl->arena.live;
+    stats->memoryMax = ftl->arena.peak;
+    stats->cacheMemory = XlateCacheMemory(&ftl->cache);
+    JournalStats(ftl->write_buffer.journal, stats);
+}
+
+// 检查点载荷：组数、写缓冲区，然后是每个写过的组：组号、层数、valid、各桶的项数，
+// 各桶的组内偏移和PPN，各层的段数及段数组（含作废的段），最后是CKPT_END
+static bool FTLCheckpoint(void *handle, const char *path) {
+    FTL *ftl = handle;
+    CkptWriter w;
+    if (!CkptCreate(&w, path, ftl_ops_hash.name)) {
+        return false;
+    }
+    CkptPutU64(&w, ftl->groups.group_count);
+    WriteBufferSave(&ftl->write_buffer, &w);
+    uint64_t group = 0;
+    for (table *t; (t = GroupDirNext(&ftl->groups, &group)); group++) {
+        uint8_t sizes[MAX_HASH_SIZE];
+        bool used = t->level_count > 0 || (t->valid[0] | t->valid[1] | t->valid[2] | t->valid[3]);
+        for (int b = 0; b < MAX_HASH_SIZE; b++) {
+            sizes[b] = t->hash[b].size;
+            used |= sizes[b] > 0;
+        }
+        if (!used) {
+            continue;
+        }
+        CkptPutU64(&w, group);
+        CkptPutU64(&w, t->level_count);
+        CkptPut(&w, t->valid, sizeof(t->valid));
+        CkptPut(&w, sizes, sizeof(sizes));
+        for (int b = 0; b < MAX_HASH_SIZE; b++) {
+            uint8_t lba[MAX_HASH_SIZE];
+            uint64_t ppn[MAX_HASH_SIZE];
+            for (int i = 0; i < sizes[b]; i++) {
+                lba[i] = t->hash[b].ghash[i].lba;
+                ppn[i] = t->hash[b].ghash[i].ppn;
             }
+            CkptPut(&w, lba, sizes[b]);
+            CkptPut(&w, ppn, sizes[b] * sizeof(uint64_t));
         }
-        
-        if (memoryUsed > memoryMax) {
-            memoryMax = memoryUsed;
+        for (int j = 0; j < t->level_count; j++) {
+            CkptPutU64(&w, t->levels[j].size);
+            CkptPut(&w, t->levels[j].sec, t->levels[j].size * sizeof(section));
         }
     }
-    
-    // 处理缓冲区中剩余的数据
-    ProcessWriteBuffer();
-    // 记录结束时间
-    gettimeofday(&end, NULL);
-    FTLDestroy();
-    if (file != stdout) {
-        fclose(file);
+    CkptPutU64(&w, CKPT_END);
+    // 检查点已包含日志中的全部记录
+    return CkptCommit(&w) && JournalTruncate(ftl->write_buffer.journal);
+}
+
+static bool load_group(FTL *ftl, CkptImage *img, uint64_t group) {
+    uint64_t level_count;
+    const uint64_t *valid;
+    const uint8_t *sizes;
+    if (!CkptGetU64(img, &level_count) || level_count > UINT8_MAX ||
+        !(valid = CkptGet(img, sizeof(uint64_t) * GROUPNUM)) || !(sizes = CkptGet(img, MAX_HASH_SIZE))) {
+        return false;
     }
-    
-    // 计算秒数和微秒数
-    long seconds = end.tv_sec - start.tv_sec;
-    long useconds = end.tv_usec - start.tv_usec;
-    // 总微秒数
-   double during= (seconds * 1000000) + useconds;
-    double throughput = (double)ioVector->len / during; // 转换为毫秒
-    
-    printf("Throughput:\t\t %f IOPS\n", throughput*1000 );
-    printf("Max memory used:\t\t %llu B\n", (unsigned long long)memoryMax);
-    return RETURN_OK;
-}
\ No newline at end of file
+    table *t = GroupDirTouch(&ftl->groups, group);
+    if (!t || t->levels) {
+        return false;
+    }
+    memcpy(t->valid, valid, sizeof(t->valid));
+
+    for (int b = 0; b < MAX_HASH_SIZE; b++) {
+        const uint8_t *lba = CkptGet(img, sizes[b]);
+        const uint64_t *ppn = CkptGet(img, sizes[b] * sizeof(uint64_t));
+        if (!lba || !ppn || sizes[b] > MAX_HASH_SIZE) {
+            return false;
+        }
+        if (sizes[b] == 0) {
+            continue;
+        }
+        grouphash *h = &t->hash[b];
+        h->ghash = ArenaAlloc(&ftl->arena, sizes[b] * sizeof(hash_entry));
+        if (!h->ghash) {
+            return false;
+        }
+        for (int i = 0; i < sizes[b]; i++) {
+            h->ghash[i].lba = lba[i];
+            h->ghash[i].ppn = ppn[i];
+        }
+        h->size = sizes[b];
+    }
+
+    if (level_count == 0) {
+        return true;
+    }
+    t->levels = ArenaAlloc(&ftl->arena, level_count * sizeof(levelsec));
+    if (!t->levels) {
+        return false;
+    }
+    memset(t->levels, 0, level_count * sizeof(levelsec));
+    t->level_count = level_count;
+    for (uint64_t j = 0; j < level_count; j++) {
+        uint64_t size;
+        const section *sec;
+        if (!CkptGetU64(img, &size) || size > UINT32_MAX || !(sec = CkptGet(img, size * sizeof(section)))) {
+            return false;
+        }
+        // 层内段数组按段数分配，与level_append一致
+        levelsec *lsec = &t->levels[j];
+        if (size) {
+            lsec->sec = ArenaAlloc(&ftl->arena, size * sizeof(section));
+            bool created;
+            if (!lsec->sec || !SectionBoundsReserve(&ftl->arena, &lsec->bounds, size, &created)) {
+                return false;
+            }
+            memcpy(lsec->sec, sec, size * sizeof(section));
+            lsec->size = size;
+            for (uint32_t i = 0; i < lsec->size; i++) {
+                lsec->dead += !is_section_valid(&lsec->sec[i]);
+                sync_bounds(lsec, i);
+            }
+        }
+    }
+    return true;
+}
+
+static void *FTLRestore(const ftl_config *config, const char *path) {
+    CkptImage img;
+    if (!CkptOpen(&img, path, ftl_ops_hash.name)) {
+        return NULL;
+    }
+    FTL *ftl = create_instance(config);
+    if (!ftl) {
+        CkptClose(&img);
+        return NULL;
+    }
+    uint64_t group_count, group;
+    bool ok = CkptGetU64(&img, &group_count) && group_count == ftl->groups.group_count &&
+              WriteBufferLoad(&ftl->write_buffer, &img);
+    while (ok && (ok = CkptGetU64(&img, &group)) && group != CKPT_END) {
+        ok = load_group(ftl, &img, group);
+    }
+    CkptClose(&img);
+    if (!ok) {
+        fprintf(stderr, "Cannot restore %s from %s: corrupt payload or different LBA range\n",
+                ftl_ops_hash.name, path);
+        FTLDestroy(ftl);
+        return NULL;
+    }
+    // 检查点之后的更新在日志中
+    if (!WriteBufferAttachJournal(&ftl->write_buffer, config, FTLFlush, ftl)) {
+        FTLDestroy(ftl);
+        return NULL;
+    }
+    return ftl;
+}
+
+const ftl_ops ftl_ops_hash = {
+    .name = "hash",
+    .group_size = SECTORS_PER_GROUP,
+    .init = FTLInit,
+    .destroy = FTLDestroy,
+    .read = FTLRead,
+    .modify = FTLModify,
+    .flush = FTLFlush,
+    .stats = FTLStats,
+    .checkpoint = FTLCheckpoint,
+    .restore = FTLRestore,
+};
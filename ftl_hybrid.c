@@ -0,0 +1,409 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "ftl_ops.h"
+
+#define PPN_COUNT 1000000
+#define BLOCKS_PER_PAGE 64      // 每个块的页数，与contrast相同
+#define BLOCK_STRIDE 1000       // 相邻物理块起始PPN的间隔
+#define HASH_MULTIPLIER UINT64_C(0x9E3779B97F4A7C15)
+#define NO_LOG (-1)
+#define ALL_PAGES UINT64_MAX
+
+// 数据块：contrast的块映射项，另记哪些页的最新副本已经写进了日志块
+typedef struct {
+    uint64_t valid;         // 写过的页
+    uint64_t logged;        // 最新副本在日志块中的页
+    uint64_t pba;
+} data_block;
+
+// 页映射的日志块，页按写入顺序追加
+typedef struct {
+    uint64_t pba;
+    int64_t owner;          // BAST日志块和FAST顺序日志块所属的数据块；FAST随机日志块为NO_LOG
+    uint64_t live;          // 仍是最新副本的页
+    uint64_t stamp;         // 分配顺序，没有空闲日志块时先合并最早分配的
+    uint32_t used;
+    bool active;
+} log_block;
+
+// 混合日志块FTL：数据块按块映射，块内第一次写的页原地写入；改写追加到少量页映射的日志块，
+// 日志块用完时通过合并还原成块映射。
+// 合并分三种：日志块从第0页起按序写满时直接换成数据块（switch），按序只写了前面一部分时
+// 把其余页拷进来再换（partial），否则把数据块的所有页拷到新块（full）
+typedef struct {
+    log_assoc assoc;
+    uint32_t log_count;
+    uint32_t active_count;
+    data_block *blocks;
+    log_block *logs;
+    // 日志页的页级映射：节点n是日志块n/64的第n%64页，只有最新副本在按LBA哈希的链上
+    uint64_t *page_lba;
+    int32_t *hnext;
+    int32_t *buckets;
+    uint64_t bucket_mask;
+    int32_t *log_of;        // BAST：数据块当前的日志块
+    int32_t seq_log;        // FAST：顺序日志块
+    int32_t rand_log;       // FAST：正在追加的随机日志块
+    uint32_t rand_count;    // FAST：在用的随机日志块数，最多log_count-1
+    uint64_t *free_pba;     // 已擦除的空闲物理块，比日志块多一个，完全合并时总有新块可用
+    uint32_t free_count;
+    uint64_t clock;
+    uint64_t switch_merges;
+    uint64_t partial_merges;
+    uint64_t full_merges;
+    uint64_t copies;
+    uint64_t erases;
+    uint64_t memoryUsed;
+    uint64_t memoryMax;
+} FTL;
+
+static inline uint64_t bucket_of(const FTL *ftl, uint64_t lba) {
+    return ((lba * HASH_MULTIPLIER) >> 32) & ftl->bucket_mask;
+}
+
+static inline uint64_t page_bit(uint64_t lba) {
+    return UINT64_C(1) << (lba % BLOCKS_PER_PAGE);
+}
+
+static int32_t find_page(const FTL *ftl, uint64_t lba) {
+    int32_t n = ftl->buckets[bucket_of(ftl, lba)];
+    while (n != NO_LOG && ftl->page_lba[n] != lba) {
+        n = ftl->hnext[n];
+    }
+    return n;
+}
+
+// 日志页不再是最新副本
+static void unlink_page(FTL *ftl, int32_t n) {
+    int32_t *p = &ftl->buckets[bucket_of(ftl, ftl->page_lba[n])];
+    while (*p != n) {
+        p = &ftl->hnext[*p];
+    }
+    *p = ftl->hnext[n];
+    ftl->logs[n / BLOCKS_PER_PAGE].live &= ~page_bit(n);
+}
+
+// 数据块的这些页在日志块中的副本全部作废
+static void drop_logged(FTL *ftl, uint64_t block, uint64_t pages) {
+    data_block *d = &ftl->blocks[block];
+    pages &= d->logged;
+    d->logged &= ~pages;
+    while (pages) {
+        int offset = __builtin_ctzll(pages);
+        pages &= pages - 1;
+        unlink_page(ftl, find_page(ftl, block * BLOCKS_PER_PAGE + offset));
+    }
+}
+
+static void append(FTL *ftl, int32_t slot, uint64_t lba) {
+    data_block *d = &ftl->blocks[lba / BLOCKS_PER_PAGE];
+    if (d->logged & page_bit(lba)) {
+        unlink_page(ftl, find_page(ftl, lba));
+    }
+    log_block *log = &ftl->logs[slot];
+    int32_t n = slot * BLOCKS_PER_PAGE + (int32_t)log->used++;
+    uint64_t b = bucket_of(ftl, lba);
+    ftl->page_lba[n] = lba;
+    ftl->hnext[n] = ftl->buckets[b];
+    ftl->buckets[b] = n;
+    log->live |= page_bit(n);
+    d->logged |= page_bit(lba);
+}
+
+// 调用方保证有空闲的日志块位置
+static int32_t alloc_log(FTL *ftl, int64_t owner) {
+    int32_t slot = 0;
+    while (ftl->logs[slot].active) {
+        slot++;
+    }
+    log_block *log = &ftl->logs[slot];
+    log->pba = ftl->free_pba[--ftl->free_count];
+    log->owner = owner;
+    log->live = 0;
+    log->stamp = ftl->clock++;
+    log->used = 0;
+    log->active = true;
+    ftl->active_count++;
+    return slot;
+}
+
+// 日志块不再作为日志块使用，物理块由调用方处理
+static void detach_log(FTL *ftl, int32_t slot) {
+    log_block *log = &ftl->logs[slot];
+    log->active = false;
+    ftl->active_count--;
+    if (ftl->assoc == LOG_BAST) {
+        ftl->log_of[log->owner] = NO_LOG;
+    } else if (slot == ftl->seq_log) {
+        ftl->seq_log = NO_LOG;
+    } else {
+        ftl->rand_count--;
+        if (slot == ftl->rand_log) {
+            ftl->rand_log = NO_LOG;
+        }
+    }
+}
+
+// 擦除已没有有效页的日志块
+static void release_log(FTL *ftl, int32_t slot) {
+    detach_log(ftl, slot);
+    ftl->free_pba[ftl->free_count++] = ftl->logs[slot].pba;
+    ftl->erases++;
+}
+
+static int32_t owned_log(const FTL *ftl, uint64_t block) {
+    if (ftl->assoc == LOG_BAST) {
+        return ftl->log_of[block];
+    }
+    if (ftl->seq_log != NO_LOG && ftl->logs[ftl->seq_log].owner == (int64_t)block) {
+        return ftl->seq_log;
+    }
+    return NO_LOG;
+}
+
+// 把数据块所有页的最新副本拷到一个新块，旧数据块和它独占的日志块都擦除
+static void full_merge(FTL *ftl, uint64_t block) {
+    data_block *d = &ftl->blocks[block];
+    uint64_t pba = ftl->free_pba[--ftl->free_count];
+    ftl->copies += __builtin_popcountll(d->valid);
+    drop_logged(ftl, block, ALL_PAGES);
+    ftl->free_pba[ftl->free_count++] = d->pba;
+    ftl->erases++;
+    d->pba = pba;
+    ftl->full_merges++;
+    int32_t owned = owned_log(ftl, block);
+    if (owned != NO_LOG) {
+        release_log(ftl, owned);
+    }
+}
+
+// 合并只属于一个数据块的日志块（BAST日志块或FAST顺序日志块）
+static void merge_owned(FTL *ftl, int32_t slot) {
+    log_block *log = &ftl->logs[slot];
+    uint64_t block = (uint64_t)log->owner;
+    data_block *d = &ftl->blocks[block];
+    uint64_t prefix = log->used == BLOCKS_PER_PAGE ? ALL_PAGES : (UINT64_C(1) << log->used) - 1;
+    // 从第0页起按序写的前used页都还是最新副本时，日志块可以直接当作数据块
+    bool sequential = log->live == prefix;
+    for (uint32_t i = 0; sequential && i < log->used; i++) {
+        sequential = ftl->page_lba[slot * BLOCKS_PER_PAGE + i] == block * BLOCKS_PER_PAGE + i;
+    }
+    if (!sequential) {
+        full_merge(ftl, block);
+        return;
+    }
+    // 其余页的最新副本在数据块或随机日志块中，都拷进来
+    ftl->copies += __builtin_popcountll(d->valid & ~prefix);
+    drop_logged(ftl, block, ALL_PAGES);
+    detach_log(ftl, slot);
+    ftl->free_pba[ftl->free_count++] = d->pba;
+    ftl->erases++;
+    d->pba = log->pba;
+    if (log->used == BLOCKS_PER_PAGE) {
+        ftl->switch_merges++;
+    } else {
+        ftl->partial_merges++;
+    }
+}
+
+// 最早分配的日志块；random时只看FAST的随机日志块
+static int32_t oldest_log(const FTL *ftl, bool random) {
+    int32_t oldest = NO_LOG;
+    for (uint32_t i = 0; i < ftl->log_count; i++) {
+        const log_block *log = &ftl->logs[i];
+        if (!log->active || (random && log->owner != NO_LOG)) {
+            continue;
+        }
+        if (oldest == NO_LOG || log->stamp < ftl->logs[oldest].stamp) {
+            oldest = (int32_t)i;
+        }
+    }
+    return oldest;
+}
+
+// 随机日志块中的页可能属于任意数据块，其中仍有效的页所属的数据块都要完全合并，之后整块擦除
+static void evict_random(FTL *ftl, int32_t slot) {
+    log_block *log = &ftl->logs[slot];
+    while (log->live) {
+        int i = __builtin_ctzll(log->live);
+        full_merge(ftl, ftl->page_lba[slot * BLOCKS_PER_PAGE + i] / BLOCKS_PER_PAGE);
+    }
+    release_log(ftl, slot);
+}
+
+// BAST：每个数据块独占一个日志块，写满或日志块不够时合并
+static void write_bast(FTL *ftl, uint64_t lba) {
+    uint64_t block = lba / BLOCKS_PER_PAGE;
+    int32_t slot = ftl->log_of[block];
+    if (slot != NO_LOG && ftl->logs[slot].used == BLOCKS_PER_PAGE) {
+        merge_owned(ftl, slot);
+        slot = NO_LOG;
+    }
+    if (slot == NO_LOG) {
+        if (ftl->active_count == ftl->log_count) {
+            merge_owned(ftl, oldest_log(ftl, false));
+        }
+        slot = alloc_log(ftl, (int64_t)block);
+        ftl->log_of[block] = slot;
+    }
+    append(ftl, slot, lba);
+}
+
+// FAST：从块首开始的写进顺序日志块，能接上时继续追加，以便switch合并；
+// 其余的写追加到所有数据块共享的随机日志块
+static void write_fast(FTL *ftl, uint64_t lba) {
+    uint64_t block = lba / BLOCKS_PER_PAGE;
+    uint32_t offset = lba % BLOCKS_PER_PAGE;
+    if (offset == 0) {
+        if (ftl->seq_log != NO_LOG) {
+            merge_owned(ftl, ftl->seq_log);
+        }
+        ftl->seq_log = alloc_log(ftl, (int64_t)block);
+        append(ftl, ftl->seq_log, lba);
+        return;
+    }
+    if (ftl->seq_log != NO_LOG && ftl->logs[ftl->seq_log].owner == (int64_t)block &&
+        ftl->logs[ftl->seq_log].used == offset) {
+        append(ftl, ftl->seq_log, lba);
+        return;
+    }
+    if (ftl->rand_log == NO_LOG || ftl->logs[ftl->rand_log].used == BLOCKS_PER_PAGE) {
+        ftl->rand_log = NO_LOG;
+        if (ftl->rand_count == ftl->log_count - 1) {
+            evict_random(ftl, oldest_log(ftl, true));
+        }
+        ftl->rand_log = alloc_log(ftl, NO_LOG);
+        ftl->rand_count++;
+    }
+    append(ftl, ftl->rand_log, lba);
+}
+
+static void FTLDestroy(void *handle) {
+    FTL *ftl = handle;
+    if (ftl) {
+        free(ftl->blocks);
+        free(ftl->logs);
+        free(ftl->page_lba);
+        free(ftl->hnext);
+        free(ftl->buckets);
+        free(ftl->log_of);
+        free(ftl->free_pba);
+        free(ftl);
+    }
+}
+
+static void *FTLInit(const ftl_config *config) {
+    uint32_t min_logs = config->log_assoc == LOG_FAST ? 2 : 1;
+    if (config->log_blocks < min_logs) {
+        fprintf(stderr, "hybrid needs at least %u log blocks for %s, got %u\n", min_logs,
+                config->log_assoc == LOG_FAST ? "fast" : "bast", config->log_blocks);
+        return NULL;
+    }
+    FTL *ftl = FTLAllocInstance(sizeof(FTL));
+    if (!ftl) {
+        perror("Failed to allocate FTL");
+        return NULL;
+    }
+    ftl->assoc = config->log_assoc;
+    ftl->log_count = config->log_blocks;
+    ftl->seq_log = NO_LOG;
+    ftl->rand_log = NO_LOG;
+    uint64_t pages = (uint64_t)ftl->log_count * BLOCKS_PER_PAGE;
+    uint64_t buckets = 1;
+    while (buckets < pages) {
+        buckets *= 2;
+    }
+    ftl->blocks = malloc(PPN_COUNT * sizeof(data_block));
+    ftl->logs = calloc(ftl->log_count, sizeof(log_block));
+    ftl->page_lba = malloc(pages * sizeof(uint64_t));
+    ftl->hnext = malloc(pages * sizeof(int32_t));
+    ftl->buckets = malloc(buckets * sizeof(int32_t));
+    ftl->free_pba = malloc((ftl->log_count + 1) * sizeof(uint64_t));
+    if (ftl->assoc == LOG_BAST) {
+        ftl->log_of = malloc(PPN_COUNT * sizeof(int32_t));
+    }
+    if (!ftl->blocks || !ftl->logs || !ftl->page_lba || !ftl->hnext || !ftl->buckets || !ftl->free_pba ||
+        (ftl->assoc == LOG_BAST && !ftl->log_of)) {
+        perror("Failed to allocate hybrid mapping tables");
+        FTLDestroy(ftl);
+        return NULL;
+    }
+    ftl->bucket_mask = buckets - 1;
+    memset(ftl->buckets, 0xff, buckets * sizeof(int32_t));
+    if (ftl->log_of) {
+        memset(ftl->log_of, 0xff, PPN_COUNT * sizeof(int32_t));
+    }
+    for (uint64_t i = 0; i < PPN_COUNT; i++) {
+        ftl->blocks[i].valid = 0;
+        ftl->blocks[i].logged = 0;
+        ftl->blocks[i].pba = i * BLOCK_STRIDE;
+    }
+    // 数据块之后的物理块先都空闲，作日志块或合并的目标块
+    for (uint32_t i = 0; i <= ftl->log_count; i++) {
+        ftl->free_pba[ftl->free_count++] = (PPN_COUNT + (uint64_t)i) * BLOCK_STRIDE;
+    }
+    ftl->memoryUsed = sizeof(FTL) + PPN_COUNT * sizeof(data_block) + ftl->log_count * sizeof(log_block) +
+                      pages * (sizeof(uint64_t) + sizeof(int32_t)) + buckets * sizeof(int32_t) +
+                      (ftl->log_count + 1) * sizeof(uint64_t) + (ftl->log_of ? PPN_COUNT * sizeof(int32_t) : 0);
+    return ftl;
+}
+
+static uint64_t FTLRead(void *handle, uint64_t lba) {
+    FTL *ftl = handle;
+    uint64_t block = lba / BLOCKS_PER_PAGE;
+    if (block >= PPN_COUNT) {
+        return 0;
+    }
+    const data_block *d = &ftl->blocks[block];
+    if (d->logged & page_bit(lba)) {
+        int32_t n = find_page(ftl, lba);
+        return ftl->logs[n / BLOCKS_PER_PAGE].pba + n % BLOCKS_PER_PAGE;
+    }
+    return d->pba + lba % BLOCKS_PER_PAGE;
+}
+
+static bool FTLModify(void *handle, uint64_t lba) {
+    FTL *ftl = handle;
+    uint64_t block = lba / BLOCKS_PER_PAGE;
+    if (block >= PPN_COUNT) {
+        return false; // 越界
+    }
+    data_block *d = &ftl->blocks[block];
+    if ((d->valid & page_bit(lba)) == 0) {
+        d->valid |= page_bit(lba);  // 不是重写，直接写进数据块
+        return true;
+    }
+    if (ftl->assoc == LOG_BAST) {
+        write_bast(ftl, lba);
+    } else {
+        write_fast(ftl, lba);
+    }
+    return true;
+}
+
+static void FTLStats(void *handle, ftl_stats *stats) {
+    FTL *ftl = handle;
+    stats->memoryUsed = ftl->memoryUsed;
+    stats->memoryMax = ftl->memoryMax > ftl->memoryUsed ? ftl->memoryMax : ftl->memoryUsed;
+    stats->switchMerges = ftl->switch_merges;
+    stats->partialMerges = ftl->partial_merges;
+    stats->fullMerges = ftl->full_merges;
+    stats->mergeCopies = ftl->copies;
+    stats->blockErases = ftl->erases;
+}
+
+const ftl_ops ftl_ops_hybrid = {
+    .name = "hybrid",
+    .group_size = 0,
+    .init = FTLInit,
+    .destroy = FTLDestroy,
+    .read = FTLRead,
+    .modify = FTLModify,
+    .flush = NULL,
+    .stats = FTLStats,
+    .checkpoint = NULL,
+    .restore = NULL,
+};
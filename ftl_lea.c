@@ -1,704 +1,653 @@
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
-#include "ftl.h"
+#include "ftl_ops.h"
+#include "write_buffer.h"
+#include "arena.h"
+#include "section.h"
+#include "group_dir.h"
+#include "xlate_cache.h"
+#include "plr.h"
+#include "checkpoint.h"
+#include "journal.h"
 
 #define MAX_RECURSION_DEPTH 16
-#define NUMBER_OF_SECTORS 250000
+#define COMPACT_LEVELS 4        // 组的层数超过该值时压缩
+#define APPROX_MAX_GAP 8        // 近似段平均每个LBA最多占这么多个偏移
 #define SECTORS_PER_GROUP 256
 #define FLASH_PAGE_SIZE 4096
-#define WRITE_BUFFER_SIZE 256
-#define tolerance 2
-#define INVALID_START 0xFF  // 使用0xFF表示无效（uint8_t的最大值）
+#define OOB_INITIAL_PAGES (1 << 20)
 
-static uint64_t memoryUsed = 0;
-static uint64_t memoryMax = 0;
-
-// 写缓冲区结构
-typedef struct {
-    uint64_t lba[WRITE_BUFFER_SIZE];
-    int count;
-    uint32_t next_ppn;
-} WriteBuffer;
-
-typedef struct {
-    uint8_t *data;          // 扁平数组存储所有LBA，用CRB_SEPARATOR分隔段
-    int size;               // data数组当前大小
-    bool *accuracy;         // 每段的精度标记：true为精确段，false为近似段
-} CRB;
-
-typedef struct {
-    uint8_t start;
-    uint8_t length;
-    uint8_t step;
-    uint32_t b; 
-    bool accuracy;          // 精度标记：true为精确段，false为近似段
-} section;
 
+// 层内各段按start升序排列，覆盖的范围互不重叠
 typedef struct {
     section *sec;
-    uint8_t size;
+    uint16_t size;
+    uint16_t capacity;
 } levelsec;
 
 typedef struct {
     levelsec *levels;
     uint8_t level_count;
-    CRB crb;
+    uint64_t mapped[SECTORS_PER_GROUP / 64];  // 写过的偏移，只增不减；没写过的偏移读时不查各层
 } table;
 
+// 近似段只给出PPN的预测值，真实PPN在预测值前后gamma页以内。
+// 读时依次探测这些页OOB区中记录的组内偏移，与要找的偏移相同就是它。
+// oob模拟闪存页的OOB区，不属于映射表，不计入memoryUsed
 typedef struct {
-    table t[NUMBER_OF_SECTORS];
+    GroupDir groups;        // 组号到table的目录，组表在首次落盘写到时分配
     WriteBuffer write_buffer;
+    XlateCache cache;       // 读结果缓存，落盘时整体失效
+    Arena arena;            // levels和各层的段数组都从这里分配，占用即memoryUsed
+    uint8_t *oob;           // oob[ppn - oob_base]为该页所写LBA的组内偏移
+    uint64_t oob_base;
+    uint64_t oob_pages;
+    int gamma;
+    plr_segment plr[SECTORS_PER_GROUP];  // 一组的分段结果，落盘和压缩时用
 } FTL;
 
-static FTL *ftl = NULL;
+static FTL *create_instance(const ftl_config *config) {
+    // memoryUsed只统计段映射占用的内存，组目录不计入
+    FTL *ftl = FTLAllocInstance(sizeof(FTL));
+    if (!ftl) {
+        return NULL;
+    }
+    ArenaInit(&ftl->arena);
+    ftl->gamma = config->plr_gamma;
+    ftl->oob_base = config->ppn_base;
 
-// 定义分隔符
-#define CRB_SEPARATOR 0xFF
+    uint64_t groups = (config->lba_count + SECTORS_PER_GROUP - 1) / SECTORS_PER_GROUP;
+    if (!GroupDirInit(&ftl->groups, groups, sizeof(table))) {
+        free(ftl);
+        return NULL;
+    }
+    if (!WriteBufferInit(&ftl->write_buffer, config, SECTORS_PER_GROUP)) {
+        GroupDirFree(&ftl->groups);
+        free(ftl);
+        return NULL;
+    }
+    if (!XlateCacheInit(&ftl->cache, config->xlate_cache_entries)) {
+        WriteBufferFree(&ftl->write_buffer);
+        GroupDirFree(&ftl->groups);
+        free(ftl);
+        return NULL;
+    }
+    return ftl;
+}
 
-// 初始化CRB
-void init_crb(CRB *crb) {
-    crb->data = NULL;
-    crb->size = 0;
-    crb->accuracy = NULL;
+static void FTLDestroy(void *handle) {
+    FTL *ftl = handle;
+    if (!ftl) return;
+
+    ArenaFree(&ftl->arena);
+    GroupDirFree(&ftl->groups);
+    WriteBufferFree(&ftl->write_buffer);
+    XlateCacheFree(&ftl->cache);
+    free(ftl->oob);
+    free(ftl);
+}
+
+// 确保oob能容纳oob_base起的end页
+static bool oob_reserve(FTL *ftl, uint64_t end) {
+    if (end > ftl->oob_pages) {
+        uint64_t pages = ftl->oob_pages ? ftl->oob_pages : OOB_INITIAL_PAGES;
+        while (pages < end) {
+            pages *= 2;
+        }
+        uint8_t *oob = realloc(ftl->oob, pages);
+        if (!oob) {
+            fprintf(stderr, "Failed to realloc memory for OOB\n");
+            return false;
+        }
+        ftl->oob = oob;
+        ftl->oob_pages = pages;
+    }
+    return true;
 }
 
-// 释放CRB内存
-void free_crb(CRB *crb) {
-    if (crb->data) {
-        free(crb->data);
-        crb->data = NULL;
+// 记下[ppn, ppn+n)这些页写入时的组内偏移
+static bool oob_write(FTL *ftl, uint64_t ppn, const uint64_t *lba, int n) {
+    if (!oob_reserve(ftl, ppn + n - ftl->oob_base)) {
+        return false;
     }
-    if (crb->accuracy) {
-        free(crb->accuracy);
-        crb->accuracy = NULL;
+    for (int i = 0; i < n; i++) {
+        ftl->oob[ppn - ftl->oob_base + i] = lba[i] % SECTORS_PER_GROUP;
     }
-    crb->size = 0;
+    return true;
 }
 
-// 在CRB中查找指定LBA对应的offset
-int crb_search_offset(CRB *crb, uint8_t lba_offset, bool *is_accurate) {
-    if (!crb || !crb->data || crb->size == 0 || !crb->accuracy) {
+// 返回最后一个start不大于offset的段的下标，没有时返回-1。无分支的二分查找
+static inline int find_section(const levelsec *lsec, int offset) {
+    const section *base = lsec->sec;
+    int n = lsec->size;
+    if (n == 0 || section_start(base[0]) > offset) {
         return -1;
     }
-    
-    int current_segment = 0;
-    int segment_start_index = 0;
-    int segment_offset = 0;
-    
-    // 遍历整个data数组
-    for (int i = 0; i < crb->size; i++) {
-        if (crb->data[i] == CRB_SEPARATOR) {
-            // 遇到分隔符，移动到下一个段
-            current_segment++;
-            segment_start_index = i + 1;
-            segment_offset = 0;
-            continue;
-        }
-        
-        // 检查当前LBA是否匹配
-        if (crb->data[i] == lba_offset) {
-            // 返回offset和精度信息
-            if (is_accurate) {
-                *is_accurate = crb->accuracy[current_segment];
-            }
-            return segment_offset;
-        }
-        
-        segment_offset++;
+    while (n > 1) {
+        int half = n >> 1;
+        base = section_start(base[half]) <= offset ? base + half : base;
+        n -= half;
     }
-    
-    return -1; // 未找到
+    return (int)(base - lsec->sec);
 }
 
-// 计算段的数量
-int count_segments(CRB *crb) {
-    if (!crb || !crb->data || crb->size == 0) {
-        return 0;
+// 确保第level层存在，返回该层
+static levelsec *ensure_level(FTL *ftl, int idx, int level) {
+    table *t = GroupDirTouch(&ftl->groups, idx);
+    if (!t) {
+        return NULL;
+    }
+    while (t->level_count <= level) {
+        uint8_t new_count = t->level_count + 1;
+        levelsec *new_levels = ArenaRealloc(&ftl->arena, t->levels, t->level_count * sizeof(levelsec),
+                                            new_count * sizeof(levelsec));
+        if (!new_levels) {
+            fprintf(stderr, "Failed to realloc memory for levels\n");
+            return NULL;
+        }
+        t->levels = new_levels;
+
+        // 初始化新扩展的层级
+        t->levels[t->level_count].sec = NULL;
+        t->levels[t->level_count].size = 0;
+        t->levels[t->level_count].capacity = 0;
+        t->level_count = new_count;
     }
-    
-    int count = 1; // 至少有一个段
-    for (int i = 0; i < crb->size; i++) {
-        if (crb->data[i] == CRB_SEPARATOR) {
-            count++;
+    return &t->levels[level];
+}
+
+// 按start有序插入，调用方保证新段与层内已有的段不重叠
+static bool level_insert(FTL *ftl, levelsec *lsec, section sec) {
+    if (lsec->size >= lsec->capacity) {
+        uint16_t new_capacity = lsec->capacity == 0 ? 4 : lsec->capacity * 2;
+        section *new_secs = ArenaRealloc(&ftl->arena, lsec->sec, lsec->capacity * sizeof(section),
+                                         new_capacity * sizeof(section));
+        if (!new_secs) {
+            fprintf(stderr, "Failed to realloc memory for sections\n");
+            return false;
         }
+        lsec->sec = new_secs;
+        lsec->capacity = new_capacity;
     }
-    return count;
+    int pos = find_section(lsec, section_start(sec)) + 1;
+    memmove(&lsec->sec[pos + 1], &lsec->sec[pos], (lsec->size - pos) * sizeof(section));
+    lsec->sec[pos] = sec;
+    lsec->size++;
+    return true;
 }
 
-// CRB插入函数
-void crbinsert(int group, int *lba_offsets, int size, bool is_accurate) {
-    if (!ftl || group < 0 || group >= NUMBER_OF_SECTORS || !lba_offsets || size <= 0) {
+// 在start_level层插入新段，与它范围重叠的旧段整段下沉到下一层，下一层依此类推。
+// 任意两个范围重叠的段中较新的总在更上层，读时从上往下第一个命中的就是最新映射。
+// 近似段的预测以段首为基准，不能像精确段那样切开，所以整段下沉
+static void Insert(FTL *ftl, int idx, section new_sec, int start_level) {
+    if (!ftl || idx < 0 || start_level >= MAX_RECURSION_DEPTH) {
         return;
     }
-    
-    CRB *crb = &ftl->t[group].crb;
-    
-    // 如果CRB未初始化，先初始化data数组
-    if (crb->data == NULL) {
-        crb->data = malloc(size * sizeof(uint8_t));
-        if (!crb->data) return;
-        crb->size = 0;
-    }
-    
-    // 对输入的LBA偏移量进行排序和去重
-    uint8_t *sorted_lbas = malloc(size * sizeof(uint8_t));
-    int sorted_size = 0;
-    
-    // 简单的插入排序和去重
-    for (int i = 0; i < size; i++) {
-        uint8_t current = (uint8_t)lba_offsets[i];
-        int pos = 0;
-        while (pos < sorted_size && sorted_lbas[pos] < current) {
-            pos++;
-        }
-        
-        if (pos < sorted_size && sorted_lbas[pos] == current) {
-            continue; // 去重
-        }
-        
-        // 插入到正确位置
-        for (int j = sorted_size; j > pos; j--) {
-            sorted_lbas[j] = sorted_lbas[j - 1];
-        }
-        sorted_lbas[pos] = current;
-        sorted_size++;
-    }
-    
-    // 计算需要的新空间：当前size + 新段大小 + 1个分隔符（如果不是第一个段）
-    int current_segment_count = count_segments(crb);
-    int needs_separator = (crb->size > 0) ? 1 : 0;
-    int new_total_size = crb->size + sorted_size + needs_separator;
-    
-    // 重新分配data数组
-    uint8_t *new_data = realloc(crb->data, new_total_size * sizeof(uint8_t));
-    if (!new_data) {
-        free(sorted_lbas);
+    levelsec *lsec = ensure_level(ftl, idx, start_level);
+    if (!lsec) {
         return;
     }
-    crb->data = new_data;
-    
-    // 重新分配accuracy数组
-    int new_segment_count = current_segment_count + 1;
-    bool *new_accuracy = realloc(crb->accuracy, new_segment_count * sizeof(bool));
-    if (!new_accuracy) {
-        free(sorted_lbas);
-        return;
+
+    int lo = section_start(new_sec), hi = section_end(new_sec);
+    int first = find_section(lsec, lo);
+    if (first < 0 || section_end(lsec->sec[first]) < lo) {
+        first++;
+    }
+    int last = first;
+    while (last < lsec->size && section_start(lsec->sec[last]) <= hi) {
+        last++;
     }
-    crb->accuracy = new_accuracy;
-    
-    // 如果是第一个段，直接复制数据
-    if (current_segment_count == 0) {
-        for (int i = 0; i < sorted_size; i++) {
-            crb->data[i] = sorted_lbas[i];
-        }
-        crb->accuracy[0] = is_accurate;
-        crb->size = sorted_size;
-    } else {
-        // 不是第一个段，需要找到插入位置
-        
-        // 首先找到新段应该插入的位置（按第一个LBA的大小排序）
-        int insert_position = crb->size;
-        int target_segment_index = current_segment_count;
-        
-        for (int i = 0; i < crb->size; i++) {
-            if (crb->data[i] == CRB_SEPARATOR) {
-                continue;
-            }
-            
-            // 找到第一个大于新段第一个LBA的位置
-            if (crb->data[i] > sorted_lbas[0]) {
-                // 回溯找到这个段的开始位置
-                insert_position = i;
-                while (insert_position > 0 && crb->data[insert_position - 1] != CRB_SEPARATOR) {
-                    insert_position--;
-                }
-                
-                // 计算目标段索引
-                target_segment_index = 0;
-                for (int j = 0; j < insert_position; j++) {
-                    if (crb->data[j] == CRB_SEPARATOR) {
-                        target_segment_index++;
-                    }
-                }
-                break;
-            }
-        }
-        
-        // 移动现有数据为新段腾出空间
-        for (int i = crb->size - 1; i >= insert_position; i--) {
-            crb->data[i + sorted_size + 1] = crb->data[i];
-        }
-        
-        // 移动accuracy数组
-        for (int i = current_segment_count - 1; i >= target_segment_index; i--) {
-            crb->accuracy[i + 1] = crb->accuracy[i];
-        }
-        
-        // 插入分隔符和新段数据
-        if (insert_position < crb->size) {
-            crb->data[insert_position] = CRB_SEPARATOR;
-        }
-        
-        for (int i = 0; i < sorted_size; i++) {
-            crb->data[insert_position + 1 + i] = sorted_lbas[i];
-        }
-        
-        // 设置新段的精度
-        crb->accuracy[target_segment_index] = is_accurate;
-        crb->size = new_total_size;
-    }
-    
-    free(sorted_lbas);
-    memoryUsed += size*sizeof(uint8_t);
-    // 更新内存使用统计
-    
-}
 
-void FTLInit() {
-    ftl = calloc(1, sizeof(FTL));
-    if (!ftl) {
-        return;
+    section sunk[SECTORS_PER_GROUP];
+    int sunk_count = last - first;
+    if (sunk_count > 0) {
+        memcpy(sunk, &lsec->sec[first], sunk_count * sizeof(section));
+        memmove(&lsec->sec[first], &lsec->sec[last], (lsec->size - last) * sizeof(section));
+        lsec->size -= sunk_count;
     }
-    
-    memoryUsed += sizeof(FTL);
-    ftl->write_buffer.next_ppn = 1000;
-    for(int i = 0; i < NUMBER_OF_SECTORS; i++){
-        init_crb(&ftl->t[i].crb);
+    level_insert(ftl, lsec, new_sec);
+
+    // 递归可能扩展levels数组，之后不再使用lsec
+    for (int i = 0; i < sunk_count; i++) {
+        Insert(ftl, idx, sunk[i], start_level + 1);
     }
 }
 
-void FTLDestroy() {
-    if (!ftl) return;
-    
-    for (int i = 0; i < NUMBER_OF_SECTORS; i++) {
-        for (int j = 0; j < ftl->t[i].level_count; j++) {
-            if (ftl->t[i].levels[j].sec) {
-                free(ftl->t[i].levels[j].sec);
-            }
+// 在覆盖offset的段中找它的PPN，找不到返回0
+static uint64_t probe_section(FTL *ftl, section sec, uint8_t offset) {
+    int delta = offset - section_start(sec);
+    if (!section_is_approx(sec)) {
+        int step = section_step(sec);
+        if (step > 0 ? delta % step == 0 : delta == 0) {
+            return (section_ppn(sec) + (step ? delta / step : 0)) * FLASH_PAGE_SIZE;
         }
-        if (ftl->t[i].levels) {
-            free(ftl->t[i].levels);
-        }
-        free_crb(&ftl->t[i].crb);
+        return 0;
     }
-    free(ftl);
-    ftl = NULL;
-}
 
-void sort_lba_array(uint64_t *lba_array, int size) {
-    for (int i = 1; i < size; i++) {
-        uint64_t key = lba_array[i];
-        int j = i - 1;
-        while (j >= 0 && lba_array[j] > key) {
-            lba_array[j + 1] = lba_array[j];
-            j--;
+    // 从预测的页开始向两边探测，只在本段自己的页内找
+    uint64_t base = section_approx_ppn(sec);
+    int count = section_approx_count(sec);
+    int predicted = PLRPredict(section_step(sec), delta);
+    for (int d = 0; d <= ftl->gamma; d++) {
+        int k = predicted + d;
+        if (k < count && ftl->oob[base + k - ftl->oob_base] == offset) {
+            return (base + k) * FLASH_PAGE_SIZE;
+        }
+        k = predicted - d;
+        if (d > 0 && k >= 0 && k < count && ftl->oob[base + k - ftl->oob_base] == offset) {
+            return (base + k) * FLASH_PAGE_SIZE;
         }
-        lba_array[j + 1] = key;
     }
+    return 0;
 }
 
-// 判断section是否有效
-bool is_section_valid(section *sec) {
-    return sec->start != INVALID_START;
+// 按层从上到下查找，每层最多一个段覆盖该偏移，段内没有它就交给下一层
+static uint64_t search_in_sections(FTL *ftl, table *t, uint8_t offset) {
+    for (int level = 0; level < t->level_count; level++) {
+        levelsec *lsec = &t->levels[level];
+        int i = find_section(lsec, offset);
+        if (i < 0 || offset > section_end(lsec->sec[i])) {
+            continue;
+        }
+        uint64_t result = probe_section(ftl, lsec->sec[i], offset);
+        if (result != 0) {
+            return result;
+        }
+    }
+    return 0;
 }
 
-// 重叠检测函数
-bool is_overlap(section *a, section *b) {
-    // 如果任意一个section无效，则不重叠
-    if (!is_section_valid(a) || !is_section_valid(b)) {
-        return false;
+static void free_levels(FTL *ftl, table *t) {
+    for (int j = 0; j < t->level_count; j++) {
+        ArenaRelease(&ftl->arena, t->levels[j].sec, t->levels[j].capacity * sizeof(section));
     }
-    
-    // 处理单个元素的情况
-    uint8_t a_end = (a->length > 0) ? (a->start + a->length) : a->start;
-    uint8_t b_end = (b->length > 0) ? (b->start + b->length) : b->start;
-    
-    // 对于单个元素，我们只检查精确匹配
-    if (a->length == 0 && b->length == 0) {
-        return a->start == b->start;
-    }
-    
-    // 对于连续序列，检查范围重叠
-    return !(a->start > b_end || a_end < b->start);
+    ArenaRelease(&ftl->arena, t->levels, t->level_count * sizeof(levelsec));
+    t->levels = NULL;
+    t->level_count = 0;
 }
 
-// 从levelsec中删除指定索引的section
-void remove_section_from_level(levelsec *lsec, int index) {
-    if (!lsec || index < 0 || index >= lsec->size) {
-        return;
+// 把组内升序的n个LBA切成段放到ftl->plr，返回段数。
+// 近似段范围宽，之后落在它空隙里的写入都会把它整段压下去：
+// 平均每个LBA占的偏移超过APPROX_MAX_GAP的近似段改回精确段，整体能减少段数时才采用近似段，
+// 否则与gamma为0时的切分相同
+static int build_segments(FTL *ftl, const uint64_t *lba, int n) {
+    int segments = PLRBuild(lba, n, 0, SECTION_MAX_STEP, SECTION_MAX_STEP, ftl->plr);
+    if (ftl->gamma == 0 || segments == 1) {
+        return segments;
+    }
+    plr_segment approx[SECTORS_PER_GROUP], out[SECTORS_PER_GROUP];
+    int m = PLRBuild(lba, n, ftl->gamma, SECTION_MAX_STEP, SECTION_MAX_STEP, approx);
+    int count = 0;
+    for (int i = 0; i < m; i++) {
+        const plr_segment *seg = &approx[i];
+        uint64_t span = lba[seg->first + seg->count - 1] - lba[seg->first] + 1;
+        if (seg->count == 1 || seg->step > 0 || span <= (uint64_t)APPROX_MAX_GAP * seg->count) {
+            out[count++] = *seg;
+            continue;
+        }
+        int k = PLRBuild(&lba[seg->first], seg->count, 0, SECTION_MAX_STEP, SECTION_MAX_STEP, &out[count]);
+        for (int j = 0; j < k; j++) {
+            out[count + j].first += seg->first;
+        }
+        count += k;
     }
-    
-    // 将后面的元素前移
-    for (int i = index; i < lsec->size - 1; i++) {
-        lsec->sec[i] = lsec->sec[i + 1];
+    if (count < segments) {
+        memcpy(ftl->plr, out, count * sizeof(plr_segment));
+        segments = count;
     }
-    lsec->size--;
+    return segments;
 }
 
-// 修改后的Insert函数
-void Insert(int idx, section new_sec, int start_level) {
-    memoryUsed += sizeof(section);
-    if (!ftl || idx < 0 || idx >= NUMBER_OF_SECTORS) {
-        return;
+// 压缩一个组：取出当前生效的映射，重新拟合成一层。
+// 按偏移升序把PPN逐个加一的映射切成块，每块与一次落盘中连续写入的页对应，块内再做PLR。
+// 块覆盖的页都是块内的有效映射，近似段探测时不会碰到已失效的页；各块的范围互不重叠
+static void compact_group(FTL *ftl, int idx) {
+    table *t = GroupDirFind(&ftl->groups, idx);
+    uint64_t lba[SECTORS_PER_GROUP];
+    uint64_t ppn[SECTORS_PER_GROUP];
+    int n = 0;
+    for (int o = 0; o < SECTORS_PER_GROUP; o++) {
+        uint64_t addr = search_in_sections(ftl, t, o);
+        if (addr) {
+            lba[n] = o;
+            ppn[n] = addr / FLASH_PAGE_SIZE;
+            n++;
+        }
     }
-    
-    int current_level = start_level;
-    section current_sec = new_sec;
-    
-    while (current_level < MAX_RECURSION_DEPTH) {
-        // 确保有足够的层级
-        while (ftl->t[idx].level_count <= current_level) {
-            uint8_t new_count = ftl->t[idx].level_count + 1;
-            levelsec *new_levels = realloc(ftl->t[idx].levels, new_count * sizeof(levelsec));
-            if (!new_levels) return;
-            ftl->t[idx].levels = new_levels;
-            
-            ftl->t[idx].levels[ftl->t[idx].level_count].sec = NULL;
-            ftl->t[idx].levels[ftl->t[idx].level_count].size = 0;
-            ftl->t[idx].level_count = new_count;
+
+    section secs[SECTORS_PER_GROUP];
+    int count = 0;
+    int first = 0;
+    while (first < n) {
+        int end = first + 1;
+        while (end < n && ppn[end] == ppn[end - 1] + 1) {
+            end++;
         }
-        
-        levelsec *current_level_ptr = &ftl->t[idx].levels[current_level];
-        section *conflict_sec = NULL;
-        int conflict_index = -1;
-        
-        // 在当前层查找冲突的section
-        for (int i = 0; i < current_level_ptr->size; i++) {
-            section *existing_sec = &current_level_ptr->sec[i];
-            if (is_section_valid(existing_sec) && is_overlap(existing_sec, &current_sec)) {
-                conflict_sec = existing_sec;
-                conflict_index = i;
-                break;
+        int segments = build_segments(ftl, &lba[first], end - first);
+        for (int i = 0; i < segments; i++) {
+            const plr_segment *seg = &ftl->plr[i];
+            int k = first + seg->first;
+            uint8_t length = lba[k + seg->count - 1] - lba[k];
+            if (seg->count == 1 || seg->step > 0) {
+                secs[count++] = section_make(lba[k], length, seg->step, true, ppn[k]);
+            } else {
+                secs[count++] = section_make_approx(lba[k], length, seg->slope, ppn[k], seg->count);
             }
         }
-        
-        if (conflict_sec != NULL) {
-            // 保存冲突的section，准备移到下一层
-            section temp_sec = *conflict_sec;
-            
-            // 彻底删除当前层的冲突section
-            remove_section_from_level(current_level_ptr, conflict_index);
-            memoryUsed -= sizeof(section);
-            
-            // 插入当前section到当前层
-            uint8_t new_size = current_level_ptr->size + 1;
-            section *new_secs = realloc(current_level_ptr->sec, new_size * sizeof(section));
-            if (!new_secs) return;
-            current_level_ptr->sec = new_secs;
-            current_level_ptr->sec[current_level_ptr->size] = current_sec;
-            current_level_ptr->size = new_size;
-            
-            // 将冲突的section作为下一轮要处理的section
-            current_sec = temp_sec;
-            current_level++;
-        } else {
-            // 没有冲突，直接插入当前层
-            uint8_t new_size = current_level_ptr->size + 1;
-            section *new_secs = realloc(current_level_ptr->sec, new_size * sizeof(section));
-            if (!new_secs) return;
-            current_level_ptr->sec = new_secs;
-            current_level_ptr->sec[current_level_ptr->size] = current_sec;
-            current_level_ptr->size = new_size;
-            break;
-        }
+        first = end;
+    }
+
+    free_levels(ftl, t);
+    levelsec *lsec = ensure_level(ftl, idx, 0);
+    if (!lsec) {
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        level_insert(ftl, lsec, secs[i]);
     }
 }
 
-// 检查写缓冲区中是否包含指定的LBA
-bool is_lba_in_write_buffer(uint64_t lba) {
-    if (!ftl || ftl->write_buffer.count == 0) {
+// 第0层是否有整段落在偏移a和b之间。新段跨过这样的段时会把它整段压到下一层，
+// 它并没有被覆盖，只是平白多出一层，随后又要压缩
+static bool gap_has_section(table *t, int a, int b) {
+    if (!t || t->level_count == 0) {
         return false;
     }
-    
-    for (int i = 0; i < ftl->write_buffer.count; i++) {
-        if (ftl->write_buffer.lba[i] == lba) {
-            return true;
+    const levelsec *lsec = &t->levels[0];
+    int i = find_section(lsec, a) + 1;
+    return i < lsec->size && section_end(lsec->sec[i]) < b;
+}
+
+// 把批内下标[first, first+n)的LBA用PLR切成精确段和近似段插入，返回用掉的PPN数
+static uint32_t insert_run(FTL *ftl, int group, const uint64_t *lba, int first, int n, uint32_t ppn) {
+    int segments = build_segments(ftl, &lba[first], n);
+    for (int i = 0; i < segments; i++) {
+        const plr_segment *seg = &ftl->plr[i];
+        uint8_t start = lba[first + seg->first] % SECTORS_PER_GROUP;
+        uint8_t length = lba[first + seg->first + seg->count - 1] - lba[first + seg->first];
+        section sec;
+        if (seg->count == 1 || seg->step > 0) {
+            sec = section_make(start, length, seg->step, true, ppn);
+        } else {
+            sec = section_make_approx(start, length, seg->slope, ppn, seg->count);
         }
+        Insert(ftl, group, sec, 0);
+        ppn += seg->count;
     }
-    return false;
+    return (uint32_t)n;
 }
 
-// ProcessWriteBuffer函数
-void ProcessWriteBuffer() {
+// ProcessWriteBuffer函数：每组的LBA用PLR切成精确段和近似段。
+// 相邻两个LBA之间夹着第0层的整段时先在此切开，新段只压下它真正覆盖的旧段
+static void ProcessWriteBuffer(FTL *ftl) {
     if (!ftl || ftl->write_buffer.count == 0) return;
-    
-    sort_lba_array(ftl->write_buffer.lba, ftl->write_buffer.count);
+
+    // 映射即将改变，之前缓存的读结果全部作废
+    XlateCacheInvalidate(&ftl->cache);
+
+    WriteBufferSortLBA(&ftl->write_buffer);
     uint32_t current_ppn = ftl->write_buffer.next_ppn;
-    
+    const uint64_t *lba = ftl->write_buffer.lba;
+
+    // 按升序分配PPN，先把每页的OOB写好
+    if (!oob_write(ftl, current_ppn, lba, ftl->write_buffer.count)) {
+        return;
+    }
+
     int idx = 0;
     while (idx < ftl->write_buffer.count) {
-        int current_group = ftl->write_buffer.lba[idx] / SECTORS_PER_GROUP;
-        
+        int current_group = lba[idx] / SECTORS_PER_GROUP;
+
         // 找到当前组的结束位置
         int group_end = idx;
-        for (int i = idx + 1; i < ftl->write_buffer.count; i++) {
-            if (ftl->write_buffer.lba[i] / SECTORS_PER_GROUP != current_group) {
-                group_end = i - 1;
-                break;
-            }
-            group_end = i;
+        while (group_end + 1 < ftl->write_buffer.count &&
+               lba[group_end + 1] / SECTORS_PER_GROUP == (uint64_t)current_group) {
+            group_end++;
         }
-        
-        // 处理当前组内的所有连续序列
-        int group_idx = idx;
-        while (group_idx <= group_end) {
-            int* data = NULL;
-            int size = 0;
-            section sec;
-            sec.start = ftl->write_buffer.lba[group_idx] % SECTORS_PER_GROUP;
-            sec.b = current_ppn * FLASH_PAGE_SIZE;
-            sec.accuracy = true; // 默认为精确段
-            
-            // 检查是否是单个元素
-            if (group_idx == group_end) {
-                data = malloc(sizeof(int));
-                data[0] = ftl->write_buffer.lba[group_idx] % SECTORS_PER_GROUP;
-                size = 1;
-                crbinsert(current_group, data, size, true); // 精确段
-                current_ppn++;
-                group_idx++;
-                free(data);
-                continue;
-            }
-            
-            data = malloc(sizeof(int));
-            data[0] = ftl->write_buffer.lba[group_idx] % SECTORS_PER_GROUP;
-            size = 1;
-            
-            // 检查步长
-            int step = ftl->write_buffer.lba[group_idx + 1] - ftl->write_buffer.lba[group_idx];
-            int sequence_end = group_idx;
-            bool is_continuous = true;
-            
-            // 查找具有相同步长的连续序列
-            for (int i = group_idx + 1; i <= group_end; i++) {
-                if ((ftl->write_buffer.lba[i] - ftl->write_buffer.lba[i - 1] >= step - tolerance) && 
-                    (ftl->write_buffer.lba[i] - ftl->write_buffer.lba[i - 1] <= step + tolerance)) {
-                    size++;
-                    int *data_ = (int*)realloc(data, sizeof(int) * size);
-                    data = data_;
-                    data[size - 1] = ftl->write_buffer.lba[i] % SECTORS_PER_GROUP;
-                    
-                    if (ftl->write_buffer.lba[i] - ftl->write_buffer.lba[i - 1] == step) {
-                        sequence_end = i;
-                    } else {
-                        is_continuous = false;
-                    }
-                } else {
-                    break;
-                }
-            }
-            
-            if (sequence_end > group_idx && is_continuous) {
-                // 找到连续序列 - 精确段
-                sec.length = (ftl->write_buffer.lba[sequence_end] % SECTORS_PER_GROUP) - 
-                            (ftl->write_buffer.lba[group_idx] % SECTORS_PER_GROUP);
-                sec.step = step;
-                sec.accuracy = true;
-                
-                Insert(current_group, sec, 0);
-                current_ppn += (sequence_end - group_idx) + 1;
-                group_idx = sequence_end + 1;
-            } else if (size > 1) {
-                // 非连续序列 - 近似段
-                sec.accuracy = false;
-                Insert(current_group, sec, 0);
-                
-                // 同时将数据插入CRB作为近似段
-                crbinsert(current_group, data, size, false);
-                current_ppn += size;
-                group_idx += size;
-            } else {
-                // 单个元素 - 精确段
-                crbinsert(current_group, data, size, true);
-                current_ppn += size;
-                group_idx += size;
+
+        table *t = GroupDirTouch(&ftl->groups, current_group);
+        if (t) {
+            for (int i = idx; i <= group_end; i++) {
+                uint8_t offset = lba[i] % SECTORS_PER_GROUP;
+                t->mapped[offset / 64] |= 1ULL << (offset % 64);
             }
-            
-            free(data);
         }
-        
-        idx = group_end + 1;
-    }
-    
-    ftl->write_buffer.next_ppn = current_ppn;
-    ftl->write_buffer.count = 0;
-}
 
-// 在section中查找LBA
-uint64_t search_in_sections(table *t, uint8_t offset) {
-    // 从顶层到底层搜索
-    for (int level = 0; level < t->level_count; level++) {
-        levelsec *lsec = &t->levels[level];
-        
-        for (int i = 0; i < lsec->size; i++) {
-            section *sec = &lsec->sec[i];
-            
-            // 跳过无效的section
-            if (!is_section_valid(sec)) {
-                continue;
-            }
-            
-            // 检查LBA是否在这个段内
-            if (sec->accuracy) {
-                // 精确段：直接计算
-                if (sec->length > 0) {
-                    // 连续序列的情况
-                    if (offset >= sec->start && offset <= sec->start + sec->length) {
-                        if (sec->step > 0 && (offset - sec->start) % sec->step == 0) {
-                            uint32_t ppa_offset = (offset - sec->start) / sec->step;
-                            uint64_t result = sec->b + ppa_offset * FLASH_PAGE_SIZE;
-                            return result;
-                        }
-                    }
-                } else {
-                    // 单个元素的情况
-                    if (offset == sec->start) {
-                        return sec->b;
-                    }
-                }
-            } else {
-                // 近似段：需要在CRB中查找
-                bool is_accurate;
-                int crb_offset = crb_search_offset(&t->crb, offset, &is_accurate);
-                if (crb_offset >= 0 && !is_accurate) {
-                    // 在CRB中找到且为近似段，返回段起始地址 + offset
-                    return sec->b + crb_offset * FLASH_PAGE_SIZE;
-                }
+        // 插入只改动已切出部分的范围，不影响后面的间隙判断
+        int run = idx;
+        for (int i = idx; i <= group_end; i++) {
+            if (i == group_end || gap_has_section(t, lba[i] % SECTORS_PER_GROUP, lba[i + 1] % SECTORS_PER_GROUP)) {
+                current_ppn += insert_run(ftl, current_group, lba, run, i - run + 1, current_ppn);
+                run = i + 1;
             }
         }
+        if (t && t->level_count > COMPACT_LEVELS) {
+            compact_group(ftl, current_group);
+        }
+
+        idx = group_end + 1;
     }
-    return 0;
+
+    WriteBufferCommit(&ftl->write_buffer, current_ppn);
 }
 
-// 修改FTLRead函数
-uint64_t FTLRead(uint64_t lba) {
+static uint64_t FTLRead(void *handle, uint64_t lba) {
+    FTL *ftl = handle;
     if (!ftl) {
         return 0;
     }
-    
-    // 检查写缓冲区中是否有这个LBA
-    if (is_lba_in_write_buffer(lba)) {
-        // 如果有，先处理写缓冲区
-        ProcessWriteBuffer();
+
+    // 仍在写缓冲区中的LBA直接返回落盘时将分配的PPN，不提前落盘
+    uint32_t pending_ppn;
+    if (WriteBufferPendingPPN(&ftl->write_buffer, lba, &pending_ppn)) {
+        return (uint64_t)pending_ppn * FLASH_PAGE_SIZE;
     }
-    
-    int idx = lba / SECTORS_PER_GROUP;
+
+    uint64_t idx = lba / SECTORS_PER_GROUP;
     uint8_t offset = lba % SECTORS_PER_GROUP;
-    
-    if (idx < 0 || idx >= NUMBER_OF_SECTORS) {
-        printf("[FTLRead Error] Invalid index: %d for LBA: %lu\n", idx, lba);
+
+    if (idx >= ftl->groups.group_count) {
+        printf("[FTLRead Error] Invalid index: %lu for LBA: %lu\n", idx, lba);
+        return 0;
+    }
+
+    // 从未写过的组没有分配组表，从未写过的偏移不在mapped中
+    table *t = GroupDirFind(&ftl->groups, idx);
+    if (!t || (t->mapped[offset / 64] >> (offset % 64) & 1) == 0) {
         return 0;
     }
-    
-    table *t = &ftl->t[idx];
-    
-    // 首先在section中查找
-    uint64_t result = search_in_sections(t, offset);
-    if (result != 0) {
+    uint64_t result;
+    if (XlateCacheLookup(&ftl->cache, lba, &result)) {
         return result;
     }
-    
-    // 如果在section中没找到，在CRB中查找（精确段）
-    bool is_accurate;
-    int crb_offset = crb_search_offset(&t->crb, offset, &is_accurate);
-    if (crb_offset >= 0 && is_accurate) {
-        // 在CRB中找到且为精确段
-        // 这里需要根据CRB中的存储方式计算PBA
-        // 由于简化实现，这里返回一个基于offset的计算值
-        return (crb_offset + 1) * FLASH_PAGE_SIZE;
-    }
-    
-    return 0;
+    result = search_in_sections(ftl, t, offset);
+    XlateCacheStore(&ftl->cache, lba, result);
+    return result;
 }
 
-bool FTLModify(uint64_t lba) {
+static bool FTLModify(void *handle, uint64_t lba) {
+    FTL *ftl = handle;
     if (!ftl) {
         return false;
     }
-    
-    // 添加到写缓冲区
-    if (ftl->write_buffer.count < WRITE_BUFFER_SIZE) {
-        ftl->write_buffer.lba[ftl->write_buffer.count++] = lba;
-    } else {
+
+    if (lba / SECTORS_PER_GROUP >= ftl->groups.group_count) {
+        return false;
+    }
+
+    // 添加到写缓冲区，已缓冲的LBA原地覆盖
+    if (!WriteBufferAdd(&ftl->write_buffer, lba)) {
         return false;
     }
-    
+
     // 如果缓冲区满了，处理缓冲区
-    if (ftl->write_buffer.count >= WRITE_BUFFER_SIZE) {
-        ProcessWriteBuffer();
+    if (ftl->write_buffer.count >= ftl->write_buffer.capacity) {
+        ProcessWriteBuffer(ftl);
     }
-    
+
     return true;
 }
 
-uint32_t AlgorithmRun(IOVector *ioVector, const char *filename) {
-    if (!ioVector) {
-        return RETURN_ERROR;
-    }
-    
-    if (!ioVector->ioArray) {
-        return RETURN_ERROR;
-    }
-    
-    struct timeval start, end;
-    FILE *file = filename ? fopen(filename, "w") : stdout;
-    if (!file) {
-        printf("[AlgorithmRun Error] Failed to open output file: %s\n", filename);
-        return RETURN_ERROR;
-    }
-    
-    // 初始化 FTL
-    FTLInit();
-    
-    // 重置内存统计
-    memoryUsed = 0;
-    memoryMax = 0;
-
-    // 记录开始时间
-    gettimeofday(&start, NULL);
-
-    for (uint64_t i = 0; i < ioVector->len; ++i) {
-        if (ioVector->ioArray[i].type == IO_READ) {
-            uint64_t ret = FTLRead(ioVector->ioArray[i].lba);
-            fprintf(file, "%llu\n", (unsigned long long)ret);
-        } else {
-            if (!FTLModify(ioVector->ioArray[i].lba)) {
-                printf("[AlgorithmRun Error] Failed to modify LBA: %lu\n", ioVector->ioArray[i].lba);
-            }
+// 落盘后等日志写出，此前的修改在返回时都已持久
+static void FTLFlush(void *handle) {
+    FTL *ftl = handle;
+    ProcessWriteBuffer(ftl);
+    JournalSync(ftl->write_buffer.journal);
+}
+
+static void *FTLInit(const ftl_config *config) {
+    FTL *ftl = create_instance(config);
+    if (ftl && !WriteBufferAttachJournal(&ftl->write_buffer, config, FTLFlush, ftl)) {
+        FTLDestroy(ftl);
+        return NULL;
+    }
+    return ftl;
+}
+
+static void FTLStats(void *handle, ftl_stats *stats) {
+    FTL *ftl = handle;
+    stats->memoryUsed = ftl->arena.live;
+    stats->memoryMax = ftl->arena.peak;
+    stats->cacheMemory = XlateCacheMemory(&ftl->cache);
+    JournalStats(ftl->write_buffer.journal, stats);
+}
+
+// 检查点载荷：组数、gamma、写缓冲区、已写页的OOB，然后是每个写过的组：组号、层数、mapped、
+// 各层的段数和容量及段数组，最后是CKPT_END
+static bool FTLCheckpoint(void *handle, const char *path) {
+    FTL *ftl = handle;
+    CkptWriter w;
+    if (!CkptCreate(&w, path, ftl_ops_lea.name)) {
+        return false;
+    }
+    CkptPutU64(&w, ftl->groups.group_count);
+    CkptPutU64(&w, ftl->gamma);
+    WriteBufferSave(&ftl->write_buffer, &w);
+    uint64_t written = ftl->write_buffer.next_ppn - ftl->oob_base;
+    CkptPutU64(&w, ftl->oob_base);
+    CkptPutU64(&w, written);
+    CkptPut(&w, ftl->oob, written);
+    uint64_t group = 0;
+    for (table *t; (t = GroupDirNext(&ftl->groups, &group)); group++) {
+        if (!t->levels && !(t->mapped[0] | t->mapped[1] | t->mapped[2] | t->mapped[3])) {
+            continue;
         }
-        
-        if (memoryUsed > memoryMax) {
-            memoryMax = memoryUsed;
+        CkptPutU64(&w, group);
+        CkptPutU64(&w, t->level_count);
+        CkptPut(&w, t->mapped, sizeof(t->mapped));
+        for (int j = 0; j < t->level_count; j++) {
+            levelsec *lsec = &t->levels[j];
+            CkptPutU64(&w, (uint64_t)lsec->capacity << 16 | lsec->size);
+            CkptPut(&w, lsec->sec, lsec->size * sizeof(section));
         }
     }
-    
-    // 处理缓冲区中剩余的数据
-    ProcessWriteBuffer();
-
-    // 记录结束时间
-    gettimeofday(&end, NULL);
+    CkptPutU64(&w, CKPT_END);
+    // 检查点已包含日志中的全部记录
+    return CkptCommit(&w) && JournalTruncate(ftl->write_buffer.journal);
+}
 
-    FTLDestroy();
+// 按原容量分配各层并整块拷入段数组，占用的内存与写出时相同
+static bool load_group(FTL *ftl, CkptImage *img, uint64_t group) {
+    uint64_t level_count;
+    const uint64_t *mapped;
+    if (!CkptGetU64(img, &level_count) || level_count > UINT8_MAX ||
+        !(mapped = CkptGet(img, sizeof(uint64_t) * (SECTORS_PER_GROUP / 64)))) {
+        return false;
+    }
+    table *t = GroupDirTouch(&ftl->groups, group);
+    if (!t || t->levels) {
+        return false;
+    }
+    memcpy(t->mapped, mapped, sizeof(t->mapped));
+    if (level_count == 0) {
+        return true;
+    }
+    t->levels = ArenaAlloc(&ftl->arena, level_count * sizeof(levelsec));
+    if (!t->levels) {
+        return false;
+    }
+    memset(t->levels, 0, level_count * sizeof(levelsec));
+    t->level_count = level_count;
 
-    if (file != stdout) {
-        fclose(file);
+    for (uint64_t j = 0; j < level_count; j++) {
+        uint64_t sizes;
+        if (!CkptGetU64(img, &sizes) || sizes >> 16 > UINT16_MAX || (sizes & 0xFFFF) > sizes >> 16) {
+            return false;
+        }
+        levelsec *lsec = &t->levels[j];
+        int size = sizes & 0xFFFF;
+        const section *sec = CkptGet(img, size * sizeof(section));
+        if (!sec) {
+            return false;
+        }
+        if (sizes >> 16) {
+            lsec->sec = ArenaAlloc(&ftl->arena, (sizes >> 16) * sizeof(section));
+            if (!lsec->sec) {
+                return false;
+            }
+            lsec->capacity = sizes >> 16;
+            memcpy(lsec->sec, sec, size * sizeof(section));
+            lsec->size = size;
+        }
     }
-    
-    // 计算秒数和微秒数
-    long seconds = end.tv_sec - start.tv_sec;
-    long useconds = end.tv_usec - start.tv_usec;
+    return true;
+}
 
-    // 总微秒数
-    double memory=(double)memoryMax/(1024.0*1024.0);
-    double during = (seconds * 1000000.0 + useconds) / 1000.0;  // 转换为毫秒
-    double throughput = ioVector->len / during;  // 计算吞吐量
-    printf("algorithmRunningDuration:\t %f ms\n", throughput);
-    printf("Max memory used:\t\t %f MB\n", memory);
+// 近似段是按写出时的gamma拟合的，gamma不同时读会漏掉映射，因此要求一致
+static void *FTLRestore(const ftl_config *config, const char *path) {
+    CkptImage img;
+    if (!CkptOpen(&img, path, ftl_ops_lea.name)) {
+        return NULL;
+    }
+    FTL *ftl = create_instance(config);
+    if (!ftl) {
+        CkptClose(&img);
+        return NULL;
+    }
+    uint64_t group_count, gamma, oob_base, written, group;
+    const uint8_t *oob = NULL;
+    bool ok = CkptGetU64(&img, &group_count) && group_count == ftl->groups.group_count &&
+              CkptGetU64(&img, &gamma) && gamma == (uint64_t)ftl->gamma &&
+              WriteBufferLoad(&ftl->write_buffer, &img) &&
+              CkptGetU64(&img, &oob_base) && CkptGetU64(&img, &written) &&
+              (oob = CkptGet(&img, written)) != NULL;
+    if (ok) {
+        ftl->oob_base = oob_base;
+        ok = oob_reserve(ftl, written);
+    }
+    if (ok && written) {
+        memcpy(ftl->oob, oob, written);
+    }
+    while (ok && (ok = CkptGetU64(&img, &group)) && group != CKPT_END) {
+        ok = load_group(ftl, &img, group);
+    }
+    CkptClose(&img);
+    if (!ok) {
+        fprintf(stderr, "Cannot restore %s from %s: corrupt payload, different LBA range or gamma\n",
+                ftl_ops_lea.name, path);
+        FTLDestroy(ftl);
+        return NULL;
+    }
+    // 检查点之后的更新在日志中
+    if (!WriteBufferAttachJournal(&ftl->write_buffer, config, FTLFlush, ftl)) {
+        FTLDestroy(ftl);
+        return NULL;
+    }
+    return ftl;
+}
 
-    return RETURN_OK;
-}
\ No newline at end of file
+const ftl_ops ftl_ops_lea = {
+    .name = "lea",
+    .group_size = SECTORS_PER_GROUP,
+    .init = FTLInit,
+    .destroy = FTLDestroy,
+    .read = FTLRead,
+    .modify = FTLModify,
+    .flush = FTLFlush,
+    .stats = FTLStats,
+    .checkpoint = FTLCheckpoint,
+    .restore = FTLRestore,
+};
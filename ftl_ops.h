@@ -0,0 +1,142 @@
+#ifndef FTL_OPS_H
+#define FTL_OPS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "../public.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 各映射方案上报的统计信息
+typedef struct {
+    uint64_t memoryUsed;
+    uint64_t memoryMax;
+    uint64_t cacheMemory;   // 读结果缓存占用的内存，不计入memoryUsed
+    uint64_t journalBytes;  // 写入映射日志的字节数（含帧头）
+    uint64_t journalCommits;  // 映射日志的组提交次数
+    uint64_t cmtHits;       // DFTL缓存映射表的命中次数
+    uint64_t cmtMisses;
+    uint64_t cmtEvictions;  // 为腾出位置而逐出的缓存项数
+    uint64_t cmtPrefetched; // 预取进缓存映射表的项数
+    uint64_t cmtPrefetchHits;  // 其中在逐出前被用到的
+    uint64_t cmtRejected;   // 读未命中被准入过滤挡在缓存映射表外的次数
+    uint64_t tpageReads;    // DFTL读翻译页的次数
+    uint64_t tpageWrites;
+    uint64_t tpageWritesAvoided;  // 批量更新和cache内合并省掉的翻译页写
+    uint64_t switchMerges;  // 混合FTL日志块直接换成数据块的合并次数
+    uint64_t partialMerges; // 先补齐其余页再换的合并次数
+    uint64_t fullMerges;    // 把整块数据拷到新块的合并次数
+    uint64_t mergeCopies;   // 合并时拷贝的页数
+    uint64_t blockErases;   // 合并时擦除的块数
+} ftl_stats;
+
+// 段映射方案分配PPN的默认起点
+#define FTL_DEFAULT_PPN_BASE 1000
+// 段映射方案写缓冲区的默认容量（LBA数）
+#define FTL_DEFAULT_WRITE_BUFFER_SIZE 256
+// 段映射方案默认的LBA范围：4KB页时为16TB
+#define FTL_DEFAULT_LBA_COUNT (UINT64_C(1) << 32)
+// 段映射方案读结果缓存的默认项数
+#define FTL_DEFAULT_XLATE_CACHE 4096
+// lea近似段允许的PPN预测误差（页数）
+#define FTL_DEFAULT_PLR_GAMMA 4
+// DFTL缓存映射表的默认项数
+#define FTL_DEFAULT_CMT_ENTRIES 16
+// DFTL每个翻译页的映射项数：4KB页，每项8字节
+#define FTL_DEFAULT_TPAGE_ENTRIES 512
+// 混合FTL默认的日志块数
+#define FTL_DEFAULT_LOG_BLOCKS 64
+
+// 映射日志的fsync策略
+typedef enum {
+    JOURNAL_SYNC_COMMIT = 0,    // 每次组提交后fsync
+    JOURNAL_SYNC_PERIODIC,      // 至多每JOURNAL_SYNC_INTERVAL_MS一次，flush时强制
+    JOURNAL_SYNC_NONE,          // 只write，由系统回写
+} journal_sync;
+
+// DFTL缓存映射表的替换策略
+typedef enum {
+    CMT_LRU = 0,
+    CMT_CLOCK,
+    CMT_SLRU,               // 分段LRU：新项进试用段，再次命中才进保护段
+    CMT_ARC,                // 自适应替换，另记同样多的已逐出key
+} cmt_policy;
+
+// 混合FTL中日志块与数据块的关联方式
+typedef enum {
+    LOG_FAST = 0,           // 一个顺序日志块，其余随机日志块由所有数据块共享（全相联）
+    LOG_BAST,               // 每个日志块只属于一个数据块
+} log_assoc;
+
+// 实例配置，由调用方填好后传给init
+typedef struct {
+    uint64_t ppn_base;      // 本实例分配PPN的起始值，分片运行时每个分片各占一段
+    uint32_t write_buffer_size;  // 写缓冲区能容纳的LBA数，越大每次落盘得到的段越长
+    bool group_sort;        // 落盘时先按组计数排序再组内排序，否则做基数排序
+    uint64_t lba_count;     // LBA范围，超出的LBA读为0、写入失败；组表只为写到的范围分配
+    uint32_t xlate_cache_entries;  // 读结果缓存的项数，0表示不用缓存
+    uint32_t plr_gamma;     // lea近似段的误差上界，越大段越少、读时探测的页越多；0表示只用精确段
+    const char *journal_path;  // 映射日志文件，init时先重放再继续追加；NULL表示不记日志
+    journal_sync journal_sync;
+    uint32_t cmt_entries;   // DFTL缓存映射表能容纳的映射页数
+    cmt_policy cmt_policy;
+    bool cmt_prefetch;      // 顺序或等步长访问时从刚读的翻译页预取后续映射
+    bool cmt_admission;     // 用TinyLFU准入过滤决定读未命中和预取的项能否挤掉缓存中的项
+    uint32_t tpage_entries;     // DFTL翻译页的映射项数
+    const char *tpage_path;     // 存放DFTL翻译页的文件；NULL表示用内存替身
+    uint32_t tpage_read_us;     // 每次读翻译页额外等待的微秒数
+    uint32_t tpage_write_us;
+    bool eager_init;        // origin在init时就让整张平坦映射表的页面就位（多线程、尽量用大页），否则按需清零
+    bool packed_map;        // origin的映射项按物理页数定宽位压缩存放，省内存，读写多几次移位
+    uint32_t log_blocks;    // 混合FTL的页映射日志块数，FAST至少2个
+    log_assoc log_assoc;
+} ftl_config;
+
+// 映射方案接口，每个ftl_*.c导出一个实例，由ftl_driver.c按名字选择。
+// init返回方案私有的实例，其余操作都作用在该实例上，不同实例之间没有共享状态
+typedef struct {
+    const char *name;
+    uint32_t group_size;                // 互相独立的LBA组大小，可以按组分片并行；0表示不支持分片
+    void *(*init)(const ftl_config *config);  // 失败返回NULL
+    void (*destroy)(void *ftl);
+    uint64_t (*read)(void *ftl, uint64_t lba);
+    bool (*modify)(void *ftl, uint64_t lba);
+    void (*flush)(void *ftl);           // 没有写缓冲区的方案为NULL
+    void (*stats)(void *ftl, ftl_stats *stats);
+    // 把全部映射状态（含写缓冲区）写入检查点文件，失败返回false；不支持时为NULL
+    bool (*checkpoint)(void *ftl, const char *path);
+    // 从checkpoint写出的文件恢复实例，代替init；文件不匹配时返回NULL。不支持时为NULL
+    void *(*restore)(const ftl_config *config, const char *path);
+} ftl_ops;
+
+extern const ftl_ops ftl_ops_origin;    // ftl_origin.c  页级平坦映射
+extern const ftl_ops ftl_ops_contrast;  // ftl_contrast.c 块级映射
+extern const ftl_ops ftl_ops_hybrid;    // ftl_hybrid.c  块级映射 + 页映射日志块（BAST/FAST）
+extern const ftl_ops ftl_ops_dftl;      // ftl_dftl.c    带CMT的DFTL
+extern const ftl_ops ftl_ops_lea;       // ftl_lea.c     误差有界的分段线性映射（LeaFTL）
+extern const ftl_ops ftl_ops_hash;      // ftl_hash.c    段 + 组内哈希
+extern const ftl_ops ftl_ops_segments;  // ftl.c         分层段映射（冲突时切分）
+extern const ftl_ops ftl_ops_cascade;   // ftl_.c        分层段映射（冲突时整段下沉）
+
+void FTLDefaultConfig(ftl_config *config);
+// 在默认配置上应用环境变量：FTL_WRITE_BUFFER=写缓冲区LBA数，FTL_SORT=radix|group，
+// FTL_GAMMA=lea近似段的误差上界，FTL_LBA_COUNT=LBA范围，FTL_XLATE_CACHE=读结果缓存项数，
+// FTL_JOURNAL=映射日志文件，FTL_JOURNAL_SYNC=commit|periodic|none，
+// FTL_CMT_ENTRIES=DFTL缓存映射表项数，FTL_CMT_POLICY=lru|clock|slru|arc，
+// FTL_CMT_PREFETCH=on|off，FTL_CMT_ADMISSION=on|off，
+// FTL_TPAGE_ENTRIES=翻译页项数，FTL_TPAGE_FILE=翻译页文件，FTL_TPAGE_READ_US/FTL_TPAGE_WRITE_US=注入的延迟，
+// FTL_EAGER_INIT=on|off，FTL_PACKED_MAP=on|off，FTL_LOG_BLOCKS=混合FTL日志块数，FTL_LOG_ASSOC=fast|bast
+void FTLConfigFromEnv(ftl_config *config);
+// 按名字查找方案，找不到返回NULL
+const ftl_ops *FTLLookup(const char *name);
+// 分配清零的实例内存；小实例按缓存行对齐，多个实例并发运行时不会共享缓存行。用free释放
+void *FTLAllocInstance(size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // FTL_OPS_H
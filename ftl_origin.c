@@ -1,110 +1,227 @@
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
 
-#include "ftl.h"
+#include "ftl_ops.h"
+#include "checkpoint.h"
 
 #define MAX_MAPPING_ENTRIES (64 * 1000 * 1000)
 #define VALIDSIZE 1000000
 #define CACHE_SIZE (16)
-static uint64_t memoryUsed = 0;
-static uint64_t memoryMax = 0;
-
+#define IDENTITY_STEP 4         // 没有改写过的LBA映射到lba*IDENTITY_STEP
+#define PHYSICAL_PAGES (IDENTITY_STEP * (uint64_t)MAX_MAPPING_ENTRIES + 1)  // 恒等映射用到的PPN加一个空闲页
+#define ORIGIN_FORMAT 3         // 映射项存相对恒等映射的差值，位宽可变；检查点恢复时核对
+#define MAX_INIT_THREADS 16
 
 
+// 映射项存的是与恒等映射的差值（模2^width），全零就是初始状态：实例由匿名映射按需清零，
+// init不必逐项写初值，没访问过的页面不占物理内存。
+// width为64时table就是普通数组；压缩时每项只占能表示全部物理页的位数，紧挨着存放，
+// 一项可能跨两个字，读写仍是O(1)的原地移位
 typedef struct {
-    uint64_t ppn[MAX_MAPPING_ENTRIES]; // 记录哪些ppn组在cache中
+    uint64_t format;
+    uint64_t width;         // 每个映射项的位数
     uint64_t valid[MAX_MAPPING_ENTRIES/64];
     uint64_t cacheppn;
+    uint64_t memoryUsed;
+    uint64_t memoryMax;
+    void *image;            // 从检查点恢复时为整个文件的映射，实例就在其中；否则为NULL
+    size_t image_size;
+    uint64_t table[];       // (ppn - lba*IDENTITY_STEP) mod 2^width
 } FTL;
 
-static FTL *ftl = NULL;
+static inline uint64_t entry_mask(uint64_t width) {
+    return width >= 64 ? UINT64_MAX : (UINT64_C(1) << width) - 1;
+}
 
-void FTLInit() {
-    ftl = (FTL*)malloc(sizeof(FTL));
-    for(int i=0;i<MAX_MAPPING_ENTRIES;i++){
-        ftl->ppn[i]=i*4;
-        
+// 能表示0..pages-1的最少位数
+static uint64_t width_for(uint64_t pages) {
+    uint64_t width = 1;
+    while (width < 64 && (pages - 1) >> width) {
+        width++;
+    }
+    return width;
+}
+
+static size_t instance_size(uint64_t width) {
+    uint64_t words = ((uint64_t)MAX_MAPPING_ENTRIES * width + 63) / 64;
+    return offsetof(FTL, table) + words * sizeof(uint64_t);
+}
+
+static inline uint64_t table_get(const FTL *ftl, uint64_t lba) {
+    if (ftl->width == 64) {
+        return ftl->table[lba];
+    }
+    uint64_t bit = lba * ftl->width;
+    uint64_t word = bit / 64;
+    uint64_t shift = bit % 64;
+    uint64_t v = ftl->table[word] >> shift;
+    if (shift + ftl->width > 64) {
+        v |= ftl->table[word + 1] << (64 - shift);
+    }
+    return v & entry_mask(ftl->width);
+}
+
+static inline void table_set(FTL *ftl, uint64_t lba, uint64_t v) {
+    if (ftl->width == 64) {
+        ftl->table[lba] = v;
+        return;
+    }
+    uint64_t mask = entry_mask(ftl->width);
+    uint64_t bit = lba * ftl->width;
+    uint64_t word = bit / 64;
+    uint64_t shift = bit % 64;
+    ftl->table[word] = (ftl->table[word] & ~(mask << shift)) | (v << shift);
+    if (shift + ftl->width > 64) {
+        uint64_t low_bits = 64 - shift;
+        ftl->table[word + 1] = (ftl->table[word + 1] & ~(mask >> low_bits)) | (v >> low_bits);
+    }
+}
+
+typedef struct {
+    char *begin;
+    char *end;
+} touch_range;
+
+static void *touch_pages(void *arg) {
+    touch_range *r = arg;
+    long page = sysconf(_SC_PAGESIZE);
+    for (volatile char *p = r->begin; p < r->end; p += page) {
+        *p = 0;
+    }
+    return NULL;
+}
+
+// 预先让实例的所有页面就位，运行时不再有缺页：尽量用大页，多线程分段写入
+static void materialize(void *base, size_t size) {
+    long page = sysconf(_SC_PAGESIZE);
+    char *begin = (char *)(((uintptr_t)base + page - 1) / page * page);
+    char *end = (char *)base + size;
+    if (begin >= end) {
+        return;
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(begin, (size_t)(end - begin) / page * page, MADV_HUGEPAGE);
+#endif
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    n = n < 1 ? 1 : n > MAX_INIT_THREADS ? MAX_INIT_THREADS : n;
+    pthread_t threads[MAX_INIT_THREADS];
+    touch_range ranges[MAX_INIT_THREADS];
+    size_t chunk = ((size_t)(end - begin) / n + page - 1) / page * page;
+    int started = 0;
+    for (long i = 0; i < n; i++) {
+        ranges[i].begin = begin + i * chunk < end ? begin + i * chunk : end;
+        ranges[i].end = ranges[i].begin + chunk < end ? ranges[i].begin + chunk : end;
+        if (pthread_create(&threads[started], NULL, touch_pages, &ranges[i]) == 0) {
+            started++;
+        } else {
+            touch_pages(&ranges[i]);
+        }
     }
-    for(int i=0;i<MAX_MAPPING_ENTRIES/64;i++){
-        ftl->valid[i]=0;
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
     }
+}
+
+static void *FTLInit(const ftl_config *config) {
+    uint64_t width = config->packed_map ? width_for(PHYSICAL_PAGES) : 64;
+    size_t size = instance_size(width);
+    FTL *ftl = FTLAllocInstance(size);
+    if (!ftl) {
+        perror("Failed to allocate FTL");
+        return NULL;
+    }
+    if (config->eager_init) {
+        materialize(ftl, size);
+    }
+    ftl->format = ORIGIN_FORMAT;
+    ftl->width = width;
     ftl->cacheppn=4*MAX_MAPPING_ENTRIES;
         
-    memoryUsed += sizeof(FTL);
+    ftl->memoryUsed += size;
+    return ftl;
 }
 
-void FTLDestroy() {
-    free(ftl);
-    ftl = NULL;
+static void FTLDestroy(void *handle) {
+    FTL *ftl = handle;
+    if (ftl->image) {
+        munmap(ftl->image, ftl->image_size);
+    } else {
+        free(ftl);
+    }
 }
 
-uint64_t FTLRead(uint64_t lba) {
+static uint64_t FTLRead(void *handle, uint64_t lba) {
+    FTL *ftl = handle;
     
     
-    return ftl->ppn[lba]; // 读取ppn
+    return (table_get(ftl, lba) + lba * IDENTITY_STEP) & entry_mask(ftl->width); // 读取ppn
 }
 
 
-bool FTLModify(uint64_t lba) {
+static bool FTLModify(void *handle, uint64_t lba) {
+    FTL *ftl = handle;
     int idx=lba/64;
-    if((ftl->valid[idx]&(1<<(lba%64)))==0){
-        ftl->valid[idx]|=(1<<(lba%64));
+    if((ftl->valid[idx]&(UINT64_C(1)<<(lba%64)))==0){
+        ftl->valid[idx]|=(UINT64_C(1)<<(lba%64));
         return true;
     }
-    uint64_t t=ftl->ppn[lba];
-    ftl->ppn[lba] = ftl->cacheppn; // 修改ppn
+    uint64_t mask = entry_mask(ftl->width);
+    uint64_t t=(table_get(ftl, lba) + lba * IDENTITY_STEP) & mask;
+    table_set(ftl, lba, (ftl->cacheppn - lba * IDENTITY_STEP) & mask); // 修改ppn
     ftl->cacheppn=t;
     return true;
 }
 
-uint32_t AlgorithmRun(IOVector *ioVector, const char *outputFile) {
-    struct timeval start, end;
-    long seconds, useconds;
-    double during;
-    uint64_t ret;
-    
-    FILE *file = fopen(outputFile, "w");
-    if (!file) {
-        perror("Failed to open outputFile");
-        return RETURN_ERROR;
-    }
-    memoryUsed = 0;
-    memoryMax = 0;
-    FTLInit();
-    
-    
-
-    gettimeofday(&start, NULL);
+static void FTLStats(void *handle, ftl_stats *stats) {
+    FTL *ftl = handle;
+    stats->memoryUsed = ftl->memoryUsed;
+    stats->memoryMax = ftl->memoryMax > ftl->memoryUsed ? ftl->memoryMax : ftl->memoryUsed;
+}
 
-    for (uint32_t i = 0; i < ioVector->len; ++i) {
-        if (ioVector->ioArray[i].type == IO_READ) {
-            ret = FTLRead(ioVector->ioArray[i].lba);
-            fprintf(file, "%llu\n", (unsigned long long)ret);
-        } else {
-            FTLModify(ioVector->ioArray[i].lba);
-        }
-        
-        if (memoryUsed > memoryMax) {
-            memoryMax = memoryUsed;
-        }
+// 实例不含指针，整个结构体原样作为载荷
+static bool FTLCheckpoint(void *handle, const char *path) {
+    FTL *ftl = handle;
+    CkptWriter w;
+    if (!CkptCreate(&w, path, ftl_ops_origin.name)) {
+        return false;
     }
+    CkptPut(&w, ftl, instance_size(ftl->width));
+    return CkptCommit(&w);
+}
 
-    gettimeofday(&end, NULL);
-
-    FTLDestroy();
-
-    fclose(file);
-    
-    seconds = end.tv_sec - start.tv_sec;
-    useconds = end.tv_usec - start.tv_usec;
-
-    during = (seconds * 1000000.0 + useconds) / 1000.0;
-    float throughput = ioVector->len / during;
-    printf("algorithmRunningDuration:\t %f ms\n", throughput);
-    printf("Max memory used:\t\t %llu B\n", (unsigned long long)memoryMax);
+// 直接把映射中的载荷当作实例，不拷贝也不初始化；页面在第一次访问时才读入，写时复制
+static void *FTLRestore(const ftl_config *config, const char *path) {
+    CkptImage img;
+    if (!CkptOpen(&img, path, ftl_ops_origin.name)) {
+        return NULL;
+    }
+    FTL *ftl = CkptPayload(&img);
+    // 先确认定长部分都在载荷内，再按其中的位宽核对整个载荷的大小
+    if (img.header->payload_size < offsetof(FTL, table) || ftl->format != ORIGIN_FORMAT ||
+        ftl->width == 0 || ftl->width > 64 || img.header->payload_size != instance_size(ftl->width)) {
+        fprintf(stderr, "Cannot restore origin from %s: format mismatch\n", path);
+        CkptClose(&img);
+        return NULL;
+    }
+    ftl->image = CkptDetach(&img, &ftl->image_size);
+    return ftl;
+}
 
-    return RETURN_OK;
-}
\ No newline at end of file
+const ftl_ops ftl_ops_origin = {
+    .name = "origin",
+    .group_size = 0,
+    .init = FTLInit,
+    .destroy = FTLDestroy,
+    .read = FTLRead,
+    .modify = FTLModify,
+    .flush = NULL,
+    .stats = FTLStats,
+    .checkpoint = FTLCheckpoint,
+    .restore = FTLRestore,
+};
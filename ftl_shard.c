@@ -0,0 +1,254 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "ftl_shard.h"
+
+#define RING_SIZE 4096              // 必须是2的幂
+#define RING_MASK (RING_SIZE - 1)
+#define PUBLISH_BATCH 64            // 每攒够这么多条才更新一次共享的head/tail
+#define CACHE_LINE_SIZE 64
+#define PPN_SPACE (1ULL << 32)      // 段映射中PPN以uint32保存，各分片在其中均分
+
+// 单生产者单消费者提交环：生产者是分发线程，消费者是分片的工作线程。
+// head和tail分处不同缓存行，生产者本地的游标跟tail放在一起
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t head;    // 消费者已处理到的位置
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t tail;    // 生产者已发布的位置
+    _Atomic bool done;
+    uint64_t pending;                                   // 生产者已写入但可能未发布的位置
+    uint64_t cached_head;                               // 生产者缓存的head
+    _Alignas(CACHE_LINE_SIZE) uint64_t slots[RING_SIZE];  // IO在ioArray中的下标
+} ShardRing;
+
+typedef struct {
+    ShardRing ring;
+    const ftl_ops *ops;
+    ftl_config config;
+    char journal_path[4096];    // 各分片写自己的日志：配置的文件名加.分片号
+    void *ftl;
+    IOVector *io;
+    uint64_t *results;
+    pthread_t thread;
+} Shard;
+
+struct ShardSet {
+    const ftl_ops *ops;
+    int count;
+    Shard **shards;
+};
+
+// 组号经过乘法散列后映射到分片，顺序流会轮流落到不同分片上
+static int shard_of(const ShardSet *set, uint64_t lba) {
+    uint64_t group = lba / set->ops->group_size;
+    uint64_t h = (group * 0x9E3779B97F4A7C15ULL) >> 32;
+    return (int)((h * (uint64_t)set->count) >> 32);
+}
+
+static void ring_reset(ShardRing *r) {
+    atomic_store_explicit(&r->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&r->tail, 0, memory_order_relaxed);
+    atomic_store_explicit(&r->done, false, memory_order_relaxed);
+    r->pending = 0;
+    r->cached_head = 0;
+}
+
+static void ring_push(ShardRing *r, uint64_t v) {
+    while (r->pending - r->cached_head >= RING_SIZE) {
+        // 环满：先把已写入的全部发布，再等消费者腾出位置
+        atomic_store_explicit(&r->tail, r->pending, memory_order_release);
+        r->cached_head = atomic_load_explicit(&r->head, memory_order_acquire);
+        if (r->pending - r->cached_head >= RING_SIZE) {
+            sched_yield();
+        }
+    }
+    r->slots[r->pending & RING_MASK] = v;
+    r->pending++;
+    if ((r->pending & (PUBLISH_BATCH - 1)) == 0) {
+        atomic_store_explicit(&r->tail, r->pending, memory_order_release);
+    }
+}
+
+static void ring_close(ShardRing *r) {
+    atomic_store_explicit(&r->tail, r->pending, memory_order_release);
+    atomic_store_explicit(&r->done, true, memory_order_release);
+}
+
+static void *shard_main(void *arg) {
+    Shard *s = arg;
+    ShardRing *r = &s->ring;
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+
+    for (;;) {
+        uint64_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+        if (head == tail) {
+            if (atomic_load_explicit(&r->done, memory_order_acquire)) {
+                // done在最后一次发布之后才设置，再确认一次tail
+                if (atomic_load_explicit(&r->tail, memory_order_acquire) == head) {
+                    break;
+                }
+                continue;
+            }
+            sched_yield();
+            continue;
+        }
+
+        while (head != tail) {
+            uint64_t idx = r->slots[head & RING_MASK];
+            IOUnit *io = &s->io->ioArray[idx];
+            if (io->type == IO_READ) {
+                s->results[idx] = s->ops->read(s->ftl, io->lba);
+            } else if (!s->ops->modify(s->ftl, io->lba)) {
+                printf("[AlgorithmRun Error] Failed to modify LBA: %lu\n", io->lba);
+            }
+            head++;
+            if ((head & (PUBLISH_BATCH - 1)) == 0) {
+                atomic_store_explicit(&r->head, head, memory_order_release);
+            }
+        }
+        atomic_store_explicit(&r->head, head, memory_order_release);
+    }
+
+    // 处理本分片写缓冲区中剩余的数据
+    if (s->ops->flush) {
+        s->ops->flush(s->ftl);
+    }
+    return NULL;
+}
+
+static void *shard_init(void *arg) {
+    Shard *s = arg;
+    s->ftl = s->ops->init(&s->config);
+    return NULL;
+}
+
+ShardSet *ShardSetCreate(const ftl_ops *ops, const ftl_config *config, int shards) {
+    if (!ops || ops->group_size == 0 || shards < 1 || shards > MAX_SHARDS) {
+        return NULL;
+    }
+
+    ShardSet *set = calloc(1, sizeof(ShardSet));
+    if (!set) {
+        return NULL;
+    }
+    set->ops = ops;
+    set->shards = calloc(shards, sizeof(Shard *));
+    if (!set->shards) {
+        free(set);
+        return NULL;
+    }
+
+    // 每个分片从自己的PPN区间开始分配，互不重叠
+    uint64_t range = (PPN_SPACE - config->ppn_base) / shards;
+    for (int i = 0; i < shards; i++) {
+        Shard *s = FTLAllocInstance(sizeof(Shard));
+        if (!s) {
+            ShardSetDestroy(set);
+            return NULL;
+        }
+        set->shards[i] = s;
+        set->count = i + 1;
+
+        s->config = *config;
+        s->config.ppn_base = config->ppn_base + (uint64_t)i * range;
+        if (config->journal_path) {
+            snprintf(s->journal_path, sizeof(s->journal_path), "%s.%d", config->journal_path, i);
+            s->config.journal_path = s->journal_path;
+        }
+        s->ops = ops;
+    }
+
+    // 各分片在自己的线程中初始化，有日志时按组并行重放
+    int started = 0;
+    for (; started < shards; started++) {
+        if (pthread_create(&set->shards[started]->thread, NULL, shard_init, set->shards[started]) != 0) {
+            break;
+        }
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(set->shards[i]->thread, NULL);
+    }
+    for (int i = 0; i < shards; i++) {
+        if (i >= started || !set->shards[i]->ftl) {
+            ShardSetDestroy(set);
+            return NULL;
+        }
+    }
+    return set;
+}
+
+bool ShardSetRun(ShardSet *set, IOVector *ioVector, uint64_t *results) {
+    int started = 0;
+    for (; started < set->count; started++) {
+        Shard *s = set->shards[started];
+        s->io = ioVector;
+        s->results = results;
+        ring_reset(&s->ring);
+        if (pthread_create(&s->thread, NULL, shard_main, s) != 0) {
+            break;
+        }
+    }
+
+    bool ok = started == set->count;
+    if (ok) {
+        // 分发：按组散列到各分片的提交环
+        for (uint64_t i = 0; i < ioVector->len; ++i) {
+            ring_push(&set->shards[shard_of(set, ioVector->ioArray[i].lba)]->ring, i);
+        }
+    } else {
+        printf("[AlgorithmRun Error] Failed to start shard worker %d\n", started);
+    }
+
+    for (int i = 0; i < started; i++) {
+        ring_close(&set->shards[i]->ring);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(set->shards[i]->thread, NULL);
+    }
+    return ok;
+}
+
+void ShardSetStats(ShardSet *set, ftl_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (int i = 0; i < set->count; i++) {
+        ftl_stats s;
+        memset(&s, 0, sizeof(s));
+        set->ops->stats(set->shards[i]->ftl, &s);
+        stats->memoryUsed += s.memoryUsed;
+        stats->memoryMax += s.memoryMax;
+        stats->cacheMemory += s.cacheMemory;
+        stats->journalBytes += s.journalBytes;
+        stats->journalCommits += s.journalCommits;
+        stats->cmtHits += s.cmtHits;
+        stats->cmtMisses += s.cmtMisses;
+        stats->cmtEvictions += s.cmtEvictions;
+        stats->cmtPrefetched += s.cmtPrefetched;
+        stats->cmtPrefetchHits += s.cmtPrefetchHits;
+        stats->cmtRejected += s.cmtRejected;
+        stats->tpageReads += s.tpageReads;
+        stats->tpageWrites += s.tpageWrites;
+        stats->tpageWritesAvoided += s.tpageWritesAvoided;
+        stats->switchMerges += s.switchMerges;
+        stats->partialMerges += s.partialMerges;
+        stats->fullMerges += s.fullMerges;
+        stats->mergeCopies += s.mergeCopies;
+        stats->blockErases += s.blockErases;
+    }
+}
+
+void ShardSetDestroy(ShardSet *set) {
+    if (!set) return;
+
+    for (int i = 0; i < set->count; i++) {
+        if (set->shards[i]) {
+            if (set->shards[i]->ftl) {
+                set->ops->destroy(set->shards[i]->ftl);
+            }
+            free(set->shards[i]);
+        }
+    }
+    free(set->shards);
+    free(set);
+}
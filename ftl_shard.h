@@ -0,0 +1,33 @@
+#ifndef FTL_SHARD_H
+#define FTL_SHARD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ftl_ops.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MAX_SHARDS 256
+
+// 按LBA组分片的并行回放：每个分片是一个独立实例，独占一部分组、
+// 自己的写缓冲区和一段PPN，由一个工作线程从自己的提交环中取请求执行。
+// 同一LBA总是落在同一分片并按提交顺序执行。
+typedef struct ShardSet ShardSet;
+
+// ops->group_size为0的方案不支持分片，返回NULL。各分片并行初始化，
+// 配置了日志时分片i使用journal_path.i
+ShardSet *ShardSetCreate(const ftl_ops *ops, const ftl_config *config, int shards);
+// 回放整个trace，读结果按请求下标写入results（长度为ioVector->len），
+// 返回前各分片的写缓冲区已经落盘
+bool ShardSetRun(ShardSet *set, IOVector *ioVector, uint64_t *results);
+// 各分片统计之和
+void ShardSetStats(ShardSet *set, ftl_stats *stats);
+void ShardSetDestroy(ShardSet *set);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // FTL_SHARD_H
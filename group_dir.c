@@ -0,0 +1,55 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "group_dir.h"
+
+bool GroupDirInit(GroupDir *dir, uint64_t group_count, size_t entry_size) {
+    dir->group_count = group_count;
+    dir->leaf_count = (group_count + GROUP_DIR_LEAF_SIZE - 1) >> GROUP_DIR_LEAF_BITS;
+    dir->entry_size = entry_size;
+    // 顶层用calloc，很大时由系统按页清零映射，没写过的部分不占物理内存
+    dir->leaves = calloc(dir->leaf_count ? dir->leaf_count : 1, sizeof(void *));
+    if (!dir->leaves) {
+        fprintf(stderr, "Failed to allocate group directory\n");
+        return false;
+    }
+    return true;
+}
+
+void GroupDirFree(GroupDir *dir) {
+    if (!dir->leaves) {
+        return;
+    }
+    for (uint64_t i = 0; i < dir->leaf_count; i++) {
+        free(dir->leaves[i]);
+    }
+    free(dir->leaves);
+    dir->leaves = NULL;
+}
+
+void *GroupDirTouch(GroupDir *dir, uint64_t group) {
+    if (group >= dir->group_count) {
+        return NULL;
+    }
+    uint64_t leaf = group >> GROUP_DIR_LEAF_BITS;
+    if (!dir->leaves[leaf]) {
+        dir->leaves[leaf] = calloc(GROUP_DIR_LEAF_SIZE, dir->entry_size);
+        if (!dir->leaves[leaf]) {
+            fprintf(stderr, "Failed to allocate group directory leaf\n");
+            return NULL;
+        }
+    }
+    return GroupDirFind(dir, group);
+}
+
+void *GroupDirNext(const GroupDir *dir, uint64_t *group) {
+    for (uint64_t g = *group; g < dir->group_count;) {
+        uint64_t leaf = g >> GROUP_DIR_LEAF_BITS;
+        if (!dir->leaves[leaf]) {
+            g = (leaf + 1) << GROUP_DIR_LEAF_BITS;
+            continue;
+        }
+        *group = g;
+        return GroupDirFind(dir, g);
+    }
+    return NULL;
+}
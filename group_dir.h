@@ -0,0 +1,50 @@
+#ifndef GROUP_DIR_H
+#define GROUP_DIR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GROUP_DIR_LEAF_BITS 10      // 每个叶子放1024个组
+#define GROUP_DIR_LEAF_SIZE (1u << GROUP_DIR_LEAF_BITS)
+
+// 组号到组表的两级基数目录，段映射方案共用。顶层是叶子指针数组，
+// 叶子在其中某个组第一次写入时才分配并清零，启动开销和内存随写过的范围增长而不是随LBA范围。
+// 组表的内容由各方案自己定义，目录只按entry_size分配
+typedef struct {
+    void **leaves;          // leaves[i]为第i个叶子，没写过的为NULL
+    uint64_t group_count;
+    uint64_t leaf_count;
+    size_t entry_size;
+} GroupDir;
+
+// group_count为LBA范围内的组数。失败返回false
+bool GroupDirInit(GroupDir *dir, uint64_t group_count, size_t entry_size);
+void GroupDirFree(GroupDir *dir);
+// 写路径使用：组所在的叶子不存在时分配。越界或分配失败返回NULL
+void *GroupDirTouch(GroupDir *dir, uint64_t group);
+// 遍历使用：从*group起找下一个已分配叶子中的组表并把*group置为其组号，没有时返回NULL。
+// 叶子中从未写过的组表全为0，由调用方跳过
+void *GroupDirNext(const GroupDir *dir, uint64_t *group);
+
+// 读路径使用：组越界或从未写过时返回NULL，不分配
+static inline void *GroupDirFind(const GroupDir *dir, uint64_t group) {
+    if (group >= dir->group_count) {
+        return NULL;
+    }
+    char *leaf = (char *)dir->leaves[group >> GROUP_DIR_LEAF_BITS];
+    if (!leaf) {
+        return NULL;
+    }
+    return leaf + (group & (GROUP_DIR_LEAF_SIZE - 1)) * dir->entry_size;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // GROUP_DIR_H
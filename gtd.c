@@ -0,0 +1,114 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include "gtd.h"
+
+// 忙等us微秒；nanosleep的粒度对几十微秒的闪存延迟太粗
+static void inject_latency(uint32_t us) {
+    if (us == 0) {
+        return;
+    }
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while ((now.tv_sec - start.tv_sec) * 1000000 + (now.tv_nsec - start.tv_nsec) / 1000 < us);
+}
+
+static size_t page_bytes(const Gtd *gtd) {
+    return (size_t)gtd->page_entries * sizeof(uint64_t);
+}
+
+bool GtdInit(Gtd *gtd, uint64_t entry_count, const ftl_config *config) {
+    memset(gtd, 0, sizeof(*gtd));
+    gtd->fd = -1;
+    if (config->tpage_entries == 0) {
+        fprintf(stderr, "Translation page must hold at least one entry\n");
+        return false;
+    }
+    gtd->page_entries = config->tpage_entries;
+    gtd->page_count = (entry_count + gtd->page_entries - 1) / gtd->page_entries;
+    gtd->read_us = config->tpage_read_us;
+    gtd->write_us = config->tpage_write_us;
+    gtd->dir = malloc(gtd->page_count * sizeof(uint64_t));
+    gtd->page = malloc(page_bytes(gtd));
+    if (!gtd->dir || !gtd->page) {
+        fprintf(stderr, "Failed to allocate translation directory\n");
+        GtdFree(gtd);
+        return false;
+    }
+    memset(gtd->dir, 0xff, gtd->page_count * sizeof(uint64_t));
+
+    if (config->tpage_path) {
+        // 目录只在内存中，文件内容每次运行重新开始
+        gtd->fd = open(config->tpage_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (gtd->fd < 0) {
+            perror("Failed to open translation page file");
+            GtdFree(gtd);
+            return false;
+        }
+    } else {
+        // 匿名映射按需清零，没写过的页不占物理内存
+        gtd->store = calloc(gtd->page_count, page_bytes(gtd));
+        if (!gtd->store) {
+            fprintf(stderr, "Failed to allocate translation pages\n");
+            GtdFree(gtd);
+            return false;
+        }
+    }
+    return true;
+}
+
+void GtdFree(Gtd *gtd) {
+    if (gtd->fd >= 0) {
+        close(gtd->fd);
+    }
+    free(gtd->dir);
+    free(gtd->page);
+    free(gtd->store);
+    memset(gtd, 0, sizeof(*gtd));
+    gtd->fd = -1;
+}
+
+uint64_t GtdMemory(const Gtd *gtd) {
+    return gtd->page_count * sizeof(uint64_t) + page_bytes(gtd);
+}
+
+bool GtdRead(Gtd *gtd, uint64_t tvpn) {
+    inject_latency(gtd->read_us);
+    gtd->reads++;
+    if (gtd->dir[tvpn] == GTD_UNMAPPED) {
+        return false;
+    }
+    size_t bytes = page_bytes(gtd);
+    if (gtd->fd >= 0) {
+        if (pread(gtd->fd, gtd->page, bytes, (off_t)(tvpn * bytes)) != (ssize_t)bytes) {
+            perror("Failed to read translation page");
+        }
+    } else {
+        memcpy(gtd->page, gtd->store + tvpn * gtd->page_entries, bytes);
+    }
+    return true;
+}
+
+void GtdWrite(Gtd *gtd, uint64_t tvpn) {
+    size_t bytes = page_bytes(gtd);
+    if (gtd->fd >= 0) {
+        if (pwrite(gtd->fd, gtd->page, bytes, (off_t)(tvpn * bytes)) != (ssize_t)bytes) {
+            perror("Failed to write translation page");
+        }
+    } else {
+        memcpy(gtd->store + tvpn * gtd->page_entries, gtd->page, bytes);
+    }
+    inject_latency(gtd->write_us);
+    gtd->dir[tvpn] = gtd->next_page++;
+    gtd->writes++;
+}
+
+void GtdStats(const Gtd *gtd, ftl_stats *stats) {
+    stats->tpageReads += gtd->reads;
+    stats->tpageWrites += gtd->writes;
+}
@@ -0,0 +1,54 @@
+#ifndef GTD_H
+#define GTD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ftl_ops.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GTD_UNMAPPED UINT64_MAX
+
+// 全局翻译目录（GTD）和翻译页存储。映射表按page_entries项一页切成翻译页存在闪存上，
+// 内存里只留目录：翻译页号 -> 最新版本所在的闪存页号。翻译页异地更新，每写一次换一个闪存页号。
+// 页内容存在config->tpage_path指定的文件中（按翻译页号定位，pread/pwrite），
+// 未指定文件时存在内存替身中；两种情况都可以按配置给每次读写加上延迟
+typedef struct {
+    uint32_t page_entries;
+    uint64_t page_count;
+    uint64_t *dir;
+    uint64_t next_page;     // 下一次写出用的闪存页号
+    uint64_t *page;         // 读写翻译页用的一页缓冲
+    int fd;                 // -1表示使用内存替身
+    uint64_t *store;        // 内存替身
+    uint32_t read_us;
+    uint32_t write_us;
+    uint64_t reads;
+    uint64_t writes;
+} Gtd;
+
+// entry_count为映射项总数。失败返回false
+bool GtdInit(Gtd *gtd, uint64_t entry_count, const ftl_config *config);
+void GtdFree(Gtd *gtd);
+// 目录和页缓冲占用的内存，不含翻译页本身
+uint64_t GtdMemory(const Gtd *gtd);
+
+static inline uint64_t GtdPageOf(const Gtd *gtd, uint64_t entry) {
+    return entry / gtd->page_entries;
+}
+
+// 把翻译页tvpn读到gtd->page。页从未写出过时内容是格式化时的初值，照样计一次读，
+// 但不读存储，返回false，由调用方按初值填写
+bool GtdRead(Gtd *gtd, uint64_t tvpn);
+// 把gtd->page作为翻译页tvpn的新版本写出
+void GtdWrite(Gtd *gtd, uint64_t tvpn);
+// 累加到stats的tpageReads和tpageWrites
+void GtdStats(const Gtd *gtd, ftl_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // GTD_H
@@ -0,0 +1,464 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "journal.h"
+
+#define JOURNAL_MODIFY 1
+#define JOURNAL_BATCH 2
+#define JOURNAL_CAPACITY 3
+#define MAX_VARINT 10               // 64位变长整数最多10字节
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+// 帧头，紧跟着length字节的载荷
+typedef struct {
+    uint32_t length;
+    uint32_t reserved;
+    uint64_t checksum;      // 载荷的FNV-1a
+} journal_frame;
+
+// 提交线程：双缓冲，追加方写active，提交线程取走后写出，写完后变成spare还回来
+struct Journal {
+    int fd;
+    journal_sync sync;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;    // 唤醒提交线程
+    pthread_cond_t done;    // 一次提交完成
+    uint8_t *active;
+    size_t len;
+    size_t cap;
+    uint8_t *spare;
+    size_t spare_cap;
+    uint64_t appended;      // 已追加的字节数
+    uint64_t committed;     // 已写出的字节数（不含帧头）
+    int waiters;            // 在JournalSync中等待的线程数，有人等时不再攒批
+    bool force_sync;        // 下一次提交后无论策略如何都fsync（NONE除外）
+    bool stop;
+    bool failed;
+    struct timespec last_sync;
+    uint64_t last_lba;      // 上一条修改记录的LBA，只由追加线程访问
+    uint32_t capacity;      // 写缓冲区容量，记在空日志的开头
+    uint64_t bytes;
+    uint64_t commits;
+};
+
+static uint64_t checksum(const uint8_t *data, size_t len) {
+    uint64_t h = FNV_OFFSET;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ data[i]) * FNV_PRIME;
+    }
+    return h;
+}
+
+static int put_varint(uint8_t *p, uint64_t v) {
+    int n = 0;
+    while (v >= 0x80) {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+// 越界或超长时返回false
+static bool get_varint(const uint8_t **p, const uint8_t *end, uint64_t *v) {
+    uint64_t x = 0;
+    for (int shift = 0; shift < 64 && *p < end; shift += 7) {
+        uint8_t b = *(*p)++;
+        x |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *v = x;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool write_all(int fd, const void *data, size_t len) {
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("Failed to write journal");
+            return false;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static long elapsed_ms(const struct timespec *since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000 + (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+static void *commit_main(void *arg) {
+    Journal *j = arg;
+
+    pthread_mutex_lock(&j->lock);
+    for (;;) {
+        while (j->len == 0 && !j->stop) {
+            pthread_cond_wait(&j->wake, &j->lock);
+        }
+        if (j->len == 0) {
+            break;
+        }
+        // 攒批：暂存区不满、没人等待时再等一个提交间隔，期间到达的记录一起写出
+        if (j->len < JOURNAL_COMMIT_BYTES && !j->waiters && !j->stop) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += JOURNAL_COMMIT_INTERVAL_MS * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&j->wake, &j->lock, &deadline);
+        }
+        uint8_t *data = j->active;
+        size_t len = j->len, cap = j->cap;
+        uint64_t upto = j->appended;
+        bool force = j->force_sync;
+        j->active = j->spare;
+        j->cap = j->spare_cap;
+        j->len = 0;
+        j->spare = NULL;
+        j->force_sync = false;
+        pthread_mutex_unlock(&j->lock);
+
+        journal_frame frame = { (uint32_t)len, 0, checksum(data, len) };
+        bool ok = write_all(j->fd, &frame, sizeof(frame)) && write_all(j->fd, data, len);
+        bool synced = false;
+        if (ok && j->sync != JOURNAL_SYNC_NONE &&
+            (j->sync == JOURNAL_SYNC_COMMIT || force || elapsed_ms(&j->last_sync) >= JOURNAL_SYNC_INTERVAL_MS)) {
+            ok = fdatasync(j->fd) == 0;
+            synced = true;
+        }
+
+        pthread_mutex_lock(&j->lock);
+        if (synced) {
+            clock_gettime(CLOCK_MONOTONIC, &j->last_sync);
+        }
+        if (!ok && !j->failed) {
+            fprintf(stderr, "Journal write failed, later updates are not durable\n");
+            j->failed = true;
+        }
+        j->spare = data;
+        j->spare_cap = cap;
+        j->committed = upto;
+        j->bytes += sizeof(frame) + len;
+        j->commits++;
+        pthread_cond_broadcast(&j->done);
+    }
+    pthread_mutex_unlock(&j->lock);
+    return NULL;
+}
+
+static void append_capacity(Journal *j);
+
+Journal *JournalOpen(const char *path, const journal_tail *tail, journal_sync sync, uint32_t capacity) {
+    Journal *j = calloc(1, sizeof(Journal));
+    if (!j) {
+        return NULL;
+    }
+    j->fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (j->fd < 0) {
+        perror("Failed to open journal");
+        free(j);
+        return NULL;
+    }
+    // 崩溃时最后一帧可能只写了一半，截掉后新的帧才能接在完整的帧之后
+    if (ftruncate(j->fd, (off_t)tail->valid_length) != 0) {
+        perror("Failed to truncate journal");
+        close(j->fd);
+        free(j);
+        return NULL;
+    }
+    j->sync = sync;
+    j->last_lba = tail->last_lba;
+    j->capacity = capacity;
+    j->cap = j->spare_cap = JOURNAL_COMMIT_BYTES * 2;
+    j->active = malloc(j->cap);
+    j->spare = malloc(j->spare_cap);
+    clock_gettime(CLOCK_MONOTONIC, &j->last_sync);
+    pthread_mutex_init(&j->lock, NULL);
+    pthread_cond_init(&j->wake, NULL);
+    pthread_cond_init(&j->done, NULL);
+    if (!j->active || !j->spare || pthread_create(&j->thread, NULL, commit_main, j) != 0) {
+        fprintf(stderr, "Failed to start journal commit thread\n");
+        pthread_mutex_destroy(&j->lock);
+        pthread_cond_destroy(&j->wake);
+        pthread_cond_destroy(&j->done);
+        free(j->active);
+        free(j->spare);
+        close(j->fd);
+        free(j);
+        return NULL;
+    }
+    if (tail->valid_length == 0) {
+        append_capacity(j);
+    }
+    return j;
+}
+
+void JournalClose(Journal *j) {
+    if (!j) return;
+
+    pthread_mutex_lock(&j->lock);
+    j->stop = true;
+    j->force_sync = true;
+    pthread_cond_signal(&j->wake);
+    pthread_mutex_unlock(&j->lock);
+    pthread_join(j->thread, NULL);
+
+    if (j->sync != JOURNAL_SYNC_NONE) {
+        fdatasync(j->fd);
+    }
+    close(j->fd);
+    pthread_mutex_destroy(&j->lock);
+    pthread_cond_destroy(&j->wake);
+    pthread_cond_destroy(&j->done);
+    free(j->active);
+    free(j->spare);
+    free(j);
+}
+
+// 在暂存区预留至多need字节，返回写入位置；调用时持有锁，由append_end提交实际长度
+static uint8_t *append_begin(Journal *j, size_t need) {
+    pthread_mutex_lock(&j->lock);
+    // 提交线程跟不上时等它写完一批，暂存区不会无限增长
+    while (j->len + need > JOURNAL_MAX_PENDING && j->len > 0) {
+        pthread_cond_signal(&j->wake);
+        pthread_cond_wait(&j->done, &j->lock);
+    }
+    if (j->len + need > j->cap) {
+        size_t cap = j->cap;
+        while (cap < j->len + need) {
+            cap *= 2;
+        }
+        uint8_t *p = realloc(j->active, cap);
+        if (!p) {
+            if (!j->failed) {
+                fprintf(stderr, "Journal buffer allocation failed, later updates are not durable\n");
+            }
+            j->failed = true;
+            pthread_mutex_unlock(&j->lock);
+            return NULL;
+        }
+        j->active = p;
+        j->cap = cap;
+    }
+    return j->active + j->len;
+}
+
+static void append_end(Journal *j, size_t used) {
+    bool was_empty = j->len == 0;
+    j->len += used;
+    j->appended += used;
+    // 只在暂存区由空变非空、或攒够一批时唤醒
+    if (was_empty || j->len >= JOURNAL_COMMIT_BYTES) {
+        pthread_cond_signal(&j->wake);
+    }
+    pthread_mutex_unlock(&j->lock);
+}
+
+// 重放时据此拒绝容量不同的配置，批次只能按原来的容量重建
+static void append_capacity(Journal *j) {
+    uint8_t *p = append_begin(j, 1 + MAX_VARINT);
+    if (!p) {
+        return;
+    }
+    p[0] = JOURNAL_CAPACITY;
+    append_end(j, 1 + put_varint(p + 1, j->capacity));
+}
+
+void JournalModify(Journal *j, uint64_t lba) {
+    uint8_t *p = append_begin(j, 1 + MAX_VARINT);
+    if (!p) {
+        return;
+    }
+    int64_t delta = (int64_t)(lba - j->last_lba);
+    p[0] = JOURNAL_MODIFY;
+    int n = 1 + put_varint(p + 1, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+    j->last_lba = lba;
+    append_end(j, n);
+}
+
+void JournalBatch(Journal *j, uint32_t base_ppn, const uint64_t *lba, int n) {
+    uint8_t *p = append_begin(j, 1 + 2 * MAX_VARINT + (size_t)n * MAX_VARINT);
+    if (!p) {
+        return;
+    }
+    uint8_t *q = p;
+    *q++ = JOURNAL_BATCH;
+    q += put_varint(q, base_ppn);
+    q += put_varint(q, (uint64_t)n);
+    uint64_t prev = 0;
+    for (int i = 0; i < n; i++) {
+        q += put_varint(q, lba[i] - prev);
+        prev = lba[i];
+    }
+    append_end(j, q - p);
+}
+
+bool JournalSync(Journal *j) {
+    if (!j) {
+        return true;
+    }
+    pthread_mutex_lock(&j->lock);
+    uint64_t target = j->appended;
+    j->waiters++;
+    j->force_sync = true;
+    pthread_cond_signal(&j->wake);
+    while (j->committed < target && !j->failed) {
+        pthread_cond_wait(&j->done, &j->lock);
+    }
+    j->waiters--;
+    bool ok = !j->failed;
+    pthread_mutex_unlock(&j->lock);
+    return ok;
+}
+
+bool JournalTruncate(Journal *j) {
+    if (!j) {
+        return true;
+    }
+    if (!JournalSync(j)) {
+        return false;
+    }
+    // 追加和清空都在同一线程，JournalSync之后提交线程空闲
+    if (ftruncate(j->fd, 0) != 0 || (j->sync != JOURNAL_SYNC_NONE && fdatasync(j->fd) != 0)) {
+        perror("Failed to truncate journal");
+        return false;
+    }
+    j->last_lba = 0;
+    append_capacity(j);
+    return true;
+}
+
+void JournalStats(Journal *j, ftl_stats *stats) {
+    if (!j) return;
+    pthread_mutex_lock(&j->lock);
+    stats->journalBytes += j->bytes;
+    stats->journalCommits += j->commits;
+    pthread_mutex_unlock(&j->lock);
+}
+
+// 解码一帧中的记录，apply为false时只检查，为true时应用到wb。
+// 校验和正确却无法应用的帧（记录类型未知、与当前写缓冲区容量不符）返回false
+static bool replay_frame(const uint8_t *p, const uint8_t *end, WriteBuffer *wb, journal_flush_fn flush,
+                         void *ctx, uint64_t *last_lba, bool apply) {
+    while (p < end) {
+        uint8_t type = *p++;
+        uint64_t v;
+        if (type == JOURNAL_MODIFY) {
+            if (!get_varint(&p, end, &v)) {
+                return false;
+            }
+            if (!apply) {
+                continue;
+            }
+            *last_lba += (uint64_t)((int64_t)(v >> 1) ^ -(int64_t)(v & 1));
+            // 与正常写入一样，缓冲区满时先落盘
+            if (!WriteBufferAdd(wb, *last_lba)) {
+                flush(ctx);
+                WriteBufferAdd(wb, *last_lba);
+            }
+        } else if (type == JOURNAL_BATCH) {
+            uint64_t base, n;
+            if (!get_varint(&p, end, &base) || !get_varint(&p, end, &n)) {
+                return false;
+            }
+            if (n > (uint64_t)wb->capacity) {
+                fprintf(stderr, "Journal batch of %llu LBAs exceeds write buffer capacity %d\n",
+                        (unsigned long long)n, wb->capacity);
+                return false;
+            }
+            // 批次就是落盘时缓冲区的全部内容，按原样重建后落盘
+            if (apply) {
+                WriteBufferReset(wb);
+            }
+            uint64_t lba = 0;
+            for (uint64_t i = 0; i < n; i++) {
+                if (!get_varint(&p, end, &v)) {
+                    return false;
+                }
+                lba += v;
+                if (apply) {
+                    WriteBufferAdd(wb, lba);
+                }
+            }
+            if (apply) {
+                wb->next_ppn = (uint32_t)base;
+                flush(ctx);
+            }
+        } else if (type == JOURNAL_CAPACITY) {
+            if (!get_varint(&p, end, &v)) {
+                return false;
+            }
+            if (v != (uint64_t)wb->capacity) {
+                fprintf(stderr, "Journal was written with write buffer capacity %llu, configured %d\n",
+                        (unsigned long long)v, wb->capacity);
+                return false;
+            }
+        } else {
+            fprintf(stderr, "Unknown journal record type %u\n", type);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool JournalReplay(const char *path, WriteBuffer *wb, journal_flush_fn flush, void *ctx, journal_tail *tail) {
+    memset(tail, 0, sizeof(*tail));
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        if (errno != ENOENT) {
+            perror("Failed to open journal");
+            return false;
+        }
+        return true;
+    }
+    // 只有不完整或校验不符的帧（崩溃时写了一半的末尾）在此停止，之后由JournalOpen截掉。
+    // 完整的帧先整帧检查，无法应用时一条也不应用，重放失败，文件保持原样
+    bool ok = true;
+    uint64_t last_lba = 0;
+    uint8_t *data = NULL;
+    size_t data_cap = 0;
+    journal_frame frame;
+    while (fread(&frame, sizeof(frame), 1, fp) == 1) {
+        if (frame.length > data_cap) {
+            uint8_t *p = realloc(data, frame.length);
+            if (!p) {
+                fprintf(stderr, "Failed to allocate %u bytes for journal replay\n", frame.length);
+                ok = false;
+                break;
+            }
+            data = p;
+            data_cap = frame.length;
+        }
+        if (fread(data, 1, frame.length, fp) != frame.length || checksum(data, frame.length) != frame.checksum) {
+            break;
+        }
+        if (!replay_frame(data, data + frame.length, wb, flush, ctx, &last_lba, false)) {
+            fprintf(stderr, "Cannot replay journal %s at offset %llu\n", path,
+                    (unsigned long long)tail->valid_length);
+            ok = false;
+            break;
+        }
+        replay_frame(data, data + frame.length, wb, flush, ctx, &last_lba, true);
+        tail->valid_length += sizeof(frame) + frame.length;
+        tail->last_lba = last_lba;
+    }
+    free(data);
+    fclose(fp);
+    return ok;
+}
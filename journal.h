@@ -0,0 +1,58 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ftl_ops.h"
+#include "write_buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JOURNAL_COMMIT_BYTES (64 << 10)     // 暂存达到这么多字节时立即提交
+#define JOURNAL_COMMIT_INTERVAL_MS 2        // 暂存有数据时最多攒这么久再提交
+#define JOURNAL_MAX_PENDING (4 << 20)       // 暂存超过这么多时追加方等待提交线程
+#define JOURNAL_SYNC_INTERVAL_MS 100        // JOURNAL_SYNC_PERIODIC的fsync间隔
+
+// 映射日志：只追加的重做日志，记录写缓冲区收到的每个新LBA和每次落盘的批次，
+// 恢复时在最近的检查点上按序重放。记录先写入内存中的暂存区，由提交线程成批写出（组提交），
+// 每次写出是一帧：16字节帧头（载荷长度、校验和）加载荷，重放时遇到不完整或校验不符的帧即停止。
+// 载荷中的记录：
+//   JOURNAL_MODIFY    与上一条修改记录的LBA之差（zigzag变长整数）
+//   JOURNAL_BATCH     起始PPN、LBA数，然后是升序LBA的差分（变长整数）
+//   JOURNAL_CAPACITY  写缓冲区容量（变长整数），在空日志的开头
+// 追加只能在一个线程中进行
+typedef struct Journal Journal;
+
+// 重放时的回调：批次记录按原样装入写缓冲区后调用flush(ctx)重新落盘
+typedef void (*journal_flush_fn)(void *ctx);
+
+// 重放结束时的位置，继续追加要从这里接上
+typedef struct {
+    uint64_t valid_length;  // 完整帧的总长度，之后的残帧（不完整或校验不符）在打开时截掉
+    uint64_t last_lba;      // 最后一条修改记录的LBA，是下一条差分的基准
+} journal_tail;
+
+// 打开path从tail处继续追加，不存在时创建；日志为空时先记下写缓冲区容量capacity。失败返回NULL
+Journal *JournalOpen(const char *path, const journal_tail *tail, journal_sync sync, uint32_t capacity);
+// 提交暂存的记录并关闭
+void JournalClose(Journal *j);
+void JournalModify(Journal *j, uint64_t lba);
+void JournalBatch(Journal *j, uint32_t base_ppn, const uint64_t *lba, int n);
+// 等到此前追加的记录都已写出，按fsync策略（NONE除外）落盘。j为NULL时直接返回true
+bool JournalSync(Journal *j);
+// 检查点写出后调用，之前的记录都已包含在检查点中，清空日志。j为NULL时直接返回true
+bool JournalTruncate(Journal *j);
+// 累加到stats的journalBytes和journalCommits
+void JournalStats(Journal *j, ftl_stats *stats);
+
+// 把path中的日志重放到wb上，重放时wb不能挂着日志。文件不存在时视为空日志。
+// 读取失败，或有校验正确却无法应用的帧（如写缓冲区容量与日志不符）时返回false，调用方不应再打开日志
+bool JournalReplay(const char *path, WriteBuffer *wb, journal_flush_fn flush, void *ctx, journal_tail *tail);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // JOURNAL_H
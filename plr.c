@@ -0,0 +1,74 @@
+#include "plr.h"
+
+// 向上取整的除法，den > 0
+static int64_t div_ceil(int64_t num, int64_t den) {
+    return num >= 0 ? (num + den - 1) / den : -((-num) / den);
+}
+
+// 向下取整的除法，den > 0
+static int64_t div_floor(int64_t num, int64_t den) {
+    return num >= 0 ? num / den : -((-num + den - 1) / den);
+}
+
+// 从first起等步长的点数
+static int exact_run(const uint64_t *lba, int first, int n, int max_step) {
+    if (first + 1 >= n) {
+        return 1;
+    }
+    uint64_t step = lba[first + 1] - lba[first];
+    if (step > (uint64_t)max_step) {
+        return 1;
+    }
+    int count = 2;
+    while (first + count < n && lba[first + count] - lba[first + count - 1] == step) {
+        count++;
+    }
+    return count;
+}
+
+// 从first起在误差gamma内能用同一斜率覆盖的点数，斜率取可行区间的中点
+static int cone_run(const uint64_t *lba, int first, int n, int gamma, int max_slope, int *slope) {
+    int64_t lo = 0, hi = max_slope;
+    int count = 1;
+    while (first + count < n) {
+        int64_t dx = (int64_t)(lba[first + count] - lba[first]);
+        int64_t dy = count;
+        // |slope*dx/PLR_SLOPE_ONE - dy| <= gamma，整数边界下四舍五入后仍在误差内
+        int64_t new_lo = div_ceil((dy - gamma) * PLR_SLOPE_ONE, dx);
+        int64_t new_hi = div_floor((dy + gamma) * PLR_SLOPE_ONE, dx);
+        if (new_lo < lo) new_lo = lo;
+        if (new_hi > hi) new_hi = hi;
+        if (new_lo > new_hi) {
+            break;
+        }
+        lo = new_lo;
+        hi = new_hi;
+        count++;
+    }
+    *slope = (int)((lo + hi) / 2);
+    return count;
+}
+
+int PLRBuild(const uint64_t *lba, int n, int gamma, int max_step, int max_slope, plr_segment *out) {
+    int segments = 0;
+    int first = 0;
+    while (first < n) {
+        plr_segment *seg = &out[segments++];
+        int slope = 0;
+        int exact = exact_run(lba, first, n, max_step);
+        int approx = gamma > 0 ? cone_run(lba, first, n, gamma, max_slope, &slope) : 1;
+
+        seg->first = first;
+        if (exact >= approx) {
+            seg->count = exact;
+            seg->step = exact > 1 ? (int)(lba[first + 1] - lba[first]) : 0;
+            seg->slope = 0;
+        } else {
+            seg->count = approx;
+            seg->step = 0;
+            seg->slope = slope;
+        }
+        first += seg->count;
+    }
+    return segments;
+}
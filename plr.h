@@ -0,0 +1,37 @@
+#ifndef PLR_H
+#define PLR_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PLR_SLOPE_ONE 128           // 斜率的定点表示：slope/128个PPN每个偏移
+
+// 分段线性拟合得到的一段：批内下标[first, first+count)的点。
+// count为1或step>0时是精确段（等步长）；否则是近似段，按slope预测PPN，误差不超过gamma
+typedef struct {
+    int first;
+    int count;
+    int step;
+    int slope;                      // 近似段的斜率，0 ~ max_slope
+} plr_segment;
+
+// lba为同一组内严格升序的LBA，第i个点落盘时的PPN为首个PPN+i。
+// 从前往后贪心切段：先取等步长（不超过max_step）的精确段，
+// 再用收缩锥求斜率可取值的整数区间，能覆盖更多点时改为近似段。
+// 近似段中第k个点的预测值round(slope*(lba[k]-lba[first])/PLR_SLOPE_ONE)与k-first之差不超过gamma。
+// out至少能放n个段，返回段数
+int PLRBuild(const uint64_t *lba, int n, int gamma, int max_step, int max_slope, plr_segment *out);
+
+// 近似段中距段首dx个偏移处的预测下标
+static inline int PLRPredict(int slope, int dx) {
+    return (slope * dx + PLR_SLOPE_ONE / 2) / PLR_SLOPE_ONE;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // PLR_H
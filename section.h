@@ -0,0 +1,79 @@
+#ifndef SECTION_H
+#define SECTION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 段的紧凑编码，段映射方案共用，一个段占8字节、一条缓存行放8个段：
+//   bit 0-7   start     组内起始偏移
+//   bit 8-15  length    最后一个点与start的距离
+//   bit 16-22 step      步长，0表示只有start一个点
+//   bit 23    accuracy  精确段标记，cascade和lea使用
+//   bit 24-63 ppn       第一个点的物理页号，第k个点为ppn+k
+// lea的近似段（accuracy为0且length大于0）改用其中两个域：
+//   step域存斜率（见plr.h），ppn域低32位为第一个点的PPN、高8位为点数-1
+#define SECTION_MAX_STEP 127
+#define SECTION_PPN_BITS 40
+#define SECTION_MAX_PPN ((UINT64_C(1) << SECTION_PPN_BITS) - 1)
+
+typedef struct {
+    uint64_t bits;
+} section;
+
+static inline section section_make(uint8_t start, uint8_t length, uint8_t step, bool accuracy, uint64_t ppn) {
+    section sec;
+    sec.bits = (uint64_t)start | (uint64_t)length << 8 | (uint64_t)(step & SECTION_MAX_STEP) << 16 |
+               (uint64_t)accuracy << 23 | (ppn & SECTION_MAX_PPN) << 24;
+    return sec;
+}
+
+static inline int section_start(section sec) {
+    return (int)(sec.bits & 0xFF);
+}
+
+static inline int section_length(section sec) {
+    return (int)(sec.bits >> 8 & 0xFF);
+}
+
+static inline int section_step(section sec) {
+    return (int)(sec.bits >> 16 & SECTION_MAX_STEP);
+}
+
+static inline bool section_accuracy(section sec) {
+    return (sec.bits >> 23 & 1) != 0;
+}
+
+static inline uint64_t section_ppn(section sec) {
+    return sec.bits >> 24;
+}
+
+static inline section section_make_approx(uint8_t start, uint8_t length, uint8_t slope, uint32_t ppn, int count) {
+    return section_make(start, length, slope, false, (uint64_t)ppn | (uint64_t)(count - 1) << 32);
+}
+
+static inline bool section_is_approx(section sec) {
+    return !section_accuracy(sec) && section_length(sec) > 0;
+}
+
+static inline uint32_t section_approx_ppn(section sec) {
+    return (uint32_t)(sec.bits >> 24);
+}
+
+static inline int section_approx_count(section sec) {
+    return (int)(sec.bits >> 56) + 1;
+}
+
+// 覆盖范围的最后一个偏移
+static inline int section_end(section sec) {
+    return section_start(sec) + section_length(sec);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SECTION_H
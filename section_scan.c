@@ -0,0 +1,100 @@
+#include <string.h>
+#include "section_scan.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define SECTION_SCAN_X86 1
+#endif
+
+bool SectionBoundsReserve(Arena *arena, section_bounds *bounds, int size, bool *created) {
+    *created = false;
+    if (size < SECTION_SCAN_MIN || (uint32_t)size <= bounds->capacity) {
+        return true;
+    }
+    uint64_t capacity = bounds->capacity ? bounds->capacity : SECTION_SCAN_MIN;
+    while (capacity < (uint64_t)size) {
+        capacity *= 2;
+    }
+    if (capacity > UINT32_MAX) {
+        return false;
+    }
+
+    // starts和ends放在同一块里，扩容时ends整体后移
+    uint8_t *block = ArenaAlloc(arena, 2 * capacity);
+    if (!block) {
+        return false;
+    }
+    if (bounds->starts) {
+        memcpy(block, bounds->starts, bounds->capacity);
+        memcpy(block + capacity, bounds->ends, bounds->capacity);
+        ArenaRelease(arena, bounds->starts, 2 * bounds->capacity);
+    } else {
+        *created = true;
+    }
+    bounds->starts = block;
+    bounds->ends = block + capacity;
+    bounds->capacity = capacity;
+    return true;
+}
+
+void SectionBoundsRelease(Arena *arena, section_bounds *bounds) {
+    ArenaRelease(arena, bounds->starts, 2 * bounds->capacity);
+    bounds->starts = NULL;
+    bounds->ends = NULL;
+    bounds->capacity = 0;
+}
+
+static int scan_scalar(const uint8_t *starts, const uint8_t *ends, int i, int n, uint8_t offset) {
+    for (; i < n; i++) {
+        if (starts[i] <= offset && offset <= ends[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+#ifdef SECTION_SCAN_X86
+// 无符号比较：start <= offset即max(start, offset) == offset，offset <= end即min(end, offset) == offset
+static int scan_sse2(const uint8_t *starts, const uint8_t *ends, int i, int n, uint8_t offset) {
+    __m128i o = _mm_set1_epi8((char)offset);
+    for (; i + 16 <= n; i += 16) {
+        __m128i s = _mm_loadu_si128((const __m128i *)(starts + i));
+        __m128i e = _mm_loadu_si128((const __m128i *)(ends + i));
+        __m128i hit = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(s, o), o),
+                                    _mm_cmpeq_epi8(_mm_min_epu8(e, o), o));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return scan_scalar(starts, ends, i, n, offset);
+}
+
+__attribute__((target("avx2")))
+static int scan_avx2(const uint8_t *starts, const uint8_t *ends, int i, int n, uint8_t offset) {
+    __m256i o = _mm256_set1_epi8((char)offset);
+    for (; i + 32 <= n; i += 32) {
+        __m256i s = _mm256_loadu_si256((const __m256i *)(starts + i));
+        __m256i e = _mm256_loadu_si256((const __m256i *)(ends + i));
+        __m256i hit = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(s, o), o),
+                                       _mm256_cmpeq_epi8(_mm256_min_epu8(e, o), o));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(hit);
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return scan_sse2(starts, ends, i, n, offset);
+}
+#endif
+
+int SectionScan(const uint8_t *starts, const uint8_t *ends, int from, int n, uint8_t offset) {
+#ifdef SECTION_SCAN_X86
+    // __builtin_cpu_supports只读启动时填好的CPU特性，分支总是同一方向
+    if (__builtin_cpu_supports("avx2")) {
+        return scan_avx2(starts, ends, from, n, offset);
+    }
+    return scan_sse2(starts, ends, from, n, offset);
+#else
+    return scan_scalar(starts, ends, from, n, offset);
+#endif
+}
@@ -0,0 +1,43 @@
+#ifndef SECTION_SCAN_H
+#define SECTION_SCAN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "arena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SECTION_SCAN_MIN 32     // 层内段数达到该值时才建立起止偏移副本
+
+// 层内各段起止偏移的副本，按段的下标存成两个uint8数组，读时一条指令比较多个段。
+// 只给段多的层建立，starts为NULL表示没有副本；ends已截到255
+typedef struct {
+    uint8_t *starts;
+    uint8_t *ends;
+    uint32_t capacity;
+} section_bounds;
+
+// 层内段数变为size前调用。size达到SECTION_SCAN_MIN时建立或扩容副本，
+// 新建时*created置为true，由调用方填入全部段。分配失败返回false
+bool SectionBoundsReserve(Arena *arena, section_bounds *bounds, int size, bool *created);
+void SectionBoundsRelease(Arena *arena, section_bounds *bounds);
+
+// 范围为空的段可用start=0xFF、end=0表示
+static inline void section_bounds_set(section_bounds *bounds, int i, int start, int end) {
+    if (bounds->starts) {
+        bounds->starts[i] = (uint8_t)start;
+        bounds->ends[i] = (uint8_t)(end > 0xFF ? 0xFF : end);
+    }
+}
+
+// 返回[from, n)中第一个满足starts[i] <= offset <= ends[i]的下标，没有时返回-1。
+// 运行时按CPU选择AVX2（32个段）、SSE2（16个段）或逐个比较
+int SectionScan(const uint8_t *starts, const uint8_t *ends, int from, int n, uint8_t offset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SECTION_SCAN_H
@@ -0,0 +1,305 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "sink.h"
+
+#define SINK_DEFAULT_BUFFER_MB 256
+#define SINK_MIN_BUFFER (64 * 1024)
+
+const char sink_digits[200] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// 后台写线程：双缓冲，pending交给线程写出，写完后变成spare还给生产者
+typedef struct SinkWriter {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    char *pending;
+    size_t pending_len;
+    char *spare;
+    bool stop;
+    bool failed;
+    int fd;
+} SinkWriter;
+
+void SinkDefaultOptions(SinkOptions *opt) {
+    opt->format = SINK_FORMAT_TEXT;
+    opt->backend = SINK_BACKEND_BUFFER;
+    opt->writer_thread = false;
+    opt->buffer_bytes = (size_t)SINK_DEFAULT_BUFFER_MB * 1024 * 1024;
+}
+
+void SinkOptionsFromEnv(SinkOptions *opt) {
+    SinkDefaultOptions(opt);
+
+    const char *v = getenv("FTL_SINK_FORMAT");
+    if (v && strcmp(v, "binary") == 0) {
+        opt->format = SINK_FORMAT_BINARY;
+    }
+    v = getenv("FTL_SINK_BACKEND");
+    if (v && strcmp(v, "mmap") == 0) {
+        opt->backend = SINK_BACKEND_MMAP;
+    }
+    v = getenv("FTL_SINK_THREAD");
+    if (v && atoi(v) != 0) {
+        opt->writer_thread = true;
+    }
+    v = getenv("FTL_SINK_BUFFER_MB");
+    if (v && atoi(v) > 0) {
+        opt->buffer_bytes = (size_t)atoi(v) * 1024 * 1024;
+    }
+}
+
+static bool write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("Failed to write output");
+            return false;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+// 预先触发缺页，避免在计时循环中分配物理页
+static char *alloc_chunk(size_t cap) {
+    void *p = mmap(NULL, cap, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    return p == MAP_FAILED ? NULL : (char *)p;
+}
+
+static void *writer_main(void *arg) {
+    SinkWriter *w = arg;
+
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (!w->pending && !w->stop) {
+            pthread_cond_wait(&w->cond, &w->lock);
+        }
+        if (!w->pending) {
+            break;
+        }
+        char *chunk = w->pending;
+        size_t len = w->pending_len;
+        w->pending = NULL;
+        pthread_mutex_unlock(&w->lock);
+
+        bool ok = write_all(w->fd, chunk, len);
+
+        pthread_mutex_lock(&w->lock);
+        if (!ok) w->failed = true;
+        w->spare = chunk;
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+// 把当前缓冲区交给写线程，换回空闲的那一块
+static void writer_handoff(ResultSink *sink) {
+    SinkWriter *w = sink->writer;
+
+    pthread_mutex_lock(&w->lock);
+    while (!w->spare) {
+        pthread_cond_wait(&w->cond, &w->lock);
+    }
+    w->pending = sink->buf;
+    w->pending_len = sink->len;
+    sink->buf = w->spare;
+    w->spare = NULL;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    sink->len = 0;
+}
+
+static bool mmap_resize(ResultSink *sink, size_t new_cap) {
+    if (ftruncate(sink->fd, (off_t)new_cap) != 0) {
+        perror("Failed to extend output file");
+        return false;
+    }
+    void *p = sink->buf ? mremap(sink->buf, sink->cap, new_cap, MREMAP_MAYMOVE)
+                        : mmap(NULL, new_cap, PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_POPULATE, sink->fd, 0);
+    if (p == MAP_FAILED) {
+        perror("Failed to map output file");
+        return false;
+    }
+    sink->buf = p;
+    sink->cap = new_cap;
+    return true;
+}
+
+ResultSink *SinkOpen(const char *filename, const SinkOptions *opt, uint64_t expected) {
+    SinkOptions defaults;
+    if (!opt) {
+        SinkDefaultOptions(&defaults);
+        opt = &defaults;
+    }
+
+    ResultSink *sink = calloc(1, sizeof(ResultSink));
+    if (!sink) {
+        return NULL;
+    }
+    sink->format = opt->format;
+    sink->backend = filename ? opt->backend : SINK_BACKEND_BUFFER;
+
+    if (filename) {
+        int flags = sink->backend == SINK_BACKEND_MMAP ? O_RDWR : O_WRONLY;
+        sink->fd = open(filename, flags | O_CREAT | O_TRUNC, 0644);
+        if (sink->fd < 0) {
+            free(sink);
+            return NULL;
+        }
+        sink->own_fd = true;
+    } else {
+        sink->fd = STDOUT_FILENO;
+    }
+
+    // 按预计条数一次性分配，只有超过上限才会在计时区间内溢出。
+    // mmap后端的初始映射同样受上限约束，之后由SinkSpill按需扩展
+    size_t record = sink->format == SINK_FORMAT_BINARY ? sizeof(uint64_t) : SINK_MAX_RECORD;
+    size_t want = (size_t)expected * record + SINK_MAX_RECORD;
+    if (want < SINK_MIN_BUFFER) want = SINK_MIN_BUFFER;
+    if (want > opt->buffer_bytes && opt->buffer_bytes >= SINK_MIN_BUFFER) {
+        want = opt->buffer_bytes;
+    }
+
+    if (sink->backend == SINK_BACKEND_MMAP) {
+        if (!mmap_resize(sink, want)) {
+            close(sink->fd);
+            free(sink);
+            return NULL;
+        }
+        return sink;
+    }
+
+    sink->cap = want;
+    sink->buf = alloc_chunk(want);
+    if (!sink->buf) {
+        if (sink->own_fd) close(sink->fd);
+        free(sink);
+        return NULL;
+    }
+
+    // 输出能一次放下时没有必要起写线程
+    if (opt->writer_thread && (size_t)expected * record + SINK_MAX_RECORD > want) {
+        SinkWriter *w = calloc(1, sizeof(SinkWriter));
+        if (w) {
+            w->spare = alloc_chunk(want);
+            w->fd = sink->fd;
+            pthread_mutex_init(&w->lock, NULL);
+            pthread_cond_init(&w->cond, NULL);
+            if (w->spare && pthread_create(&w->thread, NULL, writer_main, w) == 0) {
+                sink->writer = w;
+            } else {
+                if (w->spare) munmap(w->spare, want);
+                pthread_mutex_destroy(&w->lock);
+                pthread_cond_destroy(&w->cond);
+                free(w);
+            }
+        }
+    }
+    return sink;
+}
+
+// 映射扩展失败后改用缓冲区后端：已映射的记录留在文件中，文件截到这些记录的末尾，
+// 之后的记录从这里用write接着写
+static void mmap_fallback(ResultSink *sink) {
+    size_t written = sink->len;
+    munmap(sink->buf, sink->cap);
+    if (ftruncate(sink->fd, (off_t)written) != 0 || lseek(sink->fd, (off_t)written, SEEK_SET) < 0) {
+        perror("Failed to fall back to buffered output");
+        sink->failed = true;
+    }
+    sink->backend = SINK_BACKEND_BUFFER;
+    sink->len = 0;
+    sink->buf = alloc_chunk(SINK_MIN_BUFFER);
+    sink->cap = SINK_MIN_BUFFER;
+    if (!sink->buf) {
+        sink->buf = sink->fallback;
+        sink->cap = sizeof(sink->fallback);
+    }
+}
+
+void SinkSpill(ResultSink *sink) {
+    if (sink->backend == SINK_BACKEND_MMAP) {
+        if (!mmap_resize(sink, sink->cap * 2)) {
+            mmap_fallback(sink);
+        }
+        return;
+    }
+
+    if (sink->writer) {
+        writer_handoff(sink);
+        return;
+    }
+
+    if (!write_all(sink->fd, sink->buf, sink->len)) {
+        sink->failed = true;
+    }
+    sink->len = 0;
+}
+
+int SinkClose(ResultSink *sink) {
+    if (!sink) {
+        return -1;
+    }
+
+    bool failed = sink->failed;
+
+    if (sink->backend == SINK_BACKEND_MMAP) {
+        munmap(sink->buf, sink->cap);
+        if (ftruncate(sink->fd, (off_t)sink->len) != 0) {
+            perror("Failed to truncate output file");
+            failed = true;
+        }
+    } else if (sink->writer) {
+        SinkWriter *w = sink->writer;
+        if (sink->len > 0) {
+            writer_handoff(sink);
+        }
+        pthread_mutex_lock(&w->lock);
+        w->stop = true;
+        pthread_cond_broadcast(&w->cond);
+        pthread_mutex_unlock(&w->lock);
+        pthread_join(w->thread, NULL);
+
+        failed = failed || w->failed;
+        munmap(w->spare, sink->cap);
+        munmap(sink->buf, sink->cap);
+        pthread_mutex_destroy(&w->lock);
+        pthread_cond_destroy(&w->cond);
+        free(w);
+    } else {
+        if (sink->len > 0 && !write_all(sink->fd, sink->buf, sink->len)) {
+            failed = true;
+        }
+        if (sink->buf != sink->fallback) {
+            munmap(sink->buf, sink->cap);
+        }
+    }
+
+    if (sink->own_fd) {
+        close(sink->fd);
+    }
+    free(sink);
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,108 @@
+#ifndef SINK_H
+#define SINK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 单条记录的最大字节数：20位十进制数 + 换行
+#define SINK_MAX_RECORD 21
+
+// 输出格式
+typedef enum {
+    SINK_FORMAT_TEXT = 0,   // 每行一个十进制数，与原来的fprintf输出一致
+    SINK_FORMAT_BINARY      // 原始小端uint64，每条8字节
+} SinkFormat;
+
+// 输出后端
+typedef enum {
+    SINK_BACKEND_BUFFER = 0,  // 预分配的大缓冲区，计时结束后统一写出
+    SINK_BACKEND_MMAP         // 直接写入mmap映射的输出文件
+} SinkBackend;
+
+typedef struct {
+    SinkFormat format;
+    SinkBackend backend;
+    bool writer_thread;     // 缓冲区写满时交给后台线程写出，而不是在计时循环里同步write
+    size_t buffer_bytes;    // 单块缓冲区的上限，mmap后端是初始映射的上限
+} SinkOptions;
+
+typedef struct ResultSink {
+    char *buf;              // 当前写入位置所在的缓冲区（mmap后端时就是文件映射）
+    size_t len;
+    size_t cap;
+    SinkFormat format;
+    SinkBackend backend;
+    int fd;
+    bool own_fd;
+    bool failed;
+    struct SinkWriter *writer;  // 后台写线程，未启用时为NULL
+    char fallback[4 * SINK_MAX_RECORD];  // mmap扩展失败且分配不到缓冲区时，逐条经它写出
+} ResultSink;
+
+// 两位数字查表，定义在sink.c
+extern const char sink_digits[200];
+
+void SinkDefaultOptions(SinkOptions *opt);
+// 从环境变量读取配置：FTL_SINK_FORMAT=text|binary, FTL_SINK_BACKEND=buffer|mmap,
+// FTL_SINK_THREAD=0|1, FTL_SINK_BUFFER_MB=<n>
+void SinkOptionsFromEnv(SinkOptions *opt);
+// filename为NULL时写stdout；expected为预计的记录条数，用于一次性预分配
+ResultSink *SinkOpen(const char *filename, const SinkOptions *opt, uint64_t expected);
+// 缓冲区已满时由SinkPut调用，不要直接使用
+void SinkSpill(ResultSink *sink);
+// 写出剩余数据并释放，出错返回-1
+int SinkClose(ResultSink *sink);
+
+// 手写的十进制格式化，返回写入的字节数（含换行）
+static inline size_t sink_format_u64(char *out, uint64_t v) {
+    char tmp[20];
+    char *q = tmp + sizeof(tmp);
+    while (v >= 100) {
+        unsigned r = (unsigned)(v % 100);
+        v /= 100;
+        q -= 2;
+        memcpy(q, &sink_digits[r * 2], 2);
+    }
+    if (v >= 10) {
+        q -= 2;
+        memcpy(q, &sink_digits[v * 2], 2);
+    } else {
+        *--q = (char)('0' + v);
+    }
+    size_t n = (size_t)(tmp + sizeof(tmp) - q);
+    memcpy(out, q, n);
+    out[n] = '\n';
+    return n + 1;
+}
+
+// 追加一条结果，计时循环内只做内存写
+static inline void SinkPut(ResultSink *sink, uint64_t value) {
+    if (sink->len + SINK_MAX_RECORD > sink->cap) {
+        SinkSpill(sink);
+    }
+    char *p = sink->buf + sink->len;
+    if (sink->format == SINK_FORMAT_BINARY) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        memcpy(p, &value, sizeof(value));
+#else
+        for (int i = 0; i < 8; i++) {
+            p[i] = (char)(value >> (8 * i));
+        }
+#endif
+        sink->len += sizeof(value);
+    } else {
+        sink->len += sink_format_u64(p, value);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SINK_H
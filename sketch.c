@@ -0,0 +1,83 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "sketch.h"
+
+#define MIN_WIDTH 64
+#define COUNTERS_PER_WORD 16
+
+static inline uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= UINT64_C(0xbf58476d1ce4e5b9);
+    x ^= x >> 27;
+    x *= UINT64_C(0x94d049bb133111eb);
+    return x ^ (x >> 31);
+}
+
+// 第row行中key的计数器下标：双重哈希，低32位和高32位各作一个哈希
+static inline uint64_t counter_index(const FreqSketch *sketch, uint64_t h, int row) {
+    uint64_t index = ((h & 0xffffffff) + (uint64_t)row * ((h >> 32) | 1)) & sketch->mask;
+    return (uint64_t)row * (sketch->mask + 1) + index;
+}
+
+static inline uint32_t counter_get(const FreqSketch *sketch, uint64_t i) {
+    return (uint32_t)(sketch->table[i / COUNTERS_PER_WORD] >> (i % COUNTERS_PER_WORD * 4)) & SKETCH_MAX_COUNT;
+}
+
+bool SketchInit(FreqSketch *sketch, uint32_t capacity) {
+    memset(sketch, 0, sizeof(*sketch));
+    uint64_t width = MIN_WIDTH;
+    while (width < capacity) {
+        width *= 2;
+    }
+    sketch->table = calloc(SKETCH_ROWS * width / COUNTERS_PER_WORD, sizeof(uint64_t));
+    if (!sketch->table) {
+        fprintf(stderr, "Failed to allocate frequency sketch\n");
+        return false;
+    }
+    sketch->mask = width - 1;
+    sketch->sample_size = (uint64_t)(capacity ? capacity : 1) * SKETCH_SAMPLE_FACTOR;
+    return true;
+}
+
+void SketchFree(FreqSketch *sketch) {
+    free(sketch->table);
+    memset(sketch, 0, sizeof(*sketch));
+}
+
+uint64_t SketchMemory(const FreqSketch *sketch) {
+    if (!sketch->table) {
+        return 0;
+    }
+    return SKETCH_ROWS * (sketch->mask + 1) / COUNTERS_PER_WORD * sizeof(uint64_t);
+}
+
+void SketchIncrement(FreqSketch *sketch, uint64_t key) {
+    uint64_t h = mix(key);
+    for (int row = 0; row < SKETCH_ROWS; row++) {
+        uint64_t i = counter_index(sketch, h, row);
+        if (counter_get(sketch, i) < SKETCH_MAX_COUNT) {
+            sketch->table[i / COUNTERS_PER_WORD] += UINT64_C(1) << (i % COUNTERS_PER_WORD * 4);
+        }
+    }
+    // 老化：所有计数器同时减半，每个字内16个计数器一起右移
+    if (++sketch->additions >= sketch->sample_size) {
+        uint64_t words = SKETCH_ROWS * (sketch->mask + 1) / COUNTERS_PER_WORD;
+        for (uint64_t w = 0; w < words; w++) {
+            sketch->table[w] = (sketch->table[w] >> 1) & UINT64_C(0x7777777777777777);
+        }
+        sketch->additions /= 2;
+    }
+}
+
+uint32_t SketchEstimate(const FreqSketch *sketch, uint64_t key) {
+    uint64_t h = mix(key);
+    uint32_t estimate = SKETCH_MAX_COUNT;
+    for (int row = 0; row < SKETCH_ROWS; row++) {
+        uint32_t c = counter_get(sketch, counter_index(sketch, h, row));
+        if (c < estimate) {
+            estimate = c;
+        }
+    }
+    return estimate;
+}
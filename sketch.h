@@ -0,0 +1,35 @@
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SKETCH_ROWS 4
+#define SKETCH_MAX_COUNT 15         // 4位计数器
+#define SKETCH_SAMPLE_FACTOR 10     // 每记满容量的这么多倍次访问，所有计数减半
+
+// 访问频率的count-min草图（TinyLFU）：每行一个4位计数器数组，一个key在各行各占一个计数器，
+// 估计值取各行中的最小值。计满一个采样周期后全部减半，旧的热度逐渐淡出
+typedef struct {
+    uint64_t *table;        // SKETCH_ROWS行，每个uint64_t装16个计数器
+    uint64_t mask;          // 每行计数器数减一
+    uint64_t additions;
+    uint64_t sample_size;
+} FreqSketch;
+
+// capacity为被保护的缓存的项数，决定每行宽度和采样周期。失败返回false
+bool SketchInit(FreqSketch *sketch, uint32_t capacity);
+void SketchFree(FreqSketch *sketch);
+uint64_t SketchMemory(const FreqSketch *sketch);
+void SketchIncrement(FreqSketch *sketch, uint64_t key);
+uint32_t SketchEstimate(const FreqSketch *sketch, uint64_t key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SKETCH_H
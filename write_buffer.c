@@ -0,0 +1,300 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "write_buffer.h"
+#include "journal.h"
+
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES (64 / RADIX_BITS)
+#define SMALL_SORT 32               // 不超过这么多个元素时直接插入排序
+#define GROUP_SPAN_SLACK 1024       // 组号跨度不超过 容量+该值 时才按组计数排序
+#define UNSORTED_TAIL_MAX 64        // 查询PPN时未排序的尾部超过这么多就先整体排序
+
+bool WriteBufferInit(WriteBuffer *wb, const ftl_config *config, uint32_t group_size) {
+    memset(wb, 0, sizeof(*wb));
+    wb->capacity = config->write_buffer_size ? config->write_buffer_size : FTL_DEFAULT_WRITE_BUFFER_SIZE;
+    wb->next_ppn = config->ppn_base;
+    wb->group_size = group_size;
+    wb->group_sort = config->group_sort;
+
+    // 索引槽数取不小于两倍容量的2的幂，装载率不超过一半
+    uint32_t slots = 1;
+    while (slots < (uint32_t)wb->capacity * 2) {
+        slots <<= 1;
+    }
+    wb->index_mask = slots - 1;
+
+    wb->lba = malloc(sizeof(uint64_t) * wb->capacity);
+    wb->scratch = malloc(sizeof(uint64_t) * wb->capacity);
+    wb->index = calloc(slots, sizeof(uint64_t));
+    if (!wb->lba || !wb->scratch || !wb->index) {
+        printf("[WriteBuffer Error] Failed to allocate %d entries\n", wb->capacity);
+        WriteBufferFree(wb);
+        return false;
+    }
+    return true;
+}
+
+void WriteBufferFree(WriteBuffer *wb) {
+    JournalClose(wb->journal);
+    wb->journal = NULL;
+    free(wb->lba);
+    free(wb->scratch);
+    free(wb->buckets);
+    free(wb->index);
+    wb->lba = NULL;
+    wb->scratch = NULL;
+    wb->buckets = NULL;
+    wb->index = NULL;
+    wb->count = 0;
+    wb->sorted = 0;
+}
+
+static uint32_t index_slot(const WriteBuffer *wb, uint64_t lba) {
+    return (uint32_t)((lba * 0x9E3779B97F4A7C15ULL) >> 32) & wb->index_mask;
+}
+
+bool WriteBufferContains(const WriteBuffer *wb, uint64_t lba) {
+    uint64_t key = lba + 1;
+    for (uint32_t i = index_slot(wb, lba); wb->index[i]; i = (i + 1) & wb->index_mask) {
+        if (wb->index[i] == key) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool WriteBufferAdd(WriteBuffer *wb, uint64_t lba) {
+    uint64_t key = lba + 1;
+    uint32_t i = index_slot(wb, lba);
+    for (; wb->index[i]; i = (i + 1) & wb->index_mask) {
+        if (wb->index[i] == key) {
+            return true;
+        }
+    }
+    if (wb->count >= wb->capacity) {
+        return false;
+    }
+    wb->index[i] = key;
+    if (wb->journal) {
+        JournalModify(wb->journal, lba);
+    }
+
+    // 按升序到达的写入（顺序流）不破坏已排序的前缀
+    if (wb->sorted == wb->count && (wb->count == 0 || wb->lba[wb->count - 1] < lba)) {
+        wb->sorted++;
+    }
+    wb->lba[wb->count++] = lba;
+    return true;
+}
+
+// 有序前缀中小于key的元素个数
+static int lower_bound(const uint64_t *a, int n, uint64_t key) {
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (a[mid] < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+bool WriteBufferPendingPPN(WriteBuffer *wb, uint64_t lba, uint32_t *ppn) {
+    if (wb->count == 0 || !WriteBufferContains(wb, lba)) {
+        return false;
+    }
+    if (wb->count - wb->sorted > UNSORTED_TAIL_MAX) {
+        WriteBufferSortLBA(wb);
+    }
+
+    // 落盘时按升序依次分配PPN，所以PPN就是next_ppn加上比它小的LBA个数
+    int rank = lower_bound(wb->lba, wb->sorted, lba);
+    for (int i = wb->sorted; i < wb->count; i++) {
+        rank += wb->lba[i] < lba;
+    }
+    *ppn = wb->next_ppn + rank;
+    return true;
+}
+
+void WriteBufferReset(WriteBuffer *wb) {
+    memset(wb->index, 0, sizeof(uint64_t) * (wb->index_mask + 1));
+    wb->count = 0;
+    wb->sorted = 0;
+}
+
+void WriteBufferCommit(WriteBuffer *wb, uint32_t next_ppn) {
+    if (wb->journal) {
+        JournalBatch(wb->journal, wb->next_ppn, wb->lba, wb->count);
+    }
+    wb->next_ppn = next_ppn;
+    WriteBufferReset(wb);
+}
+
+bool WriteBufferAttachJournal(WriteBuffer *wb, const ftl_config *config, void (*flush)(void *ctx), void *ctx) {
+    if (!config->journal_path) {
+        return true;
+    }
+    journal_tail tail;
+    if (!JournalReplay(config->journal_path, wb, flush, ctx, &tail)) {
+        return false;
+    }
+    wb->journal = JournalOpen(config->journal_path, &tail, config->journal_sync, (uint32_t)wb->capacity);
+    return wb->journal != NULL;
+}
+
+void WriteBufferSave(const WriteBuffer *wb, CkptWriter *w) {
+    CkptPutU64(w, wb->next_ppn);
+    CkptPutU64(w, (uint64_t)wb->count);
+    CkptPut(w, wb->lba, sizeof(uint64_t) * wb->count);
+}
+
+bool WriteBufferLoad(WriteBuffer *wb, CkptImage *img) {
+    uint64_t next_ppn, count;
+    if (!CkptGetU64(img, &next_ppn) || !CkptGetU64(img, &count) || count > (uint64_t)wb->capacity) {
+        return false;
+    }
+    const uint64_t *lba = CkptGet(img, sizeof(uint64_t) * count);
+    if (!lba) {
+        return false;
+    }
+    // 按原顺序重新加入，索引和有序前缀随之重建
+    for (uint64_t i = 0; i < count; i++) {
+        WriteBufferAdd(wb, lba[i]);
+    }
+    wb->next_ppn = (uint32_t)next_ppn;
+    return true;
+}
+
+static void insertion_sort(uint64_t *a, int n) {
+    for (int i = 1; i < n; i++) {
+        uint64_t key = a[i];
+        int j = i - 1;
+        while (j >= 0 && a[j] > key) {
+            a[j + 1] = a[j];
+            j--;
+        }
+        a[j + 1] = key;
+    }
+}
+
+// LSD基数排序，每趟8位。一次遍历统计所有趟的直方图，
+// 所有键在某一趟上取值都相同时（例如LBA的高位全为0）跳过这一趟
+static void radix_sort(uint64_t *a, uint64_t *tmp, int n) {
+    static __thread uint32_t hist[RADIX_PASSES][RADIX_BUCKETS];
+    memset(hist, 0, sizeof(hist));
+
+    uint64_t diff = 0;
+    for (int i = 0; i < n; i++) {
+        uint64_t v = a[i];
+        diff |= v ^ a[0];
+        for (int d = 0; d < RADIX_PASSES; d++) {
+            hist[d][(v >> (d * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+        }
+    }
+
+    uint64_t *src = a, *dst = tmp;
+    for (int d = 0; d < RADIX_PASSES; d++) {
+        int shift = d * RADIX_BITS;
+        if (((diff >> shift) & (RADIX_BUCKETS - 1)) == 0) {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (int b = 0; b < RADIX_BUCKETS; b++) {
+            uint32_t c = hist[d][b];
+            hist[d][b] = offset;
+            offset += c;
+        }
+        for (int i = 0; i < n; i++) {
+            uint64_t v = src[i];
+            dst[hist[d][(v >> shift) & (RADIX_BUCKETS - 1)]++] = v;
+        }
+        uint64_t *t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != a) {
+        memcpy(a, src, sizeof(uint64_t) * n);
+    }
+}
+
+// 组内按偏移计数排序，组内元素多时避免插入排序退化成平方
+static void offset_sort(uint64_t *a, uint64_t *tmp, int n, uint32_t group_size) {
+    if (n <= SMALL_SORT || group_size > RADIX_BUCKETS) {
+        insertion_sort(a, n);
+        return;
+    }
+    uint32_t count[RADIX_BUCKETS + 1] = {0};
+    for (int i = 0; i < n; i++) {
+        count[a[i] % group_size + 1]++;
+    }
+    for (uint32_t b = 1; b <= group_size; b++) {
+        count[b] += count[b - 1];
+    }
+    for (int i = 0; i < n; i++) {
+        tmp[count[a[i] % group_size]++] = a[i];
+    }
+    memcpy(a, tmp, sizeof(uint64_t) * n);
+}
+
+// 先按组号计数排序，再在每个组内按偏移排序。组号跨度过大时返回false
+static bool group_sort(WriteBuffer *wb) {
+    uint64_t *a = wb->lba;
+    int n = wb->count;
+    uint64_t gmin = a[0] / wb->group_size, gmax = gmin;
+    for (int i = 1; i < n; i++) {
+        uint64_t g = a[i] / wb->group_size;
+        if (g < gmin) gmin = g;
+        if (g > gmax) gmax = g;
+    }
+    uint64_t span = gmax - gmin + 1;
+    uint64_t limit = (uint64_t)wb->capacity + GROUP_SPAN_SLACK;
+    if (span > limit) {
+        return false;
+    }
+    if (!wb->buckets) {
+        wb->buckets = malloc(sizeof(uint32_t) * (limit + 1));
+        if (!wb->buckets) {
+            return false;
+        }
+    }
+
+    uint32_t *count = wb->buckets;
+    memset(count, 0, sizeof(uint32_t) * (span + 1));
+    for (int i = 0; i < n; i++) {
+        count[a[i] / wb->group_size - gmin + 1]++;
+    }
+    for (uint64_t g = 1; g <= span; g++) {
+        count[g] += count[g - 1];
+    }
+    for (int i = 0; i < n; i++) {
+        wb->scratch[count[a[i] / wb->group_size - gmin]++] = a[i];
+    }
+
+    // 此时count[g]是第g组的结束位置
+    uint32_t begin = 0;
+    for (uint64_t g = 0; g < span; g++) {
+        uint32_t end = count[g];
+        if (end - begin > 1) {
+            offset_sort(wb->scratch + begin, a + begin, end - begin, wb->group_size);
+        }
+        begin = end;
+    }
+    memcpy(a, wb->scratch, sizeof(uint64_t) * n);
+    return true;
+}
+
+void WriteBufferSortLBA(WriteBuffer *wb) {
+    if (wb->sorted < wb->count) {
+        if (wb->count <= SMALL_SORT) {
+            insertion_sort(wb->lba, wb->count);
+        } else if (!(wb->group_sort && wb->group_size && group_sort(wb))) {
+            radix_sort(wb->lba, wb->scratch, wb->count);
+        }
+    }
+    wb->sorted = wb->count;
+}
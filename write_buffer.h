@@ -0,0 +1,55 @@
+#ifndef WRITE_BUFFER_H
+#define WRITE_BUFFER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ftl_ops.h"
+#include "checkpoint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 写缓冲区结构，段映射方案共用；容量由ftl_config.write_buffer_size决定。
+// 缓冲区中的LBA互不相同，落盘时按升序依次分配PPN
+typedef struct {
+    uint64_t *lba;
+    uint64_t *scratch;      // 排序用的临时数组，与lba等长
+    uint32_t *buckets;      // 按组计数排序用的计数数组，首次使用时分配
+    uint64_t *index;        // 开放寻址的成员索引，存lba+1，0表示空槽
+    uint32_t index_mask;
+    int count;
+    int capacity;
+    int sorted;             // lba[0, sorted)已按升序排好
+    uint32_t next_ppn;
+    uint32_t group_size;
+    bool group_sort;
+    struct Journal *journal;  // 映射日志，不为NULL时新加入的LBA和每次落盘的批次都记入日志
+} WriteBuffer;
+
+bool WriteBufferInit(WriteBuffer *wb, const ftl_config *config, uint32_t group_size);
+void WriteBufferFree(WriteBuffer *wb);
+// 加入缓冲区，已在缓冲区中的LBA原地覆盖、不占新位置。缓冲区已满且LBA不在其中时返回false
+bool WriteBufferAdd(WriteBuffer *wb, uint64_t lba);
+bool WriteBufferContains(const WriteBuffer *wb, uint64_t lba);
+// LBA在缓冲区中时返回true，并给出下次落盘时它会分配到的PPN，不触发落盘
+bool WriteBufferPendingPPN(WriteBuffer *wb, uint64_t lba, uint32_t *ppn);
+// 把缓冲区中的LBA按升序排好，时间与缓冲区大小成线性
+void WriteBufferSortLBA(WriteBuffer *wb);
+// 落盘完成后清空缓冲区，next_ppn由调用方更新
+void WriteBufferReset(WriteBuffer *wb);
+// 落盘完成后调用：把这一批（已排序的LBA和起始PPN）记入日志，更新next_ppn并清空缓冲区
+void WriteBufferCommit(WriteBuffer *wb, uint32_t next_ppn);
+// config->journal_path不为NULL时先把日志重放到wb上（批次由flush(ctx)落盘），再打开日志继续追加。
+// 须在实例的其余状态（含从检查点恢复的部分）就绪后调用。失败返回false
+bool WriteBufferAttachJournal(WriteBuffer *wb, const ftl_config *config, void (*flush)(void *ctx), void *ctx);
+// 把next_ppn和尚未落盘的LBA写入检查点
+void WriteBufferSave(const WriteBuffer *wb, CkptWriter *w);
+// 从检查点恢复，wb须已初始化且为空。数据损坏或超出容量时返回false
+bool WriteBufferLoad(WriteBuffer *wb, CkptImage *img);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // WRITE_BUFFER_H
@@ -0,0 +1,48 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "xlate_cache.h"
+
+#define CACHE_LINE_SIZE 64
+#define XLATE_MAX_VERSION ((UINT64_C(1) << (64 - XLATE_LBA_BITS)) - 1)
+
+bool XlateCacheInit(XlateCache *cache, uint32_t entries) {
+    memset(cache, 0, sizeof(*cache));
+    if (entries == 0) {
+        return true;
+    }
+    uint64_t sets = 1;
+    while (sets * XLATE_CACHE_WAYS < entries) {
+        sets *= 2;
+    }
+    size_t bytes = sets * XLATE_CACHE_WAYS * sizeof(xlate_entry);
+    cache->sets = aligned_alloc(CACHE_LINE_SIZE, bytes);
+    if (!cache->sets) {
+        fprintf(stderr, "Failed to allocate translation cache\n");
+        return false;
+    }
+    memset(cache->sets, 0, bytes);
+    cache->set_mask = sets - 1;
+    cache->version = 1;
+    return true;
+}
+
+void XlateCacheFree(XlateCache *cache) {
+    free(cache->sets);
+    memset(cache, 0, sizeof(*cache));
+}
+
+void XlateCacheInvalidate(XlateCache *cache) {
+    if (!cache->sets) {
+        return;
+    }
+    // 版本号用完时整体清空，从1重新开始
+    if (++cache->version > XLATE_MAX_VERSION) {
+        memset(cache->sets, 0, XlateCacheMemory(cache));
+        cache->version = 1;
+    }
+}
+
+uint64_t XlateCacheMemory(const XlateCache *cache) {
+    return cache->sets ? (cache->set_mask + 1) * XLATE_CACHE_WAYS * sizeof(xlate_entry) : 0;
+}
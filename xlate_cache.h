@@ -0,0 +1,70 @@
+#ifndef XLATE_CACHE_H
+#define XLATE_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define XLATE_CACHE_WAYS 4          // 每组4路，16字节一项，一组正好一条缓存行
+#define XLATE_LBA_BITS 40           // 标签低40位存lba+1，高位存版本号
+
+typedef struct {
+    uint64_t tag;           // (version << XLATE_LBA_BITS) | (lba + 1)，0为空
+    uint64_t value;
+} xlate_entry;
+
+// 读结果缓存，段映射方案共用：记下LBA上次读到的结果，命中时只探测一条缓存行。
+// 映射只在落盘时改变，落盘前调用XlateCacheInvalidate把版本号加一，旧版本的项不再命中，不用逐项清除。
+// 组内按先进先出替换，命中时不调整顺序，读路径不写缓存行
+typedef struct {
+    xlate_entry *sets;      // NULL表示不使用缓存
+    uint64_t set_mask;
+    uint64_t version;
+} XlateCache;
+
+// entries为总项数，向上取到2的幂；为0时不建缓存。失败返回false
+bool XlateCacheInit(XlateCache *cache, uint32_t entries);
+void XlateCacheFree(XlateCache *cache);
+void XlateCacheInvalidate(XlateCache *cache);
+// 缓存本身占用的字节数
+uint64_t XlateCacheMemory(const XlateCache *cache);
+
+static inline xlate_entry *xlate_set(const XlateCache *cache, uint64_t lba) {
+    return &cache->sets[(lba & cache->set_mask) * XLATE_CACHE_WAYS];
+}
+
+static inline bool XlateCacheLookup(const XlateCache *cache, uint64_t lba, uint64_t *value) {
+    if (!cache->sets) {
+        return false;
+    }
+    const xlate_entry *set = xlate_set(cache, lba);
+    uint64_t tag = cache->version << XLATE_LBA_BITS | (lba + 1);
+    for (int w = 0; w < XLATE_CACHE_WAYS; w++) {
+        if (set[w].tag == tag) {
+            *value = set[w].value;
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline void XlateCacheStore(XlateCache *cache, uint64_t lba, uint64_t value) {
+    if (!cache->sets) {
+        return;
+    }
+    xlate_entry *set = xlate_set(cache, lba);
+    for (int w = XLATE_CACHE_WAYS - 1; w > 0; w--) {
+        set[w] = set[w - 1];
+    }
+    set[0].tag = cache->version << XLATE_LBA_BITS | (lba + 1);
+    set[0].value = value;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // XLATE_CACHE_H